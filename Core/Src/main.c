@@ -36,6 +36,8 @@
 /* USER CODE BEGIN PD */
 #define GET_VALUE_FROM_ADDR(address) \
   *((volatile uint32_t*)(address))
+// A few microseconds at HSI 8 MHz for the pull-down to discharge PB12
+#define BOOT_PIN_SETTLE_LOOPS 10U
 /* USER CODE END PD */
 
 /* Private macro -------------------------------------------------------------*/
@@ -43,8 +45,15 @@
 /* USER CODE END PM */
 
 /* Private variables ---------------------------------------------------------*/
+CRC_HandleTypeDef hcrc;
+
 UART_HandleTypeDef huart1;
+DMA_HandleTypeDef hdma_usart1_rx;
+DMA_HandleTypeDef hdma_usart1_tx;
+DMA_HandleTypeDef hdma_memtomem_dma1_channel1;
 UART_HandleTypeDef* bootloader_uart = &huart1;
+CRC_HandleTypeDef* bootloader_crc = &hcrc;
+DMA_HandleTypeDef* bootloader_crc_dma = &hdma_memtomem_dma1_channel1;
 
 /* USER CODE BEGIN PV */
 extern uint32_t _sidata; // .data in flash (VMA)
@@ -57,12 +66,21 @@ extern uint32_t _ebss;
 /* Private function prototypes -----------------------------------------------*/
 void SystemClock_Config(void);
 static void MX_GPIO_Init(void);
+static void MX_DMA_Init(void);
 static void MX_USART1_UART_Init(void);
+static void MX_CRC_Init(void);
+static void MX_NVIC_Init(void);
 /* USER CODE BEGIN PFP */
 void _bootloader_start(void);
 int main(void);
 void SysTick_Handler(void);
+void FLASH_IRQHandler(void);
+void DMA1_Channel4_IRQHandler(void);
+void DMA1_Channel5_IRQHandler(void);
+void USART1_IRQHandler(void);
 void HAL_GPIO_DeInit(GPIO_TypeDef  *GPIOx, uint32_t GPIO_Pin);
+static void bootloader_clock_config(void);
+static void relocate_vector_table(void);
 static void led_blink(void);
 static void start_application_code(void);
 /* USER CODE END PFP */
@@ -75,9 +93,20 @@ uint32_t *vector_table[] __attribute__((section(".isr_vector"))) = {
   (uint32_t *) SRAM_END, // initial stack pointer
   (uint32_t *) _bootloader_start,
   0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-  (uint32_t *)SysTick_Handler 
+  (uint32_t *)SysTick_Handler,
+  // peripheral interrupts follow the 16 system exceptions
+  [16 + FLASH_IRQn] = (uint32_t *)FLASH_IRQHandler,
+  [16 + DMA1_Channel4_IRQn] = (uint32_t *)DMA1_Channel4_IRQHandler,
+  [16 + DMA1_Channel5_IRQn] = (uint32_t *)DMA1_Channel5_IRQHandler,
+  [16 + USART1_IRQn] = (uint32_t *)USART1_IRQHandler
 };
 
+// Copy used in bootloader mode: vectors are fetched from SRAM, so handlers
+// placed in .RamFunc are entered while the flash is busy. VTOR needs the
+// alignment to the full table size (54 vectors, rounded up to 64).
+__attribute__((aligned(256)))
+static uint32_t *ram_vector_table[sizeof(vector_table) / sizeof(uint32_t *)];
+
 __attribute__((always_inline))
 inline static void __initialize_data(
     uint32_t* flash_begin,
@@ -99,11 +128,68 @@ inline static void __initialize_bss(
         *p++ = 0;
 }
 
+__attribute__((always_inline))
+inline static bool is_application_valid(void)
+{
+    return GET_VALUE_FROM_ADDR(APP_START_ADDRESS) == SRAM_END;
+}
+
+// PB12 is sampled on registers, then the port goes back to the reset state
+__attribute__((always_inline))
+inline static bool is_bootloader_requested(void)
+{
+    RCC->APB2ENR |= RCC_APB2ENR_IOPBEN;
+    // input with pull-down: CNF 10, MODE 00 and ODR 0
+    GPIOB->CRH = (GPIOB->CRH & ~(GPIO_CRH_CNF12 | GPIO_CRH_MODE12)) |
+        GPIO_CRH_CNF12_1;
+    for (volatile uint32_t i = 0; i < BOOT_PIN_SETTLE_LOOPS; i++)
+        continue;
+
+    bool requested = (GPIOB->IDR & GPIO_IDR_IDR12) != 0;
+
+    // floating input: CNF 01, MODE 00
+    GPIOB->CRH = (GPIOB->CRH & ~(GPIO_CRH_CNF12 | GPIO_CRH_MODE12)) |
+        GPIO_CRH_CNF12_0;
+    RCC->APB2ENR &= ~RCC_APB2ENR_IOPBEN;
+
+    return requested;
+}
+
+__attribute__((always_inline))
+inline static void jump_to_application(void)
+{
+    __set_MSP(GET_VALUE_FROM_ADDR(APP_START_ADDRESS));
+    // programming manual pg. 99
+    __DMB();
+    SCB->VTOR = APP_START_ADDRESS;
+    // programming manual pg. 100
+    __DSB();
+
+    uint32_t jump_address = GET_VALUE_FROM_ADDR(
+        APP_START_ADDRESS + sizeof(uint32_t)
+    );
+    void (*reset_handler)(void) = (void*)jump_address;
+    reset_handler();
+}
+
 __attribute__((noreturn,weak))
 void _bootloader_start(void)
 {
+    // The cycle counter runs from the reset vector, so the application can
+    // read the reset-to-main time from DWT->CYCCNT (HSI: 125 ns per cycle)
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    // Fast path: the application is started from the reset state, before
+    // the RAM initialization and without HAL
+    if (!is_bootloader_requested() && is_application_valid())
+        jump_to_application();
+
+    // .data also holds .RamFunc, so the code placed in SRAM is copied too
     __initialize_data(&_sidata, &_sdata, &_edata);
     __initialize_bss(&_sbss, &_ebss);
+    bootloader_mark_boot_stage(BOOT_STAGE_RAM_INIT);
     main();
 
     for(;;);
@@ -127,6 +213,7 @@ int main(void)
   HAL_Init();
 
   /* USER CODE BEGIN Init */
+  bootloader_mark_boot_stage(BOOT_STAGE_HAL_INIT);
 
   /* USER CODE END Init */
 
@@ -139,23 +226,28 @@ int main(void)
 
   /* Initialize all configured peripherals */
   MX_GPIO_Init();
-  uint32_t current_ticks = HAL_GetTick();
 
   if (HAL_GPIO_ReadPin(GPIOB, GPIO_PIN_12) == GPIO_PIN_SET)
   {
+    bootloader_clock_config();
+    bootloader_mark_boot_stage(BOOT_STAGE_CLOCK_CONFIG);
+    relocate_vector_table();
+    MX_DMA_Init();
     MX_USART1_UART_Init();
+    MX_CRC_Init();
+    MX_NVIC_Init();
+    bootloader_io_init();
+    bootloader_mark_boot_stage(BOOT_STAGE_UART_INIT);
     bootloader_start_output();
 
+    // The core sleeps between events, a command is processed as soon as
+    // its first byte arrives
     while (true)
     {
       led_blink();
 
-      if ((HAL_GetTick() - current_ticks) < UART_POLLING_DELAY)
-        continue;
-      if (bootloader_proccess_input() == BOOTLOADER_TIMEOUT)
-        continue;
-
-      current_ticks = HAL_GetTick();
+      if (bootloader_io_wait_input())
+        (void)bootloader_proccess_input();
     }
   }
   else
@@ -206,6 +298,43 @@ void SystemClock_Config(void)
   }
 }
 
+/**
+  * @brief NVIC Configuration.
+  * @retval None
+  */
+static void MX_NVIC_Init(void)
+{
+  /* FLASH_IRQn interrupt configuration */
+  HAL_NVIC_SetPriority(FLASH_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(FLASH_IRQn);
+}
+
+/**
+  * @brief CRC Initialization Function
+  * @param None
+  * @retval None
+  */
+static void MX_CRC_Init(void)
+{
+
+  /* USER CODE BEGIN CRC_Init 0 */
+
+  /* USER CODE END CRC_Init 0 */
+
+  /* USER CODE BEGIN CRC_Init 1 */
+
+  /* USER CODE END CRC_Init 1 */
+  hcrc.Instance = CRC;
+  if (HAL_CRC_Init(&hcrc) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  /* USER CODE BEGIN CRC_Init 2 */
+
+  /* USER CODE END CRC_Init 2 */
+
+}
+
 /**
   * @brief USART1 Initialization Function
   * @param None
@@ -222,7 +351,7 @@ static void MX_USART1_UART_Init(void)
 
   /* USER CODE END USART1_Init 1 */
   huart1.Instance = USART1;
-  huart1.Init.BaudRate = 115200;
+  huart1.Init.BaudRate = UART_BAUD_RATE;
   huart1.Init.WordLength = UART_WORDLENGTH_8B;
   huart1.Init.StopBits = UART_STOPBITS_1;
   huart1.Init.Parity = UART_PARITY_NONE;
@@ -239,6 +368,41 @@ static void MX_USART1_UART_Init(void)
 
 }
 
+/**
+  * Enable DMA controller clock
+  * Configure DMA for memory to memory transfers
+  *   hdma_memtomem_dma1_channel1
+  */
+static void MX_DMA_Init(void)
+{
+
+  /* DMA controller clock enable */
+  __HAL_RCC_DMA1_CLK_ENABLE();
+
+  /* Configure DMA request hdma_memtomem_dma1_channel1 on DMA1_Channel1 */
+  hdma_memtomem_dma1_channel1.Instance = DMA1_Channel1;
+  hdma_memtomem_dma1_channel1.Init.Direction = DMA_MEMORY_TO_MEMORY;
+  hdma_memtomem_dma1_channel1.Init.PeriphInc = DMA_PINC_ENABLE;
+  hdma_memtomem_dma1_channel1.Init.MemInc = DMA_MINC_DISABLE;
+  hdma_memtomem_dma1_channel1.Init.PeriphDataAlignment = DMA_PDATAALIGN_WORD;
+  hdma_memtomem_dma1_channel1.Init.MemDataAlignment = DMA_MDATAALIGN_WORD;
+  hdma_memtomem_dma1_channel1.Init.Mode = DMA_NORMAL;
+  hdma_memtomem_dma1_channel1.Init.Priority = DMA_PRIORITY_LOW;
+  if (HAL_DMA_Init(&hdma_memtomem_dma1_channel1) != HAL_OK)
+  {
+    Error_Handler( );
+  }
+
+  /* DMA interrupt init */
+  /* DMA1_Channel4_IRQn interrupt configuration */
+  HAL_NVIC_SetPriority(DMA1_Channel4_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Channel4_IRQn);
+  /* DMA1_Channel5_IRQn interrupt configuration */
+  HAL_NVIC_SetPriority(DMA1_Channel5_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Channel5_IRQn);
+
+}
+
 /**
   * @brief GPIO Initialization Function
   * @param None
@@ -277,6 +441,51 @@ static void MX_GPIO_Init(void)
 
 /* USER CODE BEGIN 4 */
 
+// Bootloader mode runs at 72 MHz (HSE 8 MHz * 9). If HSE does not start,
+// it falls back to 64 MHz from HSI / 2 * 16.
+static void bootloader_clock_config(void)
+{
+  RCC_OscInitTypeDef RCC_OscInitStruct = {0};
+  RCC_ClkInitTypeDef RCC_ClkInitStruct = {0};
+
+  RCC_OscInitStruct.OscillatorType = RCC_OSCILLATORTYPE_HSE;
+  RCC_OscInitStruct.HSEState = RCC_HSE_ON;
+  RCC_OscInitStruct.HSEPredivValue = RCC_HSE_PREDIV_DIV1;
+  RCC_OscInitStruct.PLL.PLLState = RCC_PLL_ON;
+  RCC_OscInitStruct.PLL.PLLSource = RCC_PLLSOURCE_HSE;
+  RCC_OscInitStruct.PLL.PLLMUL = RCC_PLL_MUL9;
+  if (HAL_RCC_OscConfig(&RCC_OscInitStruct) != HAL_OK)
+  {
+    RCC_OscInitStruct.HSEState = RCC_HSE_OFF;
+    RCC_OscInitStruct.PLL.PLLSource = RCC_PLLSOURCE_HSI_DIV2;
+    RCC_OscInitStruct.PLL.PLLMUL = RCC_PLL_MUL16;
+    if (HAL_RCC_OscConfig(&RCC_OscInitStruct) != HAL_OK)
+      Error_Handler();
+  }
+
+  RCC_ClkInitStruct.ClockType = RCC_CLOCKTYPE_HCLK|RCC_CLOCKTYPE_SYSCLK
+                              |RCC_CLOCKTYPE_PCLK1|RCC_CLOCKTYPE_PCLK2;
+  RCC_ClkInitStruct.SYSCLKSource = RCC_SYSCLKSOURCE_PLLCLK;
+  RCC_ClkInitStruct.AHBCLKDivider = RCC_SYSCLK_DIV1;
+  RCC_ClkInitStruct.APB1CLKDivider = RCC_HCLK_DIV2; // 36 MHz max
+  RCC_ClkInitStruct.APB2CLKDivider = RCC_HCLK_DIV1;
+
+  // 2 wait states above 48 MHz, they are hidden by the prefetch buffer
+  __HAL_FLASH_PREFETCH_BUFFER_ENABLE();
+  if (HAL_RCC_ClockConfig(&RCC_ClkInitStruct, FLASH_LATENCY_2) != HAL_OK)
+    Error_Handler();
+}
+
+static void relocate_vector_table(void)
+{
+  memcpy(ram_vector_table, vector_table, sizeof(vector_table));
+  // programming manual pg. 99
+  __DMB();
+  SCB->VTOR = (uint32_t)ram_vector_table;
+  // programming manual pg. 100
+  __DSB();
+}
+
 static void led_blink(void)
 {
   static uint32_t current_ticks = LED_DELAY;
@@ -290,28 +499,21 @@ static void led_blink(void)
 
 static void start_application_code()
 {
-  uint32_t app_msp = GET_VALUE_FROM_ADDR(APP_START_ADDRESS);
-  if (app_msp != SRAM_END)
+  if (!is_application_valid())
     Error_Handler();
 
   HAL_GPIO_DeInit(GPIOC, GPIO_PIN_13);
   HAL_GPIO_DeInit(GPIOB, GPIO_PIN_12);
+
+  // The application starts from the reset clock state: HSI, no PLL
+  if (HAL_RCC_DeInit() != HAL_OK)
+    Error_Handler();
+  __HAL_FLASH_SET_LATENCY(FLASH_LATENCY_0);
   HAL_DeInit();
 
   // references manual pg. 104
   RCC->CIR = 0x00000000; // disable all interrupts related to clock
-  __set_MSP(GET_VALUE_FROM_ADDR(APP_START_ADDRESS));
-  // programming manual pg. 99
-  __DMB();
-  SCB->VTOR = APP_START_ADDRESS;
-  // programming manual pg. 100
-  __DSB();
-
-  uint32_t jump_address = GET_VALUE_FROM_ADDR(
-    APP_START_ADDRESS + sizeof(uint32_t)
-  );
-  void (*reset_handler)(void) = (void*)jump_address;
-  reset_handler();
+  jump_to_application();
 
   // Never coming here
   Error_Handler();
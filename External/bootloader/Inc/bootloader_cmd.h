@@ -6,6 +6,19 @@
 #include "bootloader_io.h"
 #include <stdint.h>
 
+// Boot stages are timestamped by the DWT cycle counter, which is started at
+// the reset vector
+typedef enum
+{
+  BOOT_STAGE_RAM_INIT, // .data and .bss of _bootloader_start
+  BOOT_STAGE_HAL_INIT,
+  BOOT_STAGE_CLOCK_CONFIG,
+  BOOT_STAGE_UART_INIT, // DMA, USART, CRC and NVIC
+  BOOT_STAGE_FIRST_COMMAND,
+  BOOT_STAGES_NUM
+} bootloader_boot_stage;
+
+void bootloader_mark_boot_stage(const bootloader_boot_stage stage);
 bootloader_status bootloader_start_output(void);
 bootloader_status bootloader_proccess_input(void);
 
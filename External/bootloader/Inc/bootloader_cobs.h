@@ -0,0 +1,24 @@
+#ifndef BOOTLOADER_COBS_H
+#define BOOTLOADER_COBS_H
+
+#include "bootloader_defs.h"
+#include <stdint.h>
+
+// Consistent overhead byte stuffing. An encoded packet has no
+// FRAME_DELIMITER bytes, so a frame ends at the first delimiter and the
+// receiver is in sync again after a lost or extra byte. The encoding adds
+// one byte per 254 bytes of data and one more.
+
+uint16_t bootloader_cobs_encode(
+  const uint8_t *const data,
+  const uint16_t size,
+  uint8_t *const frame
+);
+bootloader_status bootloader_cobs_decode(
+  const uint8_t *const frame,
+  const uint16_t frame_size,
+  uint8_t *const data,
+  uint16_t *const size
+);
+
+#endif
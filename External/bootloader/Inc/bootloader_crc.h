@@ -0,0 +1,27 @@
+#ifndef BOOTLOADER_CRC_H
+#define BOOTLOADER_CRC_H
+
+#include <stdint.h>
+
+// CRC-32/MPEG-2 (poly 0x04C11DB7, no reflection) - same as the STM32 CRC unit
+#define CRC_INIT 0xFFFFFFFFUL
+// CRC-16/CCITT-FALSE (poly 0x1021, no reflection) - checks framed packets
+#define CRC16_INIT 0xFFFFU
+
+uint32_t bootloader_crc32_update(
+  uint32_t crc,
+  const uint8_t *const data,
+  const uint32_t size
+);
+uint32_t bootloader_crc32_update_words(
+  uint32_t crc,
+  const uint32_t *const data,
+  const uint32_t count
+);
+uint16_t bootloader_crc16_update(
+  uint16_t crc,
+  const uint8_t *const data,
+  const uint32_t size
+);
+
+#endif
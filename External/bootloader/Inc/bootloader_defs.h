@@ -1,10 +1,21 @@
 #ifndef BOOTLOADER_DEFS_H
 #define BOOTLOADER_DEFS_H
 
-#define APP_START_ADDRESS 0x08002800 /* page 10 */
+#define APP_START_ADDRESS 0x08006800 /* page 26 */
+// Installed pages are saved here while cmd_9 rebuilds them
+#define DELTA_SCRATCH_ADDRESS 0x08006000 /* pages 24, 25 */
 #define SRAM_SIZE 20 * 1024
 #define SRAM_END (SRAM_BASE + SRAM_SIZE)
 
+// Optional commands, 0 leaves them out when the bootloader has to fit its
+// pages (APP_START_PAGE) and the host does not need them
+#ifndef BOOTLOADER_WITH_COMPRESSION
+#define BOOTLOADER_WITH_COMPRESSION 1 // cmd_8
+#endif
+#ifndef BOOTLOADER_WITH_DELTA
+#define BOOTLOADER_WITH_DELTA 1 // cmd_9
+#endif
+
 enum
 {
   BOOTLOADER_VER_MAJOR = 0U + '0',
@@ -15,13 +26,70 @@ enum
   CMD_WRITE = 3U + '0',
   CMD_ERASE = 4U + '0',
   CMD_READ = 5U + '0',
-  UART_POLLING_DELAY = 50U,
-  UART_DELAY = 500U,
+  CMD_WRITE_BLOCK = 6U + '0',
+  CMD_SET_BAUD_RATE = 7U + '0',
+  CMD_WRITE_COMPRESSED = 8U + '0',
+  CMD_WRITE_DELTA = 9U + '0',
+  CMD_GET_PAGES_CRC = 10U + '0',
+  CMD_VERIFY = 11U + '0',
+  CMD_READ_BINARY = 12U + '0',
+  CMD_GET_STATS = 13U + '0',
+  CMD_WRITE_WINDOW = 14U + '0',
+  CMD_WRITE_FRAMED = 15U + '0',
+  CMD_SET_TIMEOUTS = 16U + '0',
+  CMD_WRITE_STREAM = 17U + '0',
+  CMD_SET_MODE = 18U + '0',
+  CMD_GET_CAPABILITIES = 19U + '0',
+  COMMANDS_NUM = 20U,
+  PROTOCOL_VERSION = 1U, // of the capabilities descriptor
+  UART_DELAY = 500U, // ms, default frame and byte gaps
+  UART_MIN_FRAME_GAP = 20U,
+  UART_MIN_BYTE_GAP = 2U,
+  UART_BAUD_RATE = 115200U, // initial and fallback baud rate
   LED_DELAY = 500U,
   LED_ERROR_DELAY = 150U,
   UART_BUFFER_SIZE = 150U,
+  BLOCK_SIZE = 1024U, // one flash page
+  FLASH_PAGES_NUM = 128U,
+  FLASH_PAGE_ERASE_TIME = 40U, // ms, the longest page erase of the F103
+  FLASH_HALFWORD_TIME = 70U, // us, the longest halfword programming
+  APP_START_PAGE = 26U,
+  APP_PAGES_NUM = FLASH_PAGES_NUM - APP_START_PAGE,
+  RX_RING_SIZE = 4096U, // power of 2, holds WINDOW_FRAMES_LIMIT block frames
+  TX_CHUNK_SIZE = 0x8000U, // DMA transmission of flash, up to 0xffff
+  LZ_WINDOW_SIZE = 2 * BLOCK_SIZE, // page being decoded + previous one
+  WINDOW_FRAMES_NUM = 32U, // frames in the bitmap of a window response
+  WINDOW_HEADER_SIZE = 8U, // sequence number, address, size
+  WINDOW_RESPONSE_SIZE = 12U,
+  WINDOW_IDLE_TIME = 4U * UART_DELAY, // ms without frames
+  SESSION_IDLE_TIME = 20U * UART_DELAY, // ms without commands
+  FRAME_DELIMITER = 0x00U,
+  FRAME_DATA = 0x01U,
+  FRAME_END = 0x02U,
+  FRAME_ACK = 0x81U,
+  FRAME_NACK = 0x82U,
+  FRAME_UNKNOWN_SEQ = 0xffffU, // sequence number of a corrupted frame
+  FRAME_HEADER_SIZE = 7U, // type, sequence number, address
+  FRAME_MAX_SIZE = FRAME_HEADER_SIZE + BLOCK_SIZE + 2U, // + crc16
+  FRAME_BUFFER_SIZE = FRAME_MAX_SIZE + FRAME_MAX_SIZE / 254U + 1U, // encoded
+  // Encoded cmd_15 frame with its delimiter, more than a cmd_14 one
+  WINDOW_FRAME_OVERHEAD = FRAME_BUFFER_SIZE - BLOCK_SIZE + 1U,
+  // Frames accepted after the first missing one: as many full frames as the
+  // receive ring holds while a block is programmed
+  WINDOW_FRAMES_LIMIT =
+    RX_RING_SIZE / (BLOCK_SIZE + WINDOW_FRAME_OVERHEAD) < WINDOW_FRAMES_NUM ?
+    RX_RING_SIZE / (BLOCK_SIZE + WINDOW_FRAME_OVERHEAD) :
+    WINDOW_FRAMES_NUM,
+  FRAME_RESPONSE_SIZE = 12U,
+  TIMEOUTS_RESPONSE_SIZE = 12U, // gaps, longest gaps, crc32
+  STREAM_RESPONSE_SIZE = 9U, // ACK / NACK, received size, crc32
+  MODE_HUMAN = 0x00U, // ASCII commands, prompts and messages
+  MODE_MACHINE = 0x01U, // binary opcodes (command numbers), no prompts
+  UID_SIZE = 12U, // 96-bit unique device ID
+  CAPABILITIES_SIZE = 37U, // descriptor without its crc32
   ACK_BYTE = 0x55,
   NACK_BYTE = 0xaa,
+  SYNC_BYTE = 0x7f,
   END_SUBSEQUENCE = 0xCC33U
 };
 
@@ -33,6 +101,7 @@ typedef enum
   BOOTLOADER_TIMEOUT = 0x03U,
   BOOTLOADER_BOUNDS_ERROR = 0x04U,
   BOOTLOADER_FLASH_PAGE_ERROR = 0x05U,
+  BOOTLOADER_CRC_ERROR = 0x06U,
 } bootloader_status;
 
 #endif
@@ -0,0 +1,60 @@
+#ifndef BOOTLOADER_DELTA_H
+#define BOOTLOADER_DELTA_H
+
+#include "bootloader_defs.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// Streaming decoder of patches against the installed image. A patch is a
+// sequence of records (little-endian fields):
+// copy: DELTA_OP_COPY, source offset (4 bytes), length (2 bytes)
+// add: DELTA_OP_ADD, source offset (4 bytes), length (2 bytes),
+//   length bytes added to the source ones (bsdiff-like)
+// insert: DELTA_OP_INSERT, length (2 bytes), length bytes
+// The new image is built in place, so the source is readable from the page
+// being built onwards, and the previous page is taken from the backup.
+
+enum
+{
+  DELTA_OP_COPY = 0x01U,
+  DELTA_OP_ADD = 0x02U,
+  DELTA_OP_INSERT = 0x03U
+};
+
+typedef struct
+{
+  uint8_t *window; // two pages: the one being built and the previous one
+  uint32_t position; // number of built bytes
+  const uint8_t *source;
+  uint32_t source_size;
+  const uint8_t *backup; // source content of the previous page
+  const uint8_t *input;
+  uint16_t input_size;
+  uint8_t state;
+  uint8_t op;
+  uint8_t field_index;
+  uint32_t offset;
+  uint16_t length;
+} bootloader_delta_decoder;
+
+void bootloader_delta_init(
+  bootloader_delta_decoder *const decoder,
+  uint8_t *const window,
+  const uint8_t *const source,
+  const uint32_t source_size,
+  const uint8_t *const backup
+);
+void bootloader_delta_set_input(
+  bootloader_delta_decoder *const decoder,
+  const uint8_t *const input,
+  const uint16_t size
+);
+bootloader_status bootloader_delta_decode(
+  bootloader_delta_decoder *const decoder,
+  const uint32_t limit
+);
+bool bootloader_delta_is_finished(
+  const bootloader_delta_decoder *const decoder
+);
+
+#endif
@@ -2,21 +2,57 @@
 #define BOOTLOADER_IO_H
 
 #include <stdint.h>
+#include <stdbool.h>
 #include "bootloader_defs.h"
 
+bootloader_status bootloader_io_init(void);
 bootloader_status bootloader_io_read(
   uint8_t *const data,
   const uint16_t size
 );
+bootloader_status bootloader_io_read_frame(
+  uint8_t *const data,
+  const uint16_t max_size,
+  uint16_t *const size
+);
+bool bootloader_io_wait_input(void);
 bootloader_status bootloader_io_write(
   const uint8_t *const data,
   const uint16_t size
 );
+bootloader_status bootloader_io_write_start(
+  const uint8_t *const data,
+  const uint16_t size
+);
+bootloader_status bootloader_io_write_wait(void);
+bootloader_status bootloader_io_check_baud_rate(const uint32_t baud_rate);
+bootloader_status bootloader_io_set_baud_rate(const uint32_t baud_rate);
 uint32_t bootloader_io_get_dev_id(void);
-bootloader_status bootloader_io_program(
+uint16_t bootloader_io_get_flash_size(void);
+void bootloader_io_get_uid(uint8_t *const uid);
+uint32_t bootloader_io_get_uart_clock(void);
+uint32_t bootloader_io_get_cycles(void);
+uint32_t bootloader_io_get_ticks(void);
+bootloader_status bootloader_io_flash_begin(void);
+bootloader_status bootloader_io_flash_program(
+  const uint32_t address,
+  const uint8_t *const data,
+  const uint16_t size
+);
+bootloader_status bootloader_io_flash_end(void);
+bootloader_status bootloader_io_program_start(
   const uint32_t address,
-  const uint16_t data
+  const uint8_t *const data,
+  const uint16_t size
+);
+bootloader_status bootloader_io_erase_start(
+  uint32_t address,
+  uint8_t pages_num
 );
+bootloader_status bootloader_io_program_wait(void);
+bool bootloader_io_flash_irq(void);
+bool bootloader_io_uart_irq(void);
+bool bootloader_io_rx_dma_irq(void);
 bootloader_status bootloader_io_erase(
   const uint32_t address,
   const uint8_t pages_num
@@ -25,5 +61,14 @@ bootloader_status bootloader_io_read_flash(
   const uint32_t address,
   uint8_t *const value
 );
+bootloader_status bootloader_io_get_flash_crc(
+  const uint32_t address,
+  const uint32_t size,
+  uint32_t *const crc
+);
+const uint8_t *bootloader_io_map_flash(
+  const uint32_t address,
+  const uint32_t size
+);
 
 #endif
@@ -0,0 +1,38 @@
+#ifndef BOOTLOADER_LZ_H
+#define BOOTLOADER_LZ_H
+
+#include "bootloader_defs.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// Streaming decoder of LZ4 block format sequences. The output goes into a
+// ring window of LZ_WINDOW_SIZE bytes, so match offsets are limited to it.
+
+typedef struct
+{
+  uint8_t *window;
+  uint32_t position; // number of decoded bytes
+  const uint8_t *input;
+  uint16_t input_size;
+  uint8_t state;
+  uint8_t match_nibble;
+  uint16_t offset;
+  uint32_t length;
+} bootloader_lz_decoder;
+
+void bootloader_lz_init(
+  bootloader_lz_decoder *const decoder,
+  uint8_t *const window
+);
+void bootloader_lz_set_input(
+  bootloader_lz_decoder *const decoder,
+  const uint8_t *const input,
+  const uint16_t size
+);
+bootloader_status bootloader_lz_decode(
+  bootloader_lz_decoder *const decoder,
+  const uint32_t limit
+);
+bool bootloader_lz_is_finished(const bootloader_lz_decoder *const decoder);
+
+#endif
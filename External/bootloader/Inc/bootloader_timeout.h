@@ -0,0 +1,39 @@
+#ifndef BOOTLOADER_TIMEOUT_H
+#define BOOTLOADER_TIMEOUT_H
+
+#include "bootloader_defs.h"
+#include <stdint.h>
+
+// Timeouts of the line and of flash operations, in ms. A read waits for its
+// first byte up to the frame gap (the host answers a response or sends the
+// next frame), then for every next byte up to the byte gap, so a cut frame
+// is found soon after its last byte. The gaps are set by the host (cmd_16),
+// the longest ones seen are kept for it. Flash deadlines follow the size of
+// an operation.
+
+typedef enum
+{
+  TIMEOUT_FRAME_GAP,
+  TIMEOUT_BYTE_GAP,
+  TIMEOUT_GAPS_NUM
+} bootloader_gap;
+
+void bootloader_timeout_reset(void);
+bootloader_status bootloader_timeout_set(
+  const uint16_t frame_gap,
+  const uint16_t byte_gap
+);
+uint16_t bootloader_timeout_get(const bootloader_gap gap);
+void bootloader_timeout_track(const bootloader_gap gap, const uint32_t time);
+uint16_t bootloader_timeout_get_longest(const bootloader_gap gap);
+void bootloader_timeout_clear_longest(void);
+uint32_t bootloader_timeout_get_line(
+  const uint32_t size,
+  const uint32_t baud_rate
+);
+uint32_t bootloader_timeout_get_flash(
+  const uint8_t pages_num,
+  const uint32_t size
+);
+
+#endif
@@ -1,5 +1,10 @@
 #include "bootloader_cmd.h"
 #include "bootloader_defs.h"
+#include "bootloader_crc.h"
+#include "bootloader_cobs.h"
+#include "bootloader_timeout.h"
+#include "bootloader_lz.h"
+#include "bootloader_delta.h"
 #include <string.h>
 #include <stdbool.h>
 
@@ -11,13 +16,63 @@ static char *commands_list_message = "\r\nCommands:\r\n"
   "Get bootloader version - '2';\r\n"
   "Write to memory (2 bytes) - '3';\r\n"
   "Erase - '4';\r\n"
-  "Read pages from flash - '5'.\r\n";
+  "Read pages from flash - '5';\r\n"
+  "Write block to memory (up to 1 page) - '6';\r\n"
+  "Set baud rate - '7';\r\n"
+#if BOOTLOADER_WITH_COMPRESSION
+  "Write compressed data - '8';\r\n"
+#endif
+#if BOOTLOADER_WITH_DELTA
+  "Write patch to application - '9';\r\n"
+#endif
+  "Get CRC of application pages - ':';\r\n"
+  "Get CRC of flash range - ';';\r\n"
+  "Read flash range (binary) - '<';\r\n"
+  "Get boot and command cycles - '=';\r\n"
+  "Write blocks with a window - '>';\r\n"
+  "Write blocks in COBS frames - '?';\r\n"
+  "Set timeouts - '@';\r\n"
+  "Write raw stream - 'A';\r\n"
+  "Set mode (0 - human, 1 - machine) - 'B';\r\n"
+  "Get capabilities - 'C'.\r\n";
 static char *id_message = "\r\nChip ID: ";
 static char *bootloader_version_message = "\r\nBootloader version: ";
 static char *read_message = "\r\nEnter flash page number(000 - 127): ";
 
 static uint8_t uart_buffer[UART_BUFFER_SIZE];
+// While one block is programmed, the next one is received into the other
+// Also serves as the decoding window: one page per buffer
+static uint8_t block_buffers[2][BLOCK_SIZE];
+static uint8_t chunk_buffer[BLOCK_SIZE];
+#if BOOTLOADER_WITH_COMPRESSION
+static bootloader_lz_decoder lz_decoder;
+static uint32_t lz_address;
+static uint32_t lz_size;
+#endif
+#if BOOTLOADER_WITH_DELTA
+static bootloader_delta_decoder delta_decoder;
+static uint32_t delta_size;
+// Installed content of a rewritten page is kept in the scratch page of its
+// parity, patches may still copy it and a resumed patch needs it
+static const uint8_t *delta_scratch;
+static uint16_t delta_first_page; // pages before it are rebuilt already
+static uint16_t delta_saved_page; // its scratch page holds it already
+#endif
 static char* hex_symbols = "0123456789ABCDEF";
+// DWT cycles: boot stages since the reset vector, commands - the last call
+static uint32_t boot_stage_cycles[BOOT_STAGES_NUM];
+static bool is_first_command = true;
+static uint32_t command_calls[COMMANDS_NUM];
+static uint32_t command_cycles[COMMANDS_NUM];
+// Windowed transfer: frames before window_next_seq are received, bit i of
+// window_received - frame window_next_seq + 1 + i
+static uint16_t window_next_seq;
+static uint32_t window_received;
+static uint32_t window_erased_pages[(APP_PAGES_NUM + 31) / 32];
+// Encoded frame of cmd_15, decoded in place
+static uint8_t frame_buffer[FRAME_BUFFER_SIZE];
+static bool is_machine_mode;
+static uint32_t last_command_ticks; // end of the last command, ms
 
 // Static functions ----------------------------------------------------------
 
@@ -66,105 +121,1148 @@ static void send_response(bootloader_status status)
   (void)bootloader_io_write(uart_buffer, 1);
 }
 
+static uint32_t get_block_crc(
+  const uint32_t address,
+  const uint8_t *const block,
+  const uint16_t size
+)
+{
+  uint32_t crc = bootloader_crc32_update(
+    CRC_INIT,
+    (uint8_t*)&address,
+    sizeof(uint32_t)
+  );
+  crc = bootloader_crc32_update(crc, (uint8_t*)&size, sizeof(uint16_t));
+
+  return bootloader_crc32_update(crc, block, size);
+}
+
+// A page starting inside the block is erased in the background ahead of it
+static bootloader_status program_block(
+  const uint32_t address,
+  const uint8_t *const data,
+  const uint16_t size
+)
+{
+  uint32_t page = (address + BLOCK_SIZE - 1) & ~(BLOCK_SIZE - 1);
+  bootloader_status status = BOOTLOADER_OK;
+
+  if (page - address < size)
+    status |= bootloader_io_erase_start(page, 1);
+  if (status == BOOTLOADER_OK)
+    status |= bootloader_io_program_start(address, data, size);
+
+  return status;
+}
+
+#if BOOTLOADER_WITH_COMPRESSION
+static bootloader_status program_decoded(
+  const uint32_t position,
+  const uint16_t size
+)
+{
+  bootloader_status status = bootloader_io_program_wait();
+  if (status)
+    return status;
+
+  return program_block(
+    lz_address + position,
+    lz_decoder.window + (position & (LZ_WINDOW_SIZE - 1)),
+    size
+  );
+}
+
+// Each completed page is programmed from its half of the window while the
+// next one is decoded into the other half
+static bootloader_status decode_chunk(const uint16_t size)
+{
+  bootloader_status status = BOOTLOADER_OK;
+
+  bootloader_lz_set_input(&lz_decoder, chunk_buffer, size);
+  while (status == BOOTLOADER_OK)
+  {
+    uint32_t page_end = (lz_decoder.position / BLOCK_SIZE + 1) * BLOCK_SIZE;
+    if (page_end > lz_size)
+      page_end = lz_size;
+
+    status |= bootloader_lz_decode(&lz_decoder, page_end);
+    // Stops before the limit only when the chunk is over
+    if (status || lz_decoder.position < page_end)
+      break;
+
+    if (page_end % BLOCK_SIZE == 0)
+      status |= program_decoded(page_end - BLOCK_SIZE, BLOCK_SIZE);
+    if (page_end == lz_size)
+      break;
+  }
+
+  if (status == BOOTLOADER_OK && lz_decoder.input_size)
+    status |= BOOTLOADER_BOUNDS_ERROR;
+
+  return status;
+}
+
+static bootloader_status finish_decoding()
+{
+  uint32_t position = lz_decoder.position;
+  uint16_t size = position % BLOCK_SIZE;
+  bootloader_status status = BOOTLOADER_OK;
+
+  if (position != lz_size || !bootloader_lz_is_finished(&lz_decoder))
+    status |= BOOTLOADER_ERROR;
+
+  if (status == BOOTLOADER_OK && size)
+  {
+    // Halfword programming: pad with the erased value
+    if (size % sizeof(uint16_t))
+      lz_decoder.window[position & (LZ_WINDOW_SIZE - 1)] = 0xff;
+    status |= program_decoded(position - size, size + size % sizeof(uint16_t));
+  }
+
+  return status | bootloader_io_program_wait();
+}
+#endif
+
+#if BOOTLOADER_WITH_DELTA
+// Bytes of the installed image in the page at the position
+static uint16_t get_installed_size(const uint32_t position)
+{
+  if (position >= delta_decoder.source_size)
+    return 0;
+
+  return delta_decoder.source_size - position < BLOCK_SIZE ?
+    delta_decoder.source_size - position :
+    BLOCK_SIZE;
+}
+
+static const uint8_t *get_scratch_page(const uint32_t position)
+{
+  return delta_scratch + (position / BLOCK_SIZE % 2) * BLOCK_SIZE;
+}
+
+// The installed content is saved to the scratch page before the page is
+// erased, so a patch interrupted at any point can be resumed
+static bootloader_status save_installed_page(const uint32_t position)
+{
+  uint16_t size = get_installed_size(position);
+  uint32_t address = DELTA_SCRATCH_ADDRESS +
+    (uint32_t)(get_scratch_page(position) - delta_scratch);
+
+  if (size == 0 || position / BLOCK_SIZE == delta_saved_page)
+    return BOOTLOADER_OK;
+
+  bootloader_status status = program_block(
+    address,
+    delta_decoder.source + position,
+    size + size % sizeof(uint16_t)
+  );
+  return status | bootloader_io_program_wait();
+}
+
+// The installed content of the pages around the first one is either in place
+// or in the scratch pages, which is found by the crc32 of the installed
+// application from the page before the first one onwards. The first page is
+// put back in place, the previous one is only copied from.
+static bootloader_status find_installed_pages(const uint32_t crc)
+{
+  uint32_t position = delta_first_page * BLOCK_SIZE;
+  uint32_t tail = get_installed_size(position) == BLOCK_SIZE ?
+    delta_decoder.source_size - position - BLOCK_SIZE :
+    0;
+
+  for (uint8_t i = 0; i < 4; i++)
+  {
+    const uint8_t *previous = i & 1 ?
+      get_scratch_page(position - BLOCK_SIZE) :
+      delta_decoder.source + position - BLOCK_SIZE;
+    const uint8_t *current = i & 2 ?
+      get_scratch_page(position) :
+      delta_decoder.source + position;
+    uint32_t result = bootloader_crc32_update(
+      CRC_INIT, previous, get_installed_size(position - BLOCK_SIZE)
+    );
+
+    result = bootloader_crc32_update(
+      result, current, get_installed_size(position)
+    );
+    result = bootloader_crc32_update(
+      result, delta_decoder.source + position + BLOCK_SIZE, tail
+    );
+    if (result != crc)
+      continue;
+
+    delta_decoder.backup = previous;
+    if ((i & 2) == 0)
+      return BOOTLOADER_OK;
+
+    delta_saved_page = delta_first_page;
+    bootloader_status status = program_block(
+      APP_START_ADDRESS + position,
+      current,
+      get_installed_size(position) + get_installed_size(position) % 2
+    );
+    return status | bootloader_io_program_wait();
+  }
+
+  return BOOTLOADER_CRC_ERROR;
+}
+
+static bootloader_status write_delta_page(
+  const uint32_t position,
+  const uint16_t size
+)
+{
+  const uint8_t *const page = delta_decoder.window +
+    (position & (2 * BLOCK_SIZE - 1));
+  uint32_t address = APP_START_ADDRESS + position;
+
+  // Rebuilt before the patch was resumed
+  if (position < delta_first_page * BLOCK_SIZE)
+    return BOOTLOADER_OK;
+
+  bootloader_status status = bootloader_io_program_wait();
+  if (status)
+    return status;
+
+  // Unchanged pages are neither erased nor programmed
+  if (
+    get_installed_size(position) >= size &&
+    memcmp(page, delta_decoder.source + position, size) == 0
+  )
+  {
+    delta_decoder.backup = delta_decoder.source + position;
+    return BOOTLOADER_OK;
+  }
+
+  status |= save_installed_page(position);
+  delta_decoder.backup = get_scratch_page(position);
+  if (status)
+    return status;
+
+  return program_block(address, page, size);
+}
+
+static bootloader_status decode_delta_chunk(const uint16_t size)
+{
+  bootloader_status status = BOOTLOADER_OK;
+
+  bootloader_delta_set_input(&delta_decoder, chunk_buffer, size);
+  while (status == BOOTLOADER_OK)
+  {
+    uint32_t page_end = (delta_decoder.position / BLOCK_SIZE + 1) *
+      BLOCK_SIZE;
+    if (page_end > delta_size)
+      page_end = delta_size;
+
+    status |= bootloader_delta_decode(&delta_decoder, page_end);
+    if (status || delta_decoder.position < page_end)
+      break;
+
+    if (page_end % BLOCK_SIZE == 0)
+      status |= write_delta_page(page_end - BLOCK_SIZE, BLOCK_SIZE);
+    if (page_end == delta_size)
+      break;
+  }
+
+  if (status == BOOTLOADER_OK && delta_decoder.input_size)
+    status |= BOOTLOADER_BOUNDS_ERROR;
+
+  return status;
+}
+
+static bootloader_status finish_delta()
+{
+  uint32_t position = delta_decoder.position;
+  uint16_t size = position % BLOCK_SIZE;
+  bootloader_status status = BOOTLOADER_OK;
+
+  if (position != delta_size || !bootloader_delta_is_finished(&delta_decoder))
+    status |= BOOTLOADER_ERROR;
+
+  if (status == BOOTLOADER_OK && size)
+  {
+    if (size % sizeof(uint16_t))
+      delta_decoder.window[position & (2 * BLOCK_SIZE - 1)] = 0xff;
+    status |= write_delta_page(
+      position - size,
+      size + size % sizeof(uint16_t)
+    );
+  }
+
+  return status | bootloader_io_program_wait();
+}
+#endif
+
+#if BOOTLOADER_WITH_COMPRESSION || BOOTLOADER_WITH_DELTA
+// Reads the size of a stream chunk (0 - end of stream), the chunk and its
+// crc32, which covers the size and the chunk
+static bootloader_status receive_chunk(uint16_t *const size)
+{
+  uint32_t crc = 0;
+  bootloader_status status = bootloader_io_read(
+    (uint8_t*)size,
+    sizeof(uint16_t)
+  );
+
+  if (status == BOOTLOADER_OK && *size == 0)
+    return status;
+  if (*size > BLOCK_SIZE)
+    status |= BOOTLOADER_BOUNDS_ERROR;
+
+  if (status == BOOTLOADER_OK)
+  {
+    status |= bootloader_io_read(chunk_buffer, *size);
+    status |= bootloader_io_read((uint8_t*)&crc, sizeof(uint32_t));
+  }
+  if (status == BOOTLOADER_OK)
+  {
+    uint32_t chunk_crc = bootloader_crc32_update(
+      CRC_INIT,
+      (uint8_t*)size,
+      sizeof(uint16_t)
+    );
+    if (crc != bootloader_crc32_update(chunk_crc, chunk_buffer, *size))
+      status |= BOOTLOADER_CRC_ERROR;
+  }
+
+  return status;
+}
+#endif
+
+static void record_command(const uint8_t cmd, const uint32_t start_cycles)
+{
+  uint8_t index = cmd - CMD_HELP;
+
+  if (index >= COMMANDS_NUM)
+    return;
+
+  command_calls[index]++;
+  command_cycles[index] = bootloader_io_get_cycles() - start_cycles;
+}
+
 static bool is_not_num(const char input)
 {
-  return input < '0' || input > '9';
+  return input < '0' || input > '9';
+}
+
+static uint8_t read_string()
+{
+  bootloader_status status = BOOTLOADER_OK;
+  int8_t index = 0;
+  uint8_t page = 0;
+
+  memset(uart_buffer, 0, 3);
+
+  while (true)
+  {
+    status = bootloader_io_read(uart_buffer + index, sizeof(char));
+
+    if ((status == BOOTLOADER_TIMEOUT) | is_not_num(uart_buffer[index]))
+      continue;
+
+    (void)bootloader_io_write(uart_buffer + index, 1);
+
+    index++;
+    if (index > 2)
+      break;
+  }
+
+  int8_t rank = 1;
+  for (int8_t i = index - 1; i >= 0; i--)
+  {
+    page += (uart_buffer[i] - '0') * rank;
+    rank *= 10;
+  }
+
+  return page;
+}
+
+static void cmd_help()
+{
+  // The list is longer than uart_buffer, so it is sent in place
+  bootloader_io_write(
+    (uint8_t*)commands_list_message,
+    strlen(commands_list_message) + 1
+  );
+}
+
+// A host that left its session (gaps of cmd_16, machine mode) is taken as
+// gone after SESSION_IDLE_TIME without commands, so the next one, maybe
+// typing by hand, gets the defaults
+static void check_session_idle()
+{
+  if (bootloader_io_get_ticks() - last_command_ticks < SESSION_IDLE_TIME)
+    return;
+
+  bootloader_timeout_reset();
+  is_machine_mode = false;
+}
+
+// In machine mode: the command number as the opcode, anything else is
+// unknown
+static uint8_t get_command(const uint8_t input)
+{
+  if (!is_machine_mode)
+    return input;
+
+  return input < COMMANDS_NUM ? input + CMD_HELP : 0xffU;
+}
+
+// Commands with text answers have binary ones in machine mode, help and
+// read of a page (see cmd_12) are not available
+static bool is_text_only(const uint8_t cmd)
+{
+  return is_machine_mode && (cmd == CMD_HELP || cmd == CMD_READ);
+}
+
+// Machine mode: ACK, dev id (4 bytes)
+static void cmd_get_id()
+{
+  if (is_machine_mode)
+  {
+    uint32_t id = bootloader_io_get_dev_id();
+
+    uart_buffer[0] = ACK_BYTE;
+    memcpy(uart_buffer + 1, &id, sizeof(uint32_t));
+    bootloader_io_write(uart_buffer, 1 + sizeof(uint32_t));
+    return;
+  }
+
+  strncpy((char*)uart_buffer, id_message, strlen(id_message) + 1);
+  bootloader_io_write(uart_buffer, strlen(id_message) + 1);
+
+  uint8_t size = int_to_string(uart_buffer, bootloader_io_get_dev_id());
+  bootloader_io_write(uart_buffer, size);
+}
+
+// Machine mode: ACK, major and minor numbers (1 byte each)
+static void cmd_get_bootloader_version()
+{
+  uint16_t message_size = strlen(bootloader_version_message) + 1;
+
+  if (is_machine_mode)
+  {
+    uart_buffer[0] = ACK_BYTE;
+    uart_buffer[1] = BOOTLOADER_VER_MAJOR - '0';
+    uart_buffer[2] = BOOTLOADER_VER_MINOR - '0';
+    bootloader_io_write(uart_buffer, 3);
+    return;
+  }
+
+  strncpy((char*)uart_buffer, bootloader_version_message, message_size);
+  bootloader_io_write(uart_buffer, message_size);
+
+  uart_buffer[0] = BOOTLOADER_VER_MAJOR;
+  uart_buffer[1] = '.';
+  uart_buffer[2] = BOOTLOADER_VER_MINOR;
+
+  bootloader_io_write(uart_buffer, 3);
+}
+
+// cmd_0: address (4 bytes)
+// cmd_0: data (2 bytes)
+static bootloader_status cmd_write()
+{
+  uint32_t address = 0;
+  uint16_t data = 0;
+  uint32_t num = 0;
+  bootloader_status status = bootloader_io_flash_begin();
+
+  send_response(status);
+  if (status)
+    return status;
+
+  while (true) {
+    status |= bootloader_io_read(
+      (uint8_t*)&address,
+      sizeof(uint32_t)
+    );
+    if (address == END_SUBSEQUENCE)
+      break;
+
+    status |= bootloader_io_read((uint8_t*)&data, sizeof(uint16_t));
+
+    if (status == BOOTLOADER_OK)
+      status |= bootloader_io_flash_program(
+        address,
+        (uint8_t*)&data,
+        sizeof(uint16_t)
+      );
+
+    send_response(status);
+    if (status)
+      break;
+    num++;
+  }
+
+  return status | bootloader_io_flash_end();
+}
+
+// The rest of a frame that can not be delimited is skipped with the frames
+// after it: the host stops when its window is full and the line goes idle
+static void skip_input()
+{
+  while (bootloader_io_read(uart_buffer, 1) != BOOTLOADER_TIMEOUT);
+}
+
+// cmd_6: address (4 bytes) / end sequence
+// cmd_6: data size (2 bytes, up to BLOCK_SIZE)
+// cmd_6: data (size bytes)
+// cmd_6: crc32 of address, size and data (4 bytes)
+// ACK of a block means that it is received and the previous one is
+// programmed. The end sequence is answered when the last one is programmed.
+// Pages are erased ahead of the blocks that start them. After NACK the
+// blocks in flight are skipped, so their data is not taken as commands.
+static bootloader_status cmd_write_block()
+{
+  uint32_t address = 0;
+  uint16_t size = 0;
+  uint32_t crc = 0;
+  uint8_t active = 0;
+  bootloader_status status = BOOTLOADER_OK;
+
+  send_response(status);
+  while (true) {
+    uint8_t *const block = block_buffers[active];
+
+    status |= bootloader_io_read(
+      (uint8_t*)&address,
+      sizeof(uint32_t)
+    );
+    if (address == END_SUBSEQUENCE)
+    {
+      status |= bootloader_io_program_wait();
+      send_response(status);
+      break;
+    }
+
+    status |= bootloader_io_read((uint8_t*)&size, sizeof(uint16_t));
+    if (size == 0 || size > BLOCK_SIZE || size % sizeof(uint16_t))
+      status |= BOOTLOADER_BOUNDS_ERROR;
+
+    if (status == BOOTLOADER_OK)
+    {
+      status |= bootloader_io_read(block, size);
+      status |= bootloader_io_read((uint8_t*)&crc, sizeof(uint32_t));
+    }
+    if (status == BOOTLOADER_OK && crc != get_block_crc(address, block, size))
+      status |= BOOTLOADER_CRC_ERROR;
+
+    status |= bootloader_io_program_wait();
+    if (status == BOOTLOADER_OK)
+      status |= program_block(address, block, size);
+
+    send_response(status);
+    if (status)
+    {
+      skip_input();
+      break;
+    }
+    active ^= 1;
+  }
+
+  return status;
+}
+
+static void reset_window()
+{
+  window_next_seq = 0;
+  window_received = 0;
+  memset(window_erased_pages, 0, sizeof(window_erased_pages));
+}
+
+// Response to a frame of cmd_14: ACK/NACK, status (1 byte), the first
+// missing sequence number (2 bytes), received frames after it (4 bytes),
+// crc32 of the response (4 bytes)
+static bootloader_status send_window_response(bootloader_status status)
+{
+  uint32_t crc = 0;
+
+  uart_buffer[0] = status ? NACK_BYTE : ACK_BYTE;
+  uart_buffer[1] = status;
+  memcpy(uart_buffer + 2, &window_next_seq, sizeof(uint16_t));
+  memcpy(uart_buffer + 4, &window_received, sizeof(uint32_t));
+  crc = bootloader_crc32_update(CRC_INIT, uart_buffer, 8);
+  memcpy(uart_buffer + 8, &crc, sizeof(uint32_t));
+
+  return bootloader_io_write(uart_buffer, WINDOW_RESPONSE_SIZE);
+}
+
+static bootloader_status check_window_frame(
+  const uint16_t seq,
+  const uint32_t address,
+  const uint16_t size
+)
+{
+  if (size > BLOCK_SIZE || size % sizeof(uint16_t))
+    return BOOTLOADER_BOUNDS_ERROR;
+  if (seq > window_next_seq && seq - window_next_seq > WINDOW_FRAMES_LIMIT)
+    return BOOTLOADER_BOUNDS_ERROR;
+  if (
+    size &&
+    (address < APP_START_ADDRESS ||
+    address - APP_START_ADDRESS > APP_PAGES_NUM * BLOCK_SIZE - size)
+  )
+    return BOOTLOADER_BOUNDS_ERROR;
+
+  return BOOTLOADER_OK;
+}
+
+// Returns false for a frame that is received already
+static bool mark_window_frame(const uint16_t seq)
+{
+  if (seq < window_next_seq)
+    return false;
+
+  if (seq == window_next_seq)
+  {
+    window_next_seq++;
+    while (window_received & 1)
+    {
+      window_received >>= 1;
+      window_next_seq++;
+    }
+    window_received >>= 1;
+    return true;
+  }
+
+  uint32_t bit = 1UL << (seq - window_next_seq - 1);
+  if (window_received & bit)
+    return false;
+  window_received |= bit;
+
+  return true;
+}
+
+// A page is erased ahead of the first frame for it, so the frames may come
+// in any order. A frame covers two pages at most.
+static bootloader_status erase_window_pages(
+  const uint32_t address,
+  const uint16_t size
+)
+{
+  uint32_t first_page = (address - APP_START_ADDRESS) / BLOCK_SIZE;
+  uint32_t last_page = (address + size - 1 - APP_START_ADDRESS) / BLOCK_SIZE;
+  uint32_t erase_page = 0;
+  uint8_t pages_num = 0;
+
+  for (uint32_t page = first_page; page <= last_page; page++)
+  {
+    uint32_t bit = 1UL << (page % 32);
+
+    if (window_erased_pages[page / 32] & bit)
+      continue;
+    if (pages_num++ == 0)
+      erase_page = page;
+    window_erased_pages[page / 32] |= bit;
+  }
+
+  if (pages_num == 0)
+    return BOOTLOADER_OK;
+
+  return bootloader_io_erase_start(
+    APP_START_ADDRESS + erase_page * BLOCK_SIZE,
+    pages_num
+  );
+}
+
+// The block is programmed in the background, so its buffer is not used
+// until the next frame
+static bootloader_status program_window_frame(
+  const uint32_t address,
+  const uint8_t *const block,
+  const uint16_t size
+)
+{
+  bootloader_status status = bootloader_io_program_wait();
+
+  if (status == BOOTLOADER_OK)
+    status |= erase_window_pages(address, size);
+  if (status == BOOTLOADER_OK)
+    status |= bootloader_io_program_start(address, block, size);
+
+  return status;
+}
+
+// The end frame carries the number of frames, it is answered when all of
+// them are received and programmed
+static bootloader_status finish_window(const uint16_t seq)
+{
+  bootloader_status status = bootloader_io_program_wait();
+
+  if (status == BOOTLOADER_OK && seq != window_next_seq)
+    status |= BOOTLOADER_BOUNDS_ERROR;
+
+  return status;
+}
+
+// The host may wait for responses or program other devices, so the transfer
+// ends after WINDOW_IDLE_TIME without frames, whatever the frame gap
+static bool is_idle_allowed(uint32_t *const idle_time)
+{
+  *idle_time += bootloader_timeout_get(TIMEOUT_FRAME_GAP);
+
+  return *idle_time < WINDOW_IDLE_TIME;
+}
+
+// cmd_14: sequence number (2 bytes, from 0)
+// cmd_14: address (4 bytes)
+// cmd_14: data size (2 bytes, up to BLOCK_SIZE, 0 - end of transfer)
+// cmd_14: data (size bytes)
+// cmd_14: crc32 of the frame (4 bytes)
+// Every frame is answered by send_window_response. Frames are programmed
+// as they come within WINDOW_FRAMES_LIMIT after the first missing one, a
+// repeated frame is only answered. Corrupted and undelimited frames are
+// answered with NACK (CRC_ERROR, BOUNDS_ERROR or TIMEOUT) and the transfer
+// goes on, the host sends the missing frames again. The end frame is
+// answered when all frames before it are programmed. Programming errors
+// end the command.
+static bootloader_status cmd_write_window()
+{
+  uint8_t header[WINDOW_HEADER_SIZE];
+  uint16_t seq = 0;
+  uint32_t address = 0;
+  uint16_t size = 0;
+  uint32_t crc = 0;
+  uint8_t active = 0;
+  uint32_t idle_time = 0;
+  bootloader_status status = BOOTLOADER_OK;
+
+  reset_window();
+  send_response(status);
+  while (true) {
+    uint8_t *const block = block_buffers[active];
+
+    status = bootloader_io_read(header, WINDOW_HEADER_SIZE);
+    if (status == BOOTLOADER_TIMEOUT && is_idle_allowed(&idle_time))
+      continue;
+    if (status)
+      break;
+    idle_time = 0;
+
+    memcpy(&seq, header, sizeof(uint16_t));
+    memcpy(&address, header + 2, sizeof(uint32_t));
+    memcpy(&size, header + 6, sizeof(uint16_t));
+    status |= check_window_frame(seq, address, size);
+    if (status == BOOTLOADER_OK && size)
+      status |= bootloader_io_read(block, size);
+    if (status == BOOTLOADER_OK)
+      status |= bootloader_io_read((uint8_t*)&crc, sizeof(uint32_t));
+    if (status == BOOTLOADER_OK)
+    {
+      uint32_t frame_crc = bootloader_crc32_update(
+        CRC_INIT,
+        header,
+        WINDOW_HEADER_SIZE
+      );
+      if (crc != bootloader_crc32_update(frame_crc, block, size))
+        status |= BOOTLOADER_CRC_ERROR;
+    }
+    if (status == BOOTLOADER_BOUNDS_ERROR)
+      skip_input();
+
+    if (status == BOOTLOADER_OK && size == 0)
+    {
+      status |= finish_window(seq);
+      send_window_response(status);
+      if (status != BOOTLOADER_BOUNDS_ERROR)
+        break;
+      continue;
+    }
+
+    if (status == BOOTLOADER_OK && mark_window_frame(seq))
+    {
+      status |= program_window_frame(address, block, size);
+      if (status)
+      {
+        send_window_response(status);
+        break;
+      }
+      active ^= 1;
+    }
+    send_window_response(status);
+  }
+
+  if (status == BOOTLOADER_TIMEOUT)
+    send_window_response(status);
+
+  return status;
+}
+
+// Response to a frame of cmd_15, in a COBS frame with FRAME_DELIMITER after
+// it: FRAME_ACK/FRAME_NACK, status (1 byte), sequence number of the frame
+// (2 bytes, FRAME_UNKNOWN_SEQ for a corrupted one), the first missing
+// sequence number (2 bytes), received frames after it (4 bytes), crc16 of
+// the response (2 bytes)
+static bootloader_status send_frame_response(
+  bootloader_status status,
+  const uint16_t seq
+)
+{
+  uint8_t response[FRAME_RESPONSE_SIZE];
+  uint16_t crc = 0;
+  uint16_t size = 0;
+
+  response[0] = status ? FRAME_NACK : FRAME_ACK;
+  response[1] = status;
+  memcpy(response + 2, &seq, sizeof(uint16_t));
+  memcpy(response + 4, &window_next_seq, sizeof(uint16_t));
+  memcpy(response + 6, &window_received, sizeof(uint32_t));
+  crc = bootloader_crc16_update(CRC16_INIT, response, 10);
+  memcpy(response + 10, &crc, sizeof(uint16_t));
+
+  size = bootloader_cobs_encode(response, FRAME_RESPONSE_SIZE, uart_buffer);
+  uart_buffer[size++] = FRAME_DELIMITER;
+
+  return bootloader_io_write(uart_buffer, size);
+}
+
+// Decodes a frame of cmd_15 in frame_buffer. A frame that is cut or merged
+// with another one fails the crc16, its sequence number is not known.
+static bootloader_status parse_frame(
+  const uint16_t frame_size,
+  uint16_t *const seq,
+  uint32_t *const address,
+  uint16_t *const size
+)
+{
+  uint16_t decoded_size = 0;
+  uint16_t crc = 0;
+
+  *seq = FRAME_UNKNOWN_SEQ;
+  if (
+    bootloader_cobs_decode(
+      frame_buffer,
+      frame_size,
+      frame_buffer,
+      &decoded_size
+    ) ||
+    decoded_size < 3 + sizeof(uint16_t)
+  )
+    return BOOTLOADER_CRC_ERROR;
+
+  decoded_size -= sizeof(uint16_t);
+  memcpy(&crc, frame_buffer + decoded_size, sizeof(uint16_t));
+  if (crc != bootloader_crc16_update(CRC16_INIT, frame_buffer, decoded_size))
+    return BOOTLOADER_CRC_ERROR;
+
+  memcpy(seq, frame_buffer + 1, sizeof(uint16_t));
+  *address = 0;
+  *size = 0;
+  if (frame_buffer[0] == FRAME_END && decoded_size == 3)
+    return check_window_frame(*seq, *address, *size);
+  if (frame_buffer[0] != FRAME_DATA || decoded_size <= FRAME_HEADER_SIZE)
+    return BOOTLOADER_BOUNDS_ERROR;
+
+  memcpy(address, frame_buffer + 3, sizeof(uint32_t));
+  *size = decoded_size - FRAME_HEADER_SIZE;
+
+  return check_window_frame(*seq, *address, *size);
+}
+
+// cmd_15: COBS frames, each one ends with FRAME_DELIMITER:
+// cmd_15: type (FRAME_DATA or FRAME_END, 1 byte)
+// cmd_15: sequence number (2 bytes, from 0; number of frames for FRAME_END)
+// cmd_15: address (4 bytes, FRAME_DATA only)
+// cmd_15: data (up to BLOCK_SIZE, FRAME_DATA only)
+// cmd_15: crc16 of the frame (2 bytes)
+// Every frame is answered by send_frame_response, the transfer goes as in
+// cmd_14. A corrupted frame ends at the next delimiter, so it is answered
+// at once and the frames after it are taken. Empty frames are skipped: the
+// host starts a frame with a delimiter to end a broken one.
+static bootloader_status cmd_write_framed()
+{
+  uint16_t frame_size = 0;
+  uint16_t seq = 0;
+  uint32_t address = 0;
+  uint16_t size = 0;
+  uint8_t active = 0;
+  uint32_t idle_time = 0;
+  bootloader_status status = BOOTLOADER_OK;
+
+  reset_window();
+  send_response(status);
+  while (true)
+  {
+    status = bootloader_io_read_frame(
+      frame_buffer,
+      FRAME_BUFFER_SIZE,
+      &frame_size
+    );
+    if (status == BOOTLOADER_TIMEOUT && frame_size == 0)
+    {
+      if (is_idle_allowed(&idle_time))
+        continue;
+      break;
+    }
+    idle_time = 0;
+    if (status == BOOTLOADER_OK && frame_size == 0)
+      continue;
+
+    seq = FRAME_UNKNOWN_SEQ;
+    if (status == BOOTLOADER_BOUNDS_ERROR)
+      status = BOOTLOADER_CRC_ERROR; // lost delimiter
+    if (status == BOOTLOADER_OK)
+      status |= parse_frame(frame_size, &seq, &address, &size);
+
+    if (status == BOOTLOADER_OK && frame_buffer[0] == FRAME_END)
+    {
+      status |= finish_window(seq);
+      send_frame_response(status, seq);
+      if (status != BOOTLOADER_BOUNDS_ERROR)
+        break;
+      continue;
+    }
+
+    if (status == BOOTLOADER_OK && mark_window_frame(seq))
+    {
+      uint8_t *const block = block_buffers[active];
+
+      memcpy(block, frame_buffer + FRAME_HEADER_SIZE, size);
+      status |= program_window_frame(address, block, size);
+      if (status)
+      {
+        send_frame_response(status, seq);
+        break;
+      }
+      active ^= 1;
+    }
+    send_frame_response(status, seq);
+  }
+
+  if (status == BOOTLOADER_TIMEOUT)
+    send_frame_response(status, FRAME_UNKNOWN_SEQ);
+
+  return status;
+}
+
+static bool is_stream_in_app(const uint32_t address, const uint32_t size)
+{
+  uint32_t offset = address - APP_START_ADDRESS;
+
+  return address >= APP_START_ADDRESS &&
+    offset < APP_PAGES_NUM * BLOCK_SIZE &&
+    size <= APP_PAGES_NUM * BLOCK_SIZE - offset;
 }
 
-static uint8_t read_string()
+static bootloader_status send_stream_checkpoint(
+  const bootloader_status status,
+  const uint32_t position,
+  const uint32_t crc
+)
+{
+  uart_buffer[0] = status ? NACK_BYTE : ACK_BYTE;
+  memcpy(uart_buffer + 1, &position, sizeof(uint32_t));
+  memcpy(uart_buffer + 5, &crc, sizeof(uint32_t));
+
+  return bootloader_io_write(uart_buffer, STREAM_RESPONSE_SIZE);
+}
+
+// cmd_17: address (4 bytes, even)
+// cmd_17: size (4 bytes, even, within the application area)
+// cmd_17: data (size bytes)
+// The data is programmed from the address on as it comes, a page at a time
+// (the first piece ends at a page boundary). Each piece is answered with a
+// checkpoint: ACK / NACK, received size (4 bytes) and crc32 of the received
+// data (4 bytes). ACK means that the piece is received and the previous one
+// is programmed, the last one is answered when it is programmed. Pages are
+// erased ahead of the pieces that start them.
+static bootloader_status cmd_write_stream()
 {
+  uint32_t address = 0;
+  uint32_t size = 0;
+  uint32_t position = 0;
+  uint32_t crc = CRC_INIT;
+  uint8_t active = 0;
   bootloader_status status = BOOTLOADER_OK;
-  int8_t index = 0;
-  uint8_t page = 0;
 
-  memset(uart_buffer, 0, 3);
+  send_response(status);
+  status |= bootloader_io_read((uint8_t*)&address, sizeof(uint32_t));
+  status |= bootloader_io_read((uint8_t*)&size, sizeof(uint32_t));
+  if (
+    status == BOOTLOADER_OK &&
+    (
+      address % sizeof(uint16_t) ||
+      size % sizeof(uint16_t) ||
+      size == 0 ||
+      !is_stream_in_app(address, size)
+    )
+  )
+    status |= BOOTLOADER_BOUNDS_ERROR;
 
-  while (true)
+  send_response(status);
+  if (status)
+    return status;
+
+  while (status == BOOTLOADER_OK && position < size)
   {
-    status = bootloader_io_read(uart_buffer + index, sizeof(char));
+    uint8_t *const block = block_buffers[active];
+    uint32_t cursor = address + position;
+    uint16_t piece = BLOCK_SIZE - cursor % BLOCK_SIZE;
 
-    if ((status == BOOTLOADER_TIMEOUT) | is_not_num(uart_buffer[index]))
-      continue;
+    if (piece > size - position)
+      piece = size - position;
 
-    (void)bootloader_io_write(uart_buffer + index, 1);
+    status |= bootloader_io_read(block, piece);
+    if (status == BOOTLOADER_OK)
+      crc = bootloader_crc32_update(crc, block, piece);
 
-    index++;
-    if (index > 2)
-      break;
+    status |= bootloader_io_program_wait();
+    if (status == BOOTLOADER_OK)
+      status |= program_block(cursor, block, piece);
+    if (status == BOOTLOADER_OK)
+      position += piece;
+    if (status == BOOTLOADER_OK && position == size)
+      status |= bootloader_io_program_wait();
+
+    (void)send_stream_checkpoint(status, position, crc);
+    active ^= 1;
   }
 
-  int8_t rank = 1;
-  for (int8_t i = index - 1; i >= 0; i--)
+  if (status)
   {
-    page += (uart_buffer[i] - '0') * rank;
-    rank *= 10;
+    // The host stops at the NACK, the data in flight is not taken as commands
+    (void)bootloader_io_program_wait();
+    skip_input();
   }
 
-  return page;
+  return status;
 }
 
-static void cmd_help()
+#if BOOTLOADER_WITH_COMPRESSION
+// cmd_8: page address (4 bytes)
+// cmd_8: decompressed size (4 bytes)
+// cmd_8: chunk size (2 bytes, up to BLOCK_SIZE, 0 - end of stream)
+// cmd_8: chunk (size bytes)
+// cmd_8: crc32 of chunk size and chunk (4 bytes)
+// Chunks form one LZ4 block (offsets up to LZ_WINDOW_SIZE). ACK of a chunk
+// means that it is received and the previous one is decoded. The end of
+// stream is answered when everything is programmed.
+static bootloader_status cmd_write_compressed()
 {
-  uint16_t message_size = strlen(commands_list_message) + 1;
-
-  strncpy((char*)uart_buffer, commands_list_message, message_size);
-  bootloader_io_write(uart_buffer, message_size);
-}
+  uint16_t size = 0;
+  bootloader_status status = BOOTLOADER_OK;
 
-static void cmd_get_id()
-{
-  strncpy((char*)uart_buffer, id_message, strlen(id_message) + 1);
-  bootloader_io_write(uart_buffer, strlen(id_message) + 1);
+  send_response(status);
+  status |= bootloader_io_read((uint8_t*)&lz_address, sizeof(uint32_t));
+  status |= bootloader_io_read((uint8_t*)&lz_size, sizeof(uint32_t));
+  if (lz_address % BLOCK_SIZE || lz_size == 0)
+    status |= BOOTLOADER_BOUNDS_ERROR;
 
-  uint8_t size = int_to_string(uart_buffer, bootloader_io_get_dev_id());
-  bootloader_io_write(uart_buffer, size);
-}
+  send_response(status);
+  if (status)
+    return status;
 
-static void cmd_get_bootloader_version()
-{
-  uint16_t message_size = strlen(bootloader_version_message) + 1;
+  bootloader_lz_init(&lz_decoder, (uint8_t*)block_buffers);
+  while (true)
+  {
+    status |= receive_chunk(&size);
+    if (status == BOOTLOADER_OK && size == 0)
+      break;
 
-  strncpy((char*)uart_buffer, bootloader_version_message, message_size);
-  bootloader_io_write(uart_buffer, message_size);
+    // Also reports a decoding error of the previous chunk
+    send_response(status);
+    if (status)
+    {
+      (void)bootloader_io_program_wait();
+      return status;
+    }
+    status |= decode_chunk(size);
+  }
 
-  uart_buffer[0] = BOOTLOADER_VER_MAJOR;
-  uart_buffer[1] = '.';
-  uart_buffer[2] = BOOTLOADER_VER_MINOR;
+  status |= finish_decoding();
+  send_response(status);
 
-  bootloader_io_write(uart_buffer, 3);
+  return status;
 }
+#endif
 
-// cmd_0: address (4 bytes)
-// cmd_0: data (2 bytes)
-static bootloader_status cmd_write()
+#if BOOTLOADER_WITH_DELTA
+// cmd_9: new application size (4 bytes)
+// cmd_9: installed application size (4 bytes)
+// cmd_9: first page to rebuild (2 bytes, 0 - a new patch)
+// cmd_9: crc32 of the installed application from the page before the first
+// one onwards (4 bytes, the whole application for a new patch)
+// cmd_9: chunks of the patch, as in cmd_8
+// The application at APP_START_ADDRESS is rebuilt page by page. Copies may
+// refer to the installed content from the previous page onwards. Before a
+// changed page is erased its installed content is saved to a scratch page
+// at DELTA_SCRATCH_ADDRESS. If the patch is interrupted, the host resends it
+// from the first page that differs from the new application (cmd_10).
+static bootloader_status cmd_write_delta()
 {
-  uint32_t address = 0;
-  uint16_t data = 0;
-  uint32_t num = 0;
+  uint32_t source_size = 0;
+  uint32_t crc = 0;
+  uint16_t size = 0;
+  const uint8_t *source = NULL;
   bootloader_status status = BOOTLOADER_OK;
 
   send_response(status);
-  while (true) {
-    status |= bootloader_io_read(
-      (uint8_t*)&address,
-      sizeof(uint32_t)
+  status |= bootloader_io_read((uint8_t*)&delta_size, sizeof(uint32_t));
+  status |= bootloader_io_read((uint8_t*)&source_size, sizeof(uint32_t));
+  status |= bootloader_io_read((uint8_t*)&delta_first_page, sizeof(uint16_t));
+  status |= bootloader_io_read((uint8_t*)&crc, sizeof(uint32_t));
+
+  if (status == BOOTLOADER_OK)
+  {
+    source = bootloader_io_map_flash(APP_START_ADDRESS, source_size);
+    delta_scratch = bootloader_io_map_flash(
+      DELTA_SCRATCH_ADDRESS,
+      2 * BLOCK_SIZE
     );
-    if (address == END_SUBSEQUENCE)
-      break;
+  }
+  if (
+    delta_size <= delta_first_page * BLOCK_SIZE ||
+    source == NULL ||
+    delta_scratch == NULL
+  )
+    status |= BOOTLOADER_BOUNDS_ERROR;
 
-    status |= bootloader_io_read((uint8_t*)&data, sizeof(uint16_t));
+  if (status == BOOTLOADER_OK)
+  {
+    bootloader_delta_init(
+      &delta_decoder,
+      (uint8_t*)block_buffers,
+      source,
+      source_size,
+      delta_scratch
+    );
+    delta_saved_page = UINT16_MAX;
+  }
+  // The patch is only valid for the application it was made against
+  if (status == BOOTLOADER_OK && delta_first_page > 0)
+    status |= find_installed_pages(crc);
+  else if (
+    status == BOOTLOADER_OK &&
+    crc != bootloader_crc32_update(CRC_INIT, source, source_size)
+  )
+    status |= BOOTLOADER_CRC_ERROR;
 
-    if (status == BOOTLOADER_OK)
-      status |= bootloader_io_program(address, data);
+  send_response(status);
+  if (status)
+    return status;
+
+  while (true)
+  {
+    status |= receive_chunk(&size);
+    if (status == BOOTLOADER_OK && size == 0)
+      break;
 
     send_response(status);
     if (status)
-      break;
-    num++;
+    {
+      (void)bootloader_io_program_wait();
+      return status;
+    }
+    status |= decode_delta_chunk(size);
   }
 
+  status |= finish_delta();
+  send_response(status);
+
   return status;
 }
+#endif
 
 // cmd_0: address (4 bytes)
 // cmd_0: pages to erase (1 byte)
@@ -189,6 +1287,291 @@ static bootloader_status cmd_erase()
   return status;
 }
 
+// cmd_7: baud rate (4 bytes)
+// The response is sent at the old baud rate. Then the host sends SYNC_BYTE
+// at the new one and gets ACK, otherwise both return to UART_BAUD_RATE.
+static bootloader_status cmd_set_baud_rate()
+{
+  uint32_t baud_rate = 0;
+  bootloader_status status = BOOTLOADER_OK;
+
+  send_response(status);
+  status = bootloader_io_read((uint8_t*)&baud_rate, sizeof(uint32_t));
+
+  if (status == BOOTLOADER_OK)
+    status |= bootloader_io_check_baud_rate(baud_rate);
+  send_response(status);
+  if (status)
+    return status;
+
+  status = bootloader_io_set_baud_rate(baud_rate);
+  if (status == BOOTLOADER_OK)
+    status |= bootloader_io_read(uart_buffer, 1);
+  if (status == BOOTLOADER_OK && uart_buffer[0] != SYNC_BYTE)
+    status |= BOOTLOADER_ERROR;
+
+  if (status)
+  {
+    (void)bootloader_io_set_baud_rate(UART_BAUD_RATE);
+    return status;
+  }
+
+  send_response(status);
+  return status;
+}
+
+// cmd_16: frame gap (2 bytes, ms, 0 - UART_DELAY)
+// cmd_16: byte gap (2 bytes, ms, 0 - UART_DELAY, up to the frame gap)
+// Response: frame gap, byte gap, the longest frame and byte gaps seen since
+// the previous cmd_16 (2 bytes each), crc32 of the response (4 bytes). The
+// host times the round trip of the command to choose the gaps.
+static bootloader_status cmd_set_timeouts()
+{
+  uint16_t gaps[TIMEOUT_GAPS_NUM] = { 0 };
+  uint8_t *const response = uart_buffer;
+  uint32_t crc = 0;
+  bootloader_status status = BOOTLOADER_OK;
+
+  send_response(status);
+  status = bootloader_io_read((uint8_t*)gaps, sizeof(gaps));
+
+  if (status == BOOTLOADER_OK)
+    status |= bootloader_timeout_set(
+      gaps[TIMEOUT_FRAME_GAP],
+      gaps[TIMEOUT_BYTE_GAP]
+    );
+  send_response(status);
+  if (status)
+    return status;
+
+  for (uint8_t i = 0; i < TIMEOUT_GAPS_NUM; i++)
+  {
+    uint16_t gap = bootloader_timeout_get(i);
+    uint16_t longest_gap = bootloader_timeout_get_longest(i);
+
+    memcpy(response + i * sizeof(uint16_t), &gap, sizeof(uint16_t));
+    memcpy(
+      response + (TIMEOUT_GAPS_NUM + i) * sizeof(uint16_t),
+      &longest_gap,
+      sizeof(uint16_t)
+    );
+  }
+  bootloader_timeout_clear_longest();
+  crc = bootloader_crc32_update(CRC_INIT, response, 8);
+  memcpy(response + 8, &crc, sizeof(uint32_t));
+
+  return bootloader_io_write(response, TIMEOUTS_RESPONSE_SIZE);
+}
+
+// cmd_18: mode (1 byte, MODE_HUMAN or MODE_MACHINE)
+// The mode is switched after the answer, so it ends with the prompt only in
+// human mode
+static bootloader_status cmd_set_mode()
+{
+  uint8_t mode = 0;
+  bootloader_status status = BOOTLOADER_OK;
+
+  send_response(status);
+  status |= bootloader_io_read(&mode, sizeof(uint8_t));
+  if (status == BOOTLOADER_OK && mode > MODE_MACHINE)
+    status |= BOOTLOADER_BOUNDS_ERROR;
+
+  send_response(status);
+  if (status == BOOTLOADER_OK)
+    is_machine_mode = mode == MODE_MACHINE;
+
+  return status;
+}
+
+// Response: protocol version (1 byte), bootloader version (2 bytes),
+// commands num (1 byte), supported commands (4 bytes, bit i - command i,
+// in the current mode),
+// page size (2 bytes), block size (2 bytes, data of a frame), receive
+// buffer size (2 bytes), window frames (1 byte), flash size (2 bytes, KB),
+// app start address (4 bytes), unique ID (12 bytes), UART clock (4 bytes),
+// crc32 of the response (4 bytes)
+static bootloader_status cmd_get_capabilities()
+{
+  uint8_t *const response = chunk_buffer;
+  uint32_t commands = (1UL << COMMANDS_NUM) - 1U;
+  uint16_t sizes[3] = { BLOCK_SIZE, BLOCK_SIZE, RX_RING_SIZE };
+  uint16_t flash_size = bootloader_io_get_flash_size();
+  uint32_t address = APP_START_ADDRESS;
+  uint32_t clock = 0;
+  uint32_t crc = 0;
+  uint16_t size = 0;
+
+#if !BOOTLOADER_WITH_COMPRESSION
+  commands &= ~(1UL << (CMD_WRITE_COMPRESSED - '0'));
+#endif
+#if !BOOTLOADER_WITH_DELTA
+  commands &= ~(1UL << (CMD_WRITE_DELTA - '0'));
+#endif
+  for (uint8_t i = 0; i < COMMANDS_NUM; i++)
+    if (is_text_only(CMD_HELP + i))
+      commands &= ~(1UL << i);
+  response[size++] = PROTOCOL_VERSION;
+  response[size++] = BOOTLOADER_VER_MAJOR - '0';
+  response[size++] = BOOTLOADER_VER_MINOR - '0';
+  response[size++] = COMMANDS_NUM;
+  memcpy(response + size, &commands, sizeof(uint32_t));
+  size += sizeof(uint32_t);
+  memcpy(response + size, sizes, sizeof(sizes));
+  size += sizeof(sizes);
+  response[size++] = WINDOW_FRAMES_LIMIT;
+  memcpy(response + size, &flash_size, sizeof(uint16_t));
+  size += sizeof(uint16_t);
+  memcpy(response + size, &address, sizeof(uint32_t));
+  size += sizeof(uint32_t);
+  bootloader_io_get_uid(response + size);
+  size += UID_SIZE;
+  clock = bootloader_io_get_uart_clock();
+  memcpy(response + size, &clock, sizeof(uint32_t));
+  size += sizeof(uint32_t);
+
+  send_response(BOOTLOADER_OK);
+
+  crc = bootloader_crc32_update(CRC_INIT, response, size);
+  memcpy(response + size, &crc, sizeof(uint32_t));
+  size += sizeof(uint32_t);
+
+  return bootloader_io_write(response, size);
+}
+
+// Response: first page (1 byte), pages num (1 byte), crc32 of each page
+// (4 bytes), crc32 of the response (4 bytes). Page crc32 is calculated over
+// words, as by the CRC unit. The pages end with the flash size of cmd_19.
+static bootloader_status cmd_get_pages_crc()
+{
+  uint8_t *const response = chunk_buffer;
+  uint16_t size = 0;
+  uint32_t crc = 0;
+  uint16_t pages_num = bootloader_io_get_flash_size() * 1024U / BLOCK_SIZE -
+    APP_START_PAGE;
+  bootloader_status status = BOOTLOADER_OK;
+
+  if (pages_num > APP_PAGES_NUM)
+    pages_num = APP_PAGES_NUM;
+  response[size++] = APP_START_PAGE;
+  response[size++] = pages_num;
+  for (uint8_t i = 0; i < pages_num && status == BOOTLOADER_OK; i++)
+  {
+    status |= bootloader_io_get_flash_crc(
+      APP_START_ADDRESS + i * BLOCK_SIZE,
+      BLOCK_SIZE,
+      &crc
+    );
+    memcpy(response + size, &crc, sizeof(uint32_t));
+    size += sizeof(uint32_t);
+  }
+
+  send_response(status);
+  if (status)
+    return status;
+
+  crc = bootloader_crc32_update(CRC_INIT, response, size);
+  memcpy(response + size, &crc, sizeof(uint32_t));
+  size += sizeof(uint32_t);
+
+  return bootloader_io_write(response, size);
+}
+
+// cmd_11: address (4 bytes, word aligned)
+// cmd_11: size (4 bytes, multiple of 4)
+// Response: crc32 of the range (4 bytes), calculated over words
+static bootloader_status cmd_verify()
+{
+  uint32_t address = 0;
+  uint32_t size = 0;
+  uint32_t crc = 0;
+  bootloader_status status = BOOTLOADER_OK;
+
+  send_response(status);
+  status |= bootloader_io_read((uint8_t*)&address, sizeof(uint32_t));
+  status |= bootloader_io_read((uint8_t*)&size, sizeof(uint32_t));
+
+  if (status == BOOTLOADER_OK)
+    status |= bootloader_io_get_flash_crc(address, size, &crc);
+  send_response(status);
+  if (status)
+    return status;
+
+  return bootloader_io_write((uint8_t*)&crc, sizeof(uint32_t));
+}
+
+// cmd_12: address (4 bytes, word aligned)
+// cmd_12: size (4 bytes, multiple of 4)
+// Response: the range, then its crc32 (4 bytes), calculated over words
+static bootloader_status cmd_read_binary()
+{
+  uint32_t address = 0;
+  uint32_t size = 0;
+  uint32_t crc = 0;
+  const uint8_t *source = NULL;
+  bootloader_status status = BOOTLOADER_OK;
+
+  send_response(status);
+  status |= bootloader_io_read((uint8_t*)&address, sizeof(uint32_t));
+  status |= bootloader_io_read((uint8_t*)&size, sizeof(uint32_t));
+
+  if (status == BOOTLOADER_OK)
+    status |= bootloader_io_get_flash_crc(address, size, &crc);
+  if (status == BOOTLOADER_OK)
+    source = bootloader_io_map_flash(address, size);
+  if (source == NULL)
+    status |= BOOTLOADER_BOUNDS_ERROR;
+  send_response(status);
+  if (status)
+    return status;
+
+  // Flash is sent in place, the CPU only starts the transmissions
+  for (uint32_t offset = 0; offset < size && status == BOOTLOADER_OK;)
+  {
+    uint16_t chunk_size = size - offset < TX_CHUNK_SIZE ?
+      size - offset :
+      TX_CHUNK_SIZE;
+
+    status |= bootloader_io_write_start(source + offset, chunk_size);
+    offset += chunk_size;
+  }
+  status |= bootloader_io_write_wait();
+
+  if (status == BOOTLOADER_OK)
+    status |= bootloader_io_write((uint8_t*)&crc, sizeof(uint32_t));
+
+  return status;
+}
+
+// Response: stages num (1 byte), cycles of each boot stage (4 bytes),
+// commands num (1 byte), calls and cycles of the last call of each command
+// (4 + 4 bytes, from '0'), crc32 of the response (4 bytes)
+static bootloader_status cmd_get_stats()
+{
+  uint8_t *const response = chunk_buffer;
+  uint16_t size = 0;
+  uint32_t crc = 0;
+
+  response[size++] = BOOT_STAGES_NUM;
+  memcpy(response + size, boot_stage_cycles, sizeof(boot_stage_cycles));
+  size += sizeof(boot_stage_cycles);
+  response[size++] = COMMANDS_NUM;
+  for (uint8_t i = 0; i < COMMANDS_NUM; i++)
+  {
+    memcpy(response + size, &command_calls[i], sizeof(uint32_t));
+    size += sizeof(uint32_t);
+    memcpy(response + size, &command_cycles[i], sizeof(uint32_t));
+    size += sizeof(uint32_t);
+  }
+
+  send_response(BOOTLOADER_OK);
+
+  crc = bootloader_crc32_update(CRC_INIT, response, size);
+  memcpy(response + size, &crc, sizeof(uint32_t));
+  size += sizeof(uint32_t);
+
+  return bootloader_io_write(response, size);
+}
+
 static bootloader_status cmd_read()
 {
   uint8_t page_num = 0;
@@ -239,6 +1622,18 @@ static bootloader_status cmd_read()
 
 // Implementations -----------------------------------------------------------
 
+// A boot starts with its first stage, so the command counters start over
+void bootloader_mark_boot_stage(const bootloader_boot_stage stage)
+{
+  if (stage == BOOT_STAGE_RAM_INIT)
+  {
+    is_first_command = true;
+    memset(command_calls, 0, sizeof(command_calls));
+    memset(command_cycles, 0, sizeof(command_cycles));
+  }
+  boot_stage_cycles[stage] = bootloader_io_get_cycles();
+}
+
 bootloader_status bootloader_start_output()
 {
   bootloader_status status = bootloader_io_write(
@@ -260,7 +1655,21 @@ bootloader_status bootloader_proccess_input()
   if (status == BOOTLOADER_TIMEOUT)
     return status;
 
-  switch(uart_buffer[0])
+  uint32_t start_cycles = bootloader_io_get_cycles();
+  if (is_first_command)
+  {
+    boot_stage_cycles[BOOT_STAGE_FIRST_COMMAND] = start_cycles;
+    is_first_command = false;
+  }
+
+  check_session_idle();
+
+  // The buffer is reused by the commands
+  uint8_t cmd = get_command(uart_buffer[0]);
+  if (is_text_only(cmd))
+    cmd = 0xffU;
+
+  switch(cmd)
   {
     case CMD_HELP:
       cmd_help();
@@ -280,8 +1689,62 @@ bootloader_status bootloader_proccess_input()
     case CMD_READ:
       status |= cmd_read();
       break;
+    case CMD_WRITE_BLOCK:
+      status |= cmd_write_block();
+      break;
+    case CMD_SET_BAUD_RATE:
+      status |= cmd_set_baud_rate();
+      break;
+#if BOOTLOADER_WITH_COMPRESSION
+    case CMD_WRITE_COMPRESSED:
+      status |= cmd_write_compressed();
+      break;
+#endif
+#if BOOTLOADER_WITH_DELTA
+    case CMD_WRITE_DELTA:
+      status |= cmd_write_delta();
+      break;
+#endif
+    case CMD_GET_PAGES_CRC:
+      status |= cmd_get_pages_crc();
+      break;
+    case CMD_VERIFY:
+      status |= cmd_verify();
+      break;
+    case CMD_READ_BINARY:
+      status |= cmd_read_binary();
+      break;
+    case CMD_GET_STATS:
+      status |= cmd_get_stats();
+      break;
+    case CMD_WRITE_WINDOW:
+      status |= cmd_write_window();
+      break;
+    case CMD_WRITE_FRAMED:
+      status |= cmd_write_framed();
+      break;
+    case CMD_SET_TIMEOUTS:
+      status |= cmd_set_timeouts();
+      break;
+    case CMD_WRITE_STREAM:
+      status |= cmd_write_stream();
+      break;
+    case CMD_SET_MODE:
+      status |= cmd_set_mode();
+      break;
+    case CMD_GET_CAPABILITIES:
+      status |= cmd_get_capabilities();
+      break;
+    default:
+      // Unknown commands get the prompt only in human mode
+      if (is_machine_mode)
+        send_response(BOOTLOADER_ERROR);
+      break;
   }
+  record_command(cmd, start_cycles);
 
-  status |= bootloader_io_write((uint8_t*)input_prompt, 4);
+  if (!is_machine_mode)
+    status |= bootloader_io_write((uint8_t*)input_prompt, 4);
+  last_command_ticks = bootloader_io_get_ticks();
   return status;
 }
@@ -0,0 +1,71 @@
+#include "bootloader_cobs.h"
+
+enum
+{
+  COBS_MAX_CODE = 0xffU // a block of 254 bytes without a zero after it
+};
+
+// Implementations -----------------------------------------------------------
+
+// The frame takes up to size + size / 254 + 1 bytes and must not overlap
+// the data. The delimiter is not added.
+uint16_t bootloader_cobs_encode(
+  const uint8_t *const data,
+  const uint16_t size,
+  uint8_t *const frame
+)
+{
+  uint16_t code_position = 0;
+  uint16_t frame_size = 1;
+  uint8_t code = 1;
+
+  for (uint16_t i = 0; i < size; i++)
+  {
+    if (data[i] != FRAME_DELIMITER)
+    {
+      frame[frame_size++] = data[i];
+      code++;
+    }
+    if (data[i] == FRAME_DELIMITER || code == COBS_MAX_CODE)
+    {
+      frame[code_position] = code;
+      code_position = frame_size++;
+      code = 1;
+    }
+  }
+  frame[code_position] = code;
+
+  return frame_size;
+}
+
+// The data is never ahead of the frame, so it may be decoded in place
+bootloader_status bootloader_cobs_decode(
+  const uint8_t *const frame,
+  const uint16_t frame_size,
+  uint8_t *const data,
+  uint16_t *const size
+)
+{
+  uint16_t position = 0;
+  uint16_t data_size = 0;
+
+  while (position < frame_size)
+  {
+    uint8_t code = frame[position++];
+
+    if (code == FRAME_DELIMITER || code - 1 > frame_size - position)
+      return BOOTLOADER_ERROR;
+
+    for (uint8_t i = 1; i < code; i++)
+    {
+      if (frame[position] == FRAME_DELIMITER)
+        return BOOTLOADER_ERROR;
+      data[data_size++] = frame[position++];
+    }
+    if (code != COBS_MAX_CODE && position < frame_size)
+      data[data_size++] = FRAME_DELIMITER;
+  }
+
+  *size = data_size;
+  return BOOTLOADER_OK;
+}
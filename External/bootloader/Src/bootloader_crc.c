@@ -0,0 +1,69 @@
+#include "bootloader_crc.h"
+
+// Nibble table: 64 bytes of flash instead of 1 KB for a byte table
+static const uint32_t crc_table[16] = {
+  0x00000000, 0x04C11DB7, 0x09823B6E, 0x0D4326D9,
+  0x130476DC, 0x17C56B6B, 0x1A864DB2, 0x1E475005,
+  0x2608EDB8, 0x22C9F00F, 0x2F8AD6D6, 0x2B4BCB61,
+  0x350C9B64, 0x31CD86D3, 0x3C8EA00A, 0x384FBDBD
+};
+
+static const uint16_t crc16_table[16] = {
+  0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+  0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+// Implementations -----------------------------------------------------------
+
+uint32_t bootloader_crc32_update(
+  uint32_t crc,
+  const uint8_t *const data,
+  const uint32_t size
+)
+{
+  for (uint32_t i = 0; i < size; i++)
+  {
+    crc ^= (uint32_t)data[i] << 24;
+    crc = (crc << 4) ^ crc_table[crc >> 28];
+    crc = (crc << 4) ^ crc_table[crc >> 28];
+  }
+
+  return crc;
+}
+
+// The CRC unit takes whole words starting from the most significant byte
+uint32_t bootloader_crc32_update_words(
+  uint32_t crc,
+  const uint32_t *const data,
+  const uint32_t count
+)
+{
+  for (uint32_t i = 0; i < count; i++)
+  {
+    uint8_t bytes[sizeof(uint32_t)] = {
+      (uint8_t)(data[i] >> 24),
+      (uint8_t)(data[i] >> 16),
+      (uint8_t)(data[i] >> 8),
+      (uint8_t)data[i]
+    };
+    crc = bootloader_crc32_update(crc, bytes, sizeof(bytes));
+  }
+
+  return crc;
+}
+
+uint16_t bootloader_crc16_update(
+  uint16_t crc,
+  const uint8_t *const data,
+  const uint32_t size
+)
+{
+  for (uint32_t i = 0; i < size; i++)
+  {
+    crc ^= (uint16_t)data[i] << 8;
+    crc = (crc << 4) ^ crc16_table[crc >> 12];
+    crc = (crc << 4) ^ crc16_table[crc >> 12];
+  }
+
+  return crc;
+}
\ No newline at end of file
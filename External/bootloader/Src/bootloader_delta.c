@@ -0,0 +1,188 @@
+#include "bootloader_delta.h"
+
+enum
+{
+  DELTA_STATE_OP,
+  DELTA_STATE_OFFSET,
+  DELTA_STATE_LENGTH,
+  DELTA_STATE_COPY,
+  DELTA_STATE_ADD,
+  DELTA_STATE_INSERT,
+  DELTA_OFFSET_BYTES = 4U,
+  DELTA_LENGTH_BYTES = 2U,
+  DELTA_WINDOW_MASK = 2 * BLOCK_SIZE - 1
+};
+
+// Static functions ----------------------------------------------------------
+
+__attribute__((always_inline))
+inline static void put_byte(
+  bootloader_delta_decoder *const decoder,
+  const uint8_t byte
+)
+{
+  decoder->window[decoder->position & DELTA_WINDOW_MASK] = byte;
+  decoder->position++;
+}
+
+static bootloader_status read_source(
+  bootloader_delta_decoder *const decoder,
+  uint8_t *const byte
+)
+{
+  uint32_t page_start = decoder->position & ~(BLOCK_SIZE - 1);
+  uint32_t offset = decoder->offset;
+
+  if (offset >= decoder->source_size)
+    return BOOTLOADER_BOUNDS_ERROR;
+
+  // Pages before the current one are already rewritten
+  if (offset >= page_start)
+    *byte = decoder->source[offset];
+  else if (offset + BLOCK_SIZE >= page_start)
+    *byte = decoder->backup[offset % BLOCK_SIZE];
+  else
+    return BOOTLOADER_BOUNDS_ERROR;
+
+  decoder->offset++;
+  return BOOTLOADER_OK;
+}
+
+static void finish_byte(bootloader_delta_decoder *const decoder)
+{
+  if (--decoder->length == 0)
+    decoder->state = DELTA_STATE_OP;
+}
+
+static void start_record(bootloader_delta_decoder *const decoder)
+{
+  if (decoder->length == 0)
+    decoder->state = DELTA_STATE_OP;
+  else if (decoder->op == DELTA_OP_COPY)
+    decoder->state = DELTA_STATE_COPY;
+  else if (decoder->op == DELTA_OP_ADD)
+    decoder->state = DELTA_STATE_ADD;
+  else
+    decoder->state = DELTA_STATE_INSERT;
+}
+
+static bootloader_status process_byte(
+  bootloader_delta_decoder *const decoder,
+  const uint8_t byte
+)
+{
+  bootloader_status status = BOOTLOADER_OK;
+  uint8_t source_byte = 0;
+
+  switch (decoder->state)
+  {
+    case DELTA_STATE_OP:
+      if (byte < DELTA_OP_COPY || byte > DELTA_OP_INSERT)
+        return BOOTLOADER_ERROR;
+
+      decoder->op = byte;
+      decoder->field_index = 0;
+      decoder->offset = 0;
+      decoder->length = 0;
+      decoder->state = byte == DELTA_OP_INSERT ?
+        DELTA_STATE_LENGTH :
+        DELTA_STATE_OFFSET;
+      break;
+    case DELTA_STATE_OFFSET:
+      decoder->offset |= (uint32_t)byte << (8 * decoder->field_index);
+      if (++decoder->field_index < DELTA_OFFSET_BYTES)
+        break;
+
+      decoder->field_index = 0;
+      decoder->state = DELTA_STATE_LENGTH;
+      break;
+    case DELTA_STATE_LENGTH:
+      decoder->length |= (uint16_t)byte << (8 * decoder->field_index);
+      if (++decoder->field_index == DELTA_LENGTH_BYTES)
+        start_record(decoder);
+      break;
+    case DELTA_STATE_ADD:
+      status = read_source(decoder, &source_byte);
+      if (status)
+        break;
+
+      put_byte(decoder, source_byte + byte);
+      finish_byte(decoder);
+      break;
+    case DELTA_STATE_INSERT:
+      put_byte(decoder, byte);
+      finish_byte(decoder);
+      break;
+  }
+
+  return status;
+}
+
+// Implementations -----------------------------------------------------------
+
+void bootloader_delta_init(
+  bootloader_delta_decoder *const decoder,
+  uint8_t *const window,
+  const uint8_t *const source,
+  const uint32_t source_size,
+  const uint8_t *const backup
+)
+{
+  *decoder = (bootloader_delta_decoder){
+    .window = window,
+    .source = source,
+    .source_size = source_size,
+    .backup = backup,
+    .state = DELTA_STATE_OP
+  };
+}
+
+void bootloader_delta_set_input(
+  bootloader_delta_decoder *const decoder,
+  const uint8_t *const input,
+  const uint16_t size
+)
+{
+  decoder->input = input;
+  decoder->input_size = size;
+}
+
+// Decodes until the input is consumed or the output reaches the limit
+bootloader_status bootloader_delta_decode(
+  bootloader_delta_decoder *const decoder,
+  const uint32_t limit
+)
+{
+  bootloader_status status = BOOTLOADER_OK;
+  uint8_t source_byte = 0;
+
+  while (decoder->position < limit && status == BOOTLOADER_OK)
+  {
+    if (decoder->state == DELTA_STATE_COPY)
+    {
+      status = read_source(decoder, &source_byte);
+      if (status)
+        break;
+
+      put_byte(decoder, source_byte);
+      finish_byte(decoder);
+      continue;
+    }
+
+    if (decoder->input_size == 0)
+      break;
+
+    status = process_byte(decoder, *decoder->input);
+    decoder->input++;
+    decoder->input_size--;
+  }
+
+  return status;
+}
+
+bool bootloader_delta_is_finished(
+  const bootloader_delta_decoder *const decoder
+)
+{
+  return decoder->input_size == 0 && decoder->state == DELTA_STATE_OP;
+}
@@ -1,20 +1,115 @@
 #include "bootloader_io.h"
+#include "bootloader_timeout.h"
 #include "stm32f1xx.h"
 #include "stm32f1xx_hal_uart.h"
 #include <stdbool.h>
 
 extern UART_HandleTypeDef *bootloader_uart;
+extern CRC_HandleTypeDef *bootloader_crc;
+extern DMA_HandleTypeDef *bootloader_crc_dma;
+
+// Filled by DMA in circular mode, so bytes keep arriving while the CPU is
+// busy (e.g. stalled on flash programming)
+static uint8_t rx_ring[RX_RING_SIZE];
+static uint16_t rx_tail = 0;
+
+// Background programming job, advanced from the FLASH interrupt a halfword
+// at a time
+static volatile uint32_t program_address;
+static const uint8_t *volatile program_data;
+static volatile uint16_t program_remaining = 0;
+static volatile bootloader_status program_status = BOOTLOADER_OK;
+// Background page erase, the job is programmed when it is over
+static volatile uint32_t erase_address;
+static volatile uint8_t erase_pages_left = 0;
+// Deadline of the background erase and programming
+static uint32_t flash_start_ticks;
+static uint32_t flash_time;
+static bool flash_session = false;
 
 // Static functions ----------------------------------------------------------
 
+static bootloader_status start_receive()
+{
+  rx_tail = 0;
+
+  // IDLE line, half and full transfer events only wake the core: they are
+  // cleared in bootloader_io_uart_irq and bootloader_io_rx_dma_irq, and the
+  // ring is read by the DMA counter
+  return (bootloader_status)HAL_UARTEx_ReceiveToIdle_DMA(
+    bootloader_uart,
+    rx_ring,
+    RX_RING_SIZE
+  );
+}
+
+static uint16_t get_rx_head()
+{
+  // The DMA counter is more recent than the last IDLE event, so bytes of a
+  // burst that is still arriving can be consumed already
+  return (RX_RING_SIZE - __HAL_DMA_GET_COUNTER(bootloader_uart->hdmarx)) &
+    (RX_RING_SIZE - 1);
+}
+
+static uint16_t get_rx_count()
+{
+  return (get_rx_head() - rx_tail) & (RX_RING_SIZE - 1);
+}
+
+// Waits for received bytes up to the timeout of the gap since start_ticks.
+// Returns their number, 0 - timeout.
+static uint16_t wait_rx(
+  const bootloader_gap gap,
+  const uint32_t start_ticks
+)
+{
+  uint32_t timeout = bootloader_timeout_get(gap);
+
+  while (true)
+  {
+    uint16_t count = get_rx_count();
+    uint32_t elapsed = HAL_GetTick() - start_ticks;
+
+    if (count)
+    {
+      bootloader_timeout_track(gap, elapsed);
+      return count;
+    }
+    if (elapsed >= timeout)
+      return 0;
+  }
+}
+
+static uint32_t get_write_timeout(const uint16_t size)
+{
+  return bootloader_timeout_get_line(size, bootloader_uart->Init.BaudRate) +
+    bootloader_timeout_get(TIMEOUT_BYTE_GAP);
+}
+
+// The flash size register (64 KB on a C8) rather than FLASH_BANK1_END of
+// the F103xB header, so the bounds match the size reported by cmd 19
+static uint32_t get_flash_end()
+{
+  return FLASH_BASE + bootloader_io_get_flash_size() * 1024U - 1U;
+}
+
+// The cmd_9 scratch pages are the only ones below the application
 static bool is_address_in_bounds(const uint32_t address)
 {
   return !(
-    address < APP_START_ADDRESS || 
-    address + sizeof(uint16_t) >= FLASH_BANK1_END
+    address < DELTA_SCRATCH_ADDRESS || 
+    address + sizeof(uint16_t) - 1 > get_flash_end()
   );
 }
 
+static bool is_range_in_bounds(const uint32_t address, const uint16_t size)
+{
+  return size != 0 &&
+    address % sizeof(uint16_t) == 0 &&
+    is_address_in_bounds(address) &&
+    is_address_in_bounds(address + size - sizeof(uint16_t));
+}
+
 static bool is_page_address(const uint32_t address)
 {
   // 128 pages
@@ -24,61 +119,531 @@ static bool is_page_address(const uint32_t address)
   );
 }
 
+// Programming by registers: BSY is polled without HAL's tick-based waiting.
+// It runs from SRAM, so interrupts are served while the flash is busy.
+__attribute__((noinline)) static __RAM_FUNC bootloader_status
+program_halfwords(
+  const uint32_t address,
+  const uint8_t *const data,
+  const uint16_t size
+)
+{
+  bootloader_status status = BOOTLOADER_OK;
+
+  __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_EOP | FLASH_FLAG_PGERR | FLASH_FLAG_WRPERR);
+  SET_BIT(FLASH->CR, FLASH_CR_PG);
+
+  for (uint16_t i = 0; i < size; i += sizeof(uint16_t))
+  {
+    *(volatile uint16_t*)(address + i) = data[i] | (data[i + 1] << 8);
+    while (FLASH->SR & FLASH_SR_BSY)
+      continue;
+
+    if (FLASH->SR & (FLASH_SR_PGERR | FLASH_SR_WRPRTERR))
+    {
+      status = BOOTLOADER_ERROR;
+      break;
+    }
+  }
+
+  CLEAR_BIT(FLASH->CR, FLASH_CR_PG);
+  __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_EOP | FLASH_FLAG_PGERR | FLASH_FLAG_WRPERR);
+
+  return status;
+}
+
+__attribute__((noinline)) static __RAM_FUNC bootloader_status erase_pages(
+  uint32_t address,
+  const uint8_t pages_num
+)
+{
+  bootloader_status status = BOOTLOADER_OK;
+
+  __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_EOP | FLASH_FLAG_PGERR | FLASH_FLAG_WRPERR);
+
+  for (uint8_t i = 0; i < pages_num; i++)
+  {
+    SET_BIT(FLASH->CR, FLASH_CR_PER);
+    WRITE_REG(FLASH->AR, address);
+    SET_BIT(FLASH->CR, FLASH_CR_STRT);
+    while (FLASH->SR & FLASH_SR_BSY)
+      continue;
+    CLEAR_BIT(FLASH->CR, FLASH_CR_PER);
+
+    if (FLASH->SR & (FLASH_SR_PGERR | FLASH_SR_WRPRTERR))
+    {
+      status = BOOTLOADER_FLASH_PAGE_ERROR;
+      break;
+    }
+    address += FLASH_PAGE_SIZE;
+  }
+
+  __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_EOP | FLASH_FLAG_PGERR | FLASH_FLAG_WRPERR);
+
+  return status;
+}
+
+static bool is_page_erased(const uint32_t address)
+{
+  const uint32_t *const page = (const uint32_t*)address;
+
+  for (uint16_t i = 0; i < FLASH_PAGE_SIZE / sizeof(uint32_t); i++)
+  {
+    if (page[i] != 0xffffffffU)
+      return false;
+  }
+
+  return true;
+}
+
+// The background steps are started by registers from SRAM, as the FLASH
+// interrupt that continues them, so they are not stalled by the flash. The
+// interrupt comes at the end of each step (EOPIE) or on an error (ERRIE).
+__attribute__((noinline)) static __RAM_FUNC void program_next_halfword()
+{
+  SET_BIT(FLASH->CR, FLASH_CR_PG | FLASH_CR_EOPIE | FLASH_CR_ERRIE);
+  *(volatile uint16_t*)program_address = program_data[0] |
+    (program_data[1] << 8);
+}
+
+__attribute__((noinline)) static __RAM_FUNC void erase_next_page()
+{
+  SET_BIT(FLASH->CR, FLASH_CR_PER | FLASH_CR_EOPIE | FLASH_CR_ERRIE);
+  WRITE_REG(FLASH->AR, erase_address);
+  SET_BIT(FLASH->CR, FLASH_CR_STRT);
+}
+
+__attribute__((noinline)) static __RAM_FUNC void program_finish(
+  const bootloader_status status
+)
+{
+  program_status |= status;
+  program_remaining = 0;
+  erase_pages_left = 0;
+  CLEAR_BIT(
+    FLASH->CR,
+    FLASH_CR_PG | FLASH_CR_PER | FLASH_CR_EOPIE | FLASH_CR_ERRIE
+  );
+  SET_BIT(FLASH->CR, FLASH_CR_LOCK);
+}
+
 // Implementations -----------------------------------------------------------
 
+bootloader_status bootloader_io_init()
+{
+  return start_receive();
+}
+
+// The first byte is waited for up to the frame gap, the others - up to the
+// byte gap after the previous ones
 bootloader_status bootloader_io_read(
   uint8_t *const data,
   const uint16_t size
 )
 {
-  return (bootloader_status)HAL_UART_Receive(
+  uint32_t start_ticks = HAL_GetTick();
+  bootloader_gap gap = TIMEOUT_FRAME_GAP;
+  uint16_t offset = 0;
+
+  while (offset < size)
+  {
+    uint16_t count = wait_rx(gap, start_ticks);
+    if (count == 0)
+      return BOOTLOADER_TIMEOUT;
+
+    for (; count && offset < size; count--)
+    {
+      data[offset++] = rx_ring[rx_tail];
+      rx_tail = (rx_tail + 1) & (RX_RING_SIZE - 1);
+    }
+    start_ticks = HAL_GetTick();
+    gap = TIMEOUT_BYTE_GAP;
+  }
+
+  return BOOTLOADER_OK;
+}
+
+// Takes bytes up to FRAME_DELIMITER (not stored) straight from the ring.
+// The gaps are timed as by bootloader_io_read, on a timeout size holds the
+// bytes taken. A longer frame than max_size is taken up to its end and not
+// stored.
+bootloader_status bootloader_io_read_frame(
+  uint8_t *const data,
+  const uint16_t max_size,
+  uint16_t *const size
+)
+{
+  uint32_t start_ticks = HAL_GetTick();
+  bootloader_gap gap = TIMEOUT_FRAME_GAP;
+  uint16_t frame_size = 0;
+  bool is_overflow = false;
+
+  while (true)
+  {
+    uint16_t count = wait_rx(gap, start_ticks);
+
+    if (count == 0)
+    {
+      *size = frame_size;
+      return BOOTLOADER_TIMEOUT;
+    }
+
+    for (; count; count--)
+    {
+      uint8_t byte = rx_ring[rx_tail];
+
+      rx_tail = (rx_tail + 1) & (RX_RING_SIZE - 1);
+      if (byte == FRAME_DELIMITER)
+      {
+        *size = frame_size;
+        return is_overflow ? BOOTLOADER_BOUNDS_ERROR : BOOTLOADER_OK;
+      }
+      if (frame_size < max_size)
+        data[frame_size++] = byte;
+      else
+        is_overflow = true;
+    }
+    start_ticks = HAL_GetTick();
+    gap = TIMEOUT_BYTE_GAP;
+  }
+}
+
+// Sleeps until an interrupt (UART IDLE, DMA, FLASH or SysTick) unless input
+// is already there. With PRIMASK set an interrupt still wakes the core, so
+// one that comes after the check is not missed.
+bool bootloader_io_wait_input()
+{
+  __disable_irq();
+  bool ready = get_rx_count() != 0;
+  if (!ready)
+    __WFI();
+  __enable_irq();
+
+  return ready || get_rx_count() != 0;
+}
+
+bootloader_status bootloader_io_write(
+  const uint8_t *const data,
+  const uint16_t size
+)
+{
+  return (bootloader_status)HAL_UART_Transmit(
     bootloader_uart,
     (uint8_t*)data,
     size,
-    UART_DELAY
+    get_write_timeout(size)
   );
 }
 
-bootloader_status bootloader_io_write(
+// Transmission by DMA, the data must stay valid until it is over
+bootloader_status bootloader_io_write_start(
   const uint8_t *const data,
   const uint16_t size
 )
 {
-  return (bootloader_status)HAL_UART_Transmit(
+  bootloader_status status = bootloader_io_write_wait();
+  if (status)
+    return status;
+
+  return (bootloader_status)HAL_UART_Transmit_DMA(
     bootloader_uart,
     (uint8_t*)data,
-    size,
-    UART_DELAY
+    size
   );
 }
 
+// Long transmissions are only timed out when they stop progressing
+bootloader_status bootloader_io_write_wait()
+{
+  uint32_t timeout = get_write_timeout(1);
+  uint32_t start_ticks = HAL_GetTick();
+  uint16_t remaining = __HAL_DMA_GET_COUNTER(bootloader_uart->hdmatx);
+
+  while (bootloader_uart->gState != HAL_UART_STATE_READY)
+  {
+    if (__HAL_DMA_GET_COUNTER(bootloader_uart->hdmatx) != remaining)
+    {
+      remaining = __HAL_DMA_GET_COUNTER(bootloader_uart->hdmatx);
+      start_ticks = HAL_GetTick();
+    }
+    if ((HAL_GetTick() - start_ticks) >= timeout)
+      return BOOTLOADER_TIMEOUT;
+  }
+
+  return BOOTLOADER_OK;
+}
+
+bootloader_status bootloader_io_check_baud_rate(const uint32_t baud_rate)
+{
+  uint32_t pclk = HAL_RCC_GetPCLK2Freq();
+
+  // 16x oversampling: BRR = pclk / baud_rate, from 16 to 0xffff
+  if (baud_rate == 0 || baud_rate > pclk / 16 || pclk / baud_rate > 0xffff)
+    return BOOTLOADER_BOUNDS_ERROR;
+
+  uint32_t brr = (pclk + baud_rate / 2) / baud_rate;
+  uint32_t actual_baud_rate = pclk / brr;
+  uint32_t error = actual_baud_rate > baud_rate ?
+    actual_baud_rate - baud_rate :
+    baud_rate - actual_baud_rate;
+
+  // More than 2% mismatch is not tolerated by the receiver
+  if (error * 50 > baud_rate)
+    return BOOTLOADER_BOUNDS_ERROR;
+
+  return BOOTLOADER_OK;
+}
+
+bootloader_status bootloader_io_set_baud_rate(const uint32_t baud_rate)
+{
+  uint32_t start_ticks = HAL_GetTick();
+  uint32_t timeout = get_write_timeout(1);
+
+  // The last response must leave at the old baud rate
+  while (!__HAL_UART_GET_FLAG(bootloader_uart, UART_FLAG_TC))
+  {
+    if ((HAL_GetTick() - start_ticks) >= timeout)
+      return BOOTLOADER_TIMEOUT;
+  }
+
+  HAL_StatusTypeDef status = HAL_UART_AbortReceive(bootloader_uart);
+
+  bootloader_uart->Init.BaudRate = baud_rate;
+  status |= HAL_UART_Init(bootloader_uart);
+  if (status)
+    return (bootloader_status)status;
+
+  return start_receive();
+}
+
 uint32_t bootloader_io_get_dev_id()
 {
   return HAL_GetDEVID();
 }
 
-bootloader_status bootloader_io_program(
+// KB, from the flash size register
+uint16_t bootloader_io_get_flash_size()
+{
+  return *(const volatile uint16_t*)FLASHSIZE_BASE;
+}
+
+void bootloader_io_get_uid(uint8_t *const uid)
+{
+  for (uint8_t i = 0; i < UID_SIZE; i++)
+    uid[i] = *((const volatile uint8_t*)UID_BASE + i);
+}
+
+uint32_t bootloader_io_get_uart_clock()
+{
+  return HAL_RCC_GetPCLK2Freq();
+}
+
+uint32_t bootloader_io_get_cycles()
+{
+  return DWT->CYCCNT;
+}
+
+// ms since the start, by SysTick
+uint32_t bootloader_io_get_ticks()
+{
+  return HAL_GetTick();
+}
+
+// Flash stays unlocked for the whole session, until the end or an error
+bootloader_status bootloader_io_flash_begin()
+{
+  if (program_remaining)
+    return BOOTLOADER_BUSY;
+
+  HAL_StatusTypeDef status = HAL_FLASH_Unlock();
+  flash_session = status == HAL_OK;
+
+  return (bootloader_status)status;
+}
+
+bootloader_status bootloader_io_flash_program(
   const uint32_t address,
-  const uint16_t data
+  const uint8_t *const data,
+  const uint16_t size
 )
 {
-  // 128 pages
-  if (!is_address_in_bounds(address))
+  bootloader_status status = BOOTLOADER_OK;
+
+  if (!flash_session)
+    return BOOTLOADER_ERROR;
+
+  if (size % sizeof(uint16_t) || !is_range_in_bounds(address, size))
+    status = BOOTLOADER_BOUNDS_ERROR;
+  else
+    status = program_halfwords(address, data, size);
+
+  if (status)
+    (void)bootloader_io_flash_end();
+
+  return status;
+}
+
+bootloader_status bootloader_io_flash_end()
+{
+  flash_session = false;
+
+  return (bootloader_status)HAL_FLASH_Lock();
+}
+
+// Programming continues from the FLASH interrupt, so the caller can receive
+// the next block while this one is written
+bootloader_status bootloader_io_program_start(
+  const uint32_t address,
+  const uint8_t *const data,
+  const uint16_t size
+)
+{
+  if (!is_range_in_bounds(address, size))
     return BOOTLOADER_BOUNDS_ERROR;
+  if (program_remaining)
+    return BOOTLOADER_BUSY;
+
+  // During an erase the job is queued, the interrupt starts it at the end
+  __disable_irq();
+  bool queued = erase_pages_left;
+  if (queued)
+  {
+    program_address = address;
+    program_data = data;
+    program_remaining = size;
+    flash_time += bootloader_timeout_get_flash(0, size);
+  }
+  __enable_irq();
+
+  if (queued)
+    return BOOTLOADER_OK;
+  if (program_status)
+    return program_status; // the erase has failed
 
   HAL_StatusTypeDef status = HAL_FLASH_Unlock();
   if (status)
     return (bootloader_status)status;
 
-  status |= HAL_FLASH_Program(
-    FLASH_TYPEPROGRAM_HALFWORD, // uint16_t
-    address,
-    data
-  );
+  program_address = address;
+  program_data = data;
+  program_remaining = size;
+  flash_start_ticks = HAL_GetTick();
+  flash_time = bootloader_timeout_get_flash(0, size);
+  __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_EOP | FLASH_FLAG_PGERR | FLASH_FLAG_WRPERR);
+  program_next_halfword();
 
-  status |= HAL_FLASH_Lock();
+  return program_status;
+}
 
-  return (bootloader_status)status;
+// Pages are erased from the FLASH interrupt (about 20 ms each), so the caller
+// can receive meanwhile. Already erased pages at the start are skipped.
+bootloader_status bootloader_io_erase_start(
+  uint32_t address,
+  uint8_t pages_num
+)
+{
+  if (
+    pages_num == 0 ||
+    !is_page_address(address) ||
+    !is_address_in_bounds(address) ||
+    !is_address_in_bounds(
+      address + pages_num * FLASH_PAGE_SIZE - sizeof(uint16_t)
+    )
+  )
+    return BOOTLOADER_BOUNDS_ERROR;
+  if (program_remaining || erase_pages_left)
+    return BOOTLOADER_BUSY;
+
+  while (pages_num && is_page_erased(address))
+  {
+    address += FLASH_PAGE_SIZE;
+    pages_num--;
+  }
+  if (pages_num == 0)
+    return BOOTLOADER_OK;
+
+  HAL_StatusTypeDef status = HAL_FLASH_Unlock();
+  if (status)
+    return (bootloader_status)status;
+
+  flash_start_ticks = HAL_GetTick();
+  flash_time = bootloader_timeout_get_flash(pages_num, 0);
+  erase_address = address;
+  erase_pages_left = pages_num;
+  __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_EOP | FLASH_FLAG_PGERR | FLASH_FLAG_WRPERR);
+  erase_next_page();
+
+  return program_status;
+}
+
+// Waits for the background erase and programming up to their deadline
+bootloader_status bootloader_io_program_wait()
+{
+  while (true)
+  {
+    // The FLASH interrupt wakes the core at the end of every step, SysTick -
+    // every ms
+    __disable_irq();
+    bool busy = program_remaining || erase_pages_left;
+    bool is_late = busy && (HAL_GetTick() - flash_start_ticks) >= flash_time;
+    if (is_late)
+      program_finish(BOOTLOADER_TIMEOUT);
+    else if (busy)
+      __WFI();
+    __enable_irq();
+
+    if (!busy || is_late)
+      break;
+  }
+
+  bootloader_status status = program_status;
+  program_status = BOOTLOADER_OK;
+
+  return status;
+}
+
+// The end of each background step is handled here from SRAM instead of
+// HAL_FLASH_IRQHandler. Other interrupts are left to HAL.
+__RAM_FUNC bool bootloader_io_flash_irq()
+{
+  uint32_t sr = READ_REG(FLASH->SR);
+
+  if (!program_remaining && !erase_pages_left)
+    return false;
+
+  // The flags are cleared by writing 1
+  WRITE_REG(FLASH->SR, FLASH_SR_EOP | FLASH_SR_PGERR | FLASH_SR_WRPRTERR);
+  CLEAR_BIT(FLASH->CR, FLASH_CR_PG | FLASH_CR_PER);
+  if (sr & (FLASH_SR_PGERR | FLASH_SR_WRPRTERR))
+  {
+    program_finish(BOOTLOADER_ERROR);
+    return true;
+  }
+  if (!(sr & FLASH_SR_EOP))
+    return true;
+
+  if (erase_pages_left)
+  {
+    erase_address += FLASH_PAGE_SIZE;
+    if (--erase_pages_left)
+      erase_next_page();
+    else if (!program_remaining)
+      program_finish(BOOTLOADER_OK);
+    else
+      program_next_halfword();
+    return true;
+  }
+
+  program_address += sizeof(uint16_t);
+  program_data += sizeof(uint16_t);
+  program_remaining -= sizeof(uint16_t);
+
+  if (!program_remaining)
+    program_finish(BOOTLOADER_OK);
+  else
+    program_next_halfword();
+
+  return true;
 }
 
 bootloader_status bootloader_io_erase(
@@ -89,24 +654,17 @@ bootloader_status bootloader_io_erase(
   if (!is_address_in_bounds(address) || !is_page_address(address))
     return BOOTLOADER_BOUNDS_ERROR;
 
-  HAL_StatusTypeDef status = HAL_FLASH_Unlock();
-
-  FLASH_EraseInitTypeDef erase_init_struct = (FLASH_EraseInitTypeDef){
-    .TypeErase = FLASH_TYPEERASE_PAGES,
-    .Banks = FLASH_BANK_1,
-    .PageAddress = address,
-    .NbPages = pages_num
-  };
-  uint32_t page_error = 0x0U;
+  if (program_remaining || erase_pages_left)
+    return BOOTLOADER_BUSY;
 
-  status |= HAL_FLASHEx_Erase(&erase_init_struct, &page_error);
-
-  if (page_error != ~0x0)
-    return status |= BOOTLOADER_FLASH_PAGE_ERROR; 
+  HAL_StatusTypeDef status = HAL_FLASH_Unlock();
+  if (status)
+    return (bootloader_status)status;
 
+  bootloader_status erase_status = erase_pages(address, pages_num);
   status |= HAL_FLASH_Lock();
 
-  return status;
+  return erase_status | (bootloader_status)status;
 }
 
 bootloader_status bootloader_io_read_flash(
@@ -114,10 +672,107 @@ bootloader_status bootloader_io_read_flash(
   uint8_t *const value
 )
 {
-  if (address < FLASH_BASE || address + sizeof(uint16_t) >= FLASH_BANK1_END)
+  if (address < FLASH_BASE || address + sizeof(uint16_t) >= get_flash_end())
     return BOOTLOADER_BOUNDS_ERROR;
 
   *value = (uint8_t)(*((volatile uint32_t*)address));
 
   return BOOTLOADER_OK;
 }
+
+// The words of the range are fed to the CRC unit by memory-to-memory DMA
+bootloader_status bootloader_io_get_flash_crc(
+  const uint32_t address,
+  const uint32_t size,
+  uint32_t *const crc
+)
+{
+  if (
+    size == 0 ||
+    address % sizeof(uint32_t) ||
+    size % sizeof(uint32_t) ||
+    address < FLASH_BASE ||
+    address + size - 1 > get_flash_end()
+  )
+    return BOOTLOADER_BOUNDS_ERROR;
+
+  __HAL_CRC_DR_RESET(bootloader_crc);
+  HAL_StatusTypeDef status = HAL_DMA_Start(
+    bootloader_crc_dma,
+    address,
+    (uint32_t)&bootloader_crc->Instance->DR,
+    size / sizeof(uint32_t)
+  );
+  if (status == HAL_OK)
+    status |= HAL_DMA_PollForTransfer(
+      bootloader_crc_dma,
+      HAL_DMA_FULL_TRANSFER,
+      UART_DELAY
+    );
+
+  *crc = bootloader_crc->Instance->DR;
+
+  return status;
+}
+
+// Flash is memory-mapped, so the application can be read in place
+const uint8_t *bootloader_io_map_flash(
+  const uint32_t address,
+  const uint32_t size
+)
+{
+  if (
+    size == 0 ||
+    address < FLASH_BASE ||
+    address + size - 1 > get_flash_end()
+  )
+    return NULL;
+
+  return (const uint8_t*)address;
+}
+
+// HAL callbacks -------------------------------------------------------------
+
+// IDLE events of the DMA reception only wake the core, so they are cleared
+// here from SRAM. Errors and transmission events are left to HAL.
+__RAM_FUNC bool bootloader_io_uart_irq()
+{
+  USART_TypeDef *const uart = bootloader_uart->Instance;
+  uint32_t sr = READ_REG(uart->SR);
+  uint32_t cr1 = READ_REG(uart->CR1);
+
+  if (
+    !(sr & USART_SR_IDLE) ||
+    (sr & (USART_SR_PE | USART_SR_FE | USART_SR_NE | USART_SR_ORE)) ||
+    ((sr & USART_SR_TC) && (cr1 & USART_CR1_TCIE)) ||
+    ((sr & USART_SR_TXE) && (cr1 & USART_CR1_TXEIE))
+  )
+    return false;
+
+  (void)READ_REG(uart->DR); // clears IDLE after the SR read
+  return true;
+}
+
+// Half and full transfer of the circular RX DMA, as above
+__RAM_FUNC bool bootloader_io_rx_dma_irq()
+{
+  DMA_HandleTypeDef *const dma = bootloader_uart->hdmarx;
+
+  if (READ_REG(dma->DmaBaseAddress->ISR) & (DMA_FLAG_TE1 << dma->ChannelIndex))
+    return false;
+
+  WRITE_REG(
+    dma->DmaBaseAddress->IFCR,
+    (DMA_FLAG_GL1 | DMA_FLAG_HT1 | DMA_FLAG_TC1) << dma->ChannelIndex
+  );
+  return true;
+}
+
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+  if (huart != bootloader_uart)
+    return;
+
+  // Overrun, noise and framing errors abort the DMA transfer in HAL
+  (void)start_receive();
+}
@@ -0,0 +1,161 @@
+#include "bootloader_lz.h"
+
+enum
+{
+  LZ_STATE_TOKEN,
+  LZ_STATE_LITERAL_LENGTH,
+  LZ_STATE_LITERALS,
+  LZ_STATE_OFFSET_LOW,
+  LZ_STATE_OFFSET_HIGH,
+  LZ_STATE_MATCH_LENGTH,
+  LZ_STATE_MATCH,
+  LZ_MIN_MATCH = 4U,
+  LZ_LENGTH_EXTENDED = 15U,
+  LZ_LENGTH_CONTINUE = 255U,
+  LZ_WINDOW_MASK = LZ_WINDOW_SIZE - 1
+};
+
+// Static functions ----------------------------------------------------------
+
+__attribute__((always_inline))
+inline static void put_byte(
+  bootloader_lz_decoder *const decoder,
+  const uint8_t byte
+)
+{
+  decoder->window[decoder->position & LZ_WINDOW_MASK] = byte;
+  decoder->position++;
+}
+
+static void start_literals(bootloader_lz_decoder *const decoder)
+{
+  decoder->state = decoder->length ?
+    LZ_STATE_LITERALS :
+    LZ_STATE_OFFSET_LOW;
+}
+
+static void start_match(bootloader_lz_decoder *const decoder)
+{
+  decoder->length += LZ_MIN_MATCH;
+  decoder->state = LZ_STATE_MATCH;
+}
+
+static bootloader_status process_byte(
+  bootloader_lz_decoder *const decoder,
+  const uint8_t byte
+)
+{
+  switch (decoder->state)
+  {
+    case LZ_STATE_TOKEN:
+      decoder->length = byte >> 4;
+      decoder->match_nibble = byte & 0x0f;
+      if (decoder->length == LZ_LENGTH_EXTENDED)
+        decoder->state = LZ_STATE_LITERAL_LENGTH;
+      else
+        start_literals(decoder);
+      break;
+    case LZ_STATE_LITERAL_LENGTH:
+      decoder->length += byte;
+      if (byte != LZ_LENGTH_CONTINUE)
+        start_literals(decoder);
+      break;
+    case LZ_STATE_LITERALS:
+      put_byte(decoder, byte);
+      decoder->length--;
+      start_literals(decoder);
+      break;
+    case LZ_STATE_OFFSET_LOW:
+      decoder->offset = byte;
+      decoder->state = LZ_STATE_OFFSET_HIGH;
+      break;
+    case LZ_STATE_OFFSET_HIGH:
+      decoder->offset |= byte << 8;
+      if (
+        decoder->offset == 0 ||
+        decoder->offset > LZ_WINDOW_SIZE ||
+        decoder->offset > decoder->position
+      )
+        return BOOTLOADER_BOUNDS_ERROR;
+
+      decoder->length = decoder->match_nibble;
+      if (decoder->length == LZ_LENGTH_EXTENDED)
+        decoder->state = LZ_STATE_MATCH_LENGTH;
+      else
+        start_match(decoder);
+      break;
+    case LZ_STATE_MATCH_LENGTH:
+      decoder->length += byte;
+      if (byte != LZ_LENGTH_CONTINUE)
+        start_match(decoder);
+      break;
+  }
+
+  return BOOTLOADER_OK;
+}
+
+// Implementations -----------------------------------------------------------
+
+void bootloader_lz_init(
+  bootloader_lz_decoder *const decoder,
+  uint8_t *const window
+)
+{
+  *decoder = (bootloader_lz_decoder){
+    .window = window,
+    .state = LZ_STATE_TOKEN
+  };
+}
+
+void bootloader_lz_set_input(
+  bootloader_lz_decoder *const decoder,
+  const uint8_t *const input,
+  const uint16_t size
+)
+{
+  decoder->input = input;
+  decoder->input_size = size;
+}
+
+// Decodes until the input is consumed or the output reaches the limit
+bootloader_status bootloader_lz_decode(
+  bootloader_lz_decoder *const decoder,
+  const uint32_t limit
+)
+{
+  bootloader_status status = BOOTLOADER_OK;
+
+  while (decoder->position < limit && status == BOOTLOADER_OK)
+  {
+    if (decoder->state == LZ_STATE_MATCH)
+    {
+      put_byte(
+        decoder,
+        decoder->window[
+          (decoder->position - decoder->offset) & LZ_WINDOW_MASK
+        ]
+      );
+      if (--decoder->length == 0)
+        decoder->state = LZ_STATE_TOKEN;
+      continue;
+    }
+
+    if (decoder->input_size == 0)
+      break;
+
+    status = process_byte(decoder, *decoder->input);
+    decoder->input++;
+    decoder->input_size--;
+  }
+
+  return status;
+}
+
+// The last sequence of a block has literals only
+bool bootloader_lz_is_finished(const bootloader_lz_decoder *const decoder)
+{
+  return decoder->input_size == 0 && (
+    decoder->state == LZ_STATE_TOKEN ||
+    decoder->state == LZ_STATE_OFFSET_LOW
+  );
+}
@@ -0,0 +1,89 @@
+#include "bootloader_timeout.h"
+
+enum
+{
+  UART_BITS_PER_BYTE = 10U, // start, 8 data bits, stop
+  FLASH_TIME_FACTOR = 2U // deadlines only catch a flash that does not answer
+};
+
+static uint16_t gaps[TIMEOUT_GAPS_NUM] = { UART_DELAY, UART_DELAY };
+static uint16_t longest_gaps[TIMEOUT_GAPS_NUM];
+
+// Implementations -----------------------------------------------------------
+
+void bootloader_timeout_reset()
+{
+  gaps[TIMEOUT_FRAME_GAP] = UART_DELAY;
+  gaps[TIMEOUT_BYTE_GAP] = UART_DELAY;
+  bootloader_timeout_clear_longest();
+}
+
+// 0 - UART_DELAY. The byte gap is not longer than the frame gap.
+bootloader_status bootloader_timeout_set(
+  const uint16_t frame_gap,
+  const uint16_t byte_gap
+)
+{
+  uint16_t new_frame_gap = frame_gap ? frame_gap : UART_DELAY;
+  uint16_t new_byte_gap = byte_gap ? byte_gap : UART_DELAY;
+
+  if (
+    new_frame_gap < UART_MIN_FRAME_GAP ||
+    new_byte_gap < UART_MIN_BYTE_GAP ||
+    new_byte_gap > new_frame_gap
+  )
+    return BOOTLOADER_BOUNDS_ERROR;
+
+  gaps[TIMEOUT_FRAME_GAP] = new_frame_gap;
+  gaps[TIMEOUT_BYTE_GAP] = new_byte_gap;
+
+  return BOOTLOADER_OK;
+}
+
+uint16_t bootloader_timeout_get(const bootloader_gap gap)
+{
+  return gaps[gap];
+}
+
+void bootloader_timeout_track(const bootloader_gap gap, const uint32_t time)
+{
+  uint16_t limited_time = time > UINT16_MAX ? UINT16_MAX : time;
+
+  if (limited_time > longest_gaps[gap])
+    longest_gaps[gap] = limited_time;
+}
+
+uint16_t bootloader_timeout_get_longest(const bootloader_gap gap)
+{
+  return longest_gaps[gap];
+}
+
+void bootloader_timeout_clear_longest()
+{
+  longest_gaps[TIMEOUT_FRAME_GAP] = 0;
+  longest_gaps[TIMEOUT_BYTE_GAP] = 0;
+}
+
+// Time of size bytes on the line, rounded up
+uint32_t bootloader_timeout_get_line(
+  const uint32_t size,
+  const uint32_t baud_rate
+)
+{
+  uint64_t bits = (uint64_t)size * UART_BITS_PER_BYTE * 1000U;
+
+  return (bits + baud_rate - 1) / baud_rate;
+}
+
+// Erase of pages_num pages and programming of size bytes, with one more
+// ms for the tick that is running
+uint32_t bootloader_timeout_get_flash(
+  const uint8_t pages_num,
+  const uint32_t size
+)
+{
+  uint32_t time = pages_num * FLASH_PAGE_ERASE_TIME +
+    (size / sizeof(uint16_t) * FLASH_HALFWORD_TIME + 999U) / 1000U;
+
+  return time * FLASH_TIME_FACTOR + 1U;
+}
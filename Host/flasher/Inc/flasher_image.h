@@ -0,0 +1,62 @@
+#ifndef FLASHER_IMAGE_H
+#define FLASHER_IMAGE_H
+
+#include "bootloader_defs.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Application image laid out in a copy of the flash (0xff where it has no
+// data). Images are accepted from the 'app start address' to the end of
+// flash.
+
+#define FLASHER_FLASH_BASE 0x08000000UL
+#define FLASHER_FLASH_SIZE (FLASH_PAGES_NUM * BLOCK_SIZE)
+#define FLASHER_FLASH_END (FLASHER_FLASH_BASE + FLASHER_FLASH_SIZE)
+
+typedef struct
+{
+  uint8_t memory[FLASHER_FLASH_SIZE];
+  uint32_t start; // address of the first byte with data
+  uint32_t end; // address after the last byte with data
+} flasher_image;
+
+void flasher_image_init(flasher_image *const image);
+bootloader_status flasher_image_put(
+  flasher_image *const image,
+  const uint32_t address,
+  const uint8_t *const data,
+  const size_t size
+);
+bootloader_status flasher_image_parse_bin(
+  flasher_image *const image,
+  const uint32_t address,
+  const uint8_t *const data,
+  const size_t size
+);
+bootloader_status flasher_image_parse_hex(
+  flasher_image *const image,
+  const char *const text,
+  const size_t size
+);
+bootloader_status flasher_image_parse_elf(
+  flasher_image *const image,
+  const uint8_t *const data,
+  const size_t size
+);
+bootloader_status flasher_image_load(
+  flasher_image *const image,
+  const char *const path,
+  const uint32_t bin_address
+);
+const uint8_t *flasher_image_at(
+  const flasher_image *const image,
+  const uint32_t address
+);
+bool flasher_image_is_blank(
+  const flasher_image *const image,
+  const uint32_t address,
+  const uint32_t size
+);
+
+#endif
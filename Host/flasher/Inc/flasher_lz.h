@@ -0,0 +1,27 @@
+#ifndef FLASHER_LZ_H
+#define FLASHER_LZ_H
+
+#include "bootloader_defs.h"
+#include <stdint.h>
+#include <stddef.h>
+
+// Greedy encoder of one LZ4 block (sequences only, without the frame
+// header) for cmd 8. Match offsets are kept within LZ_WINDOW_SIZE, the
+// window of the device decoder. The block ends with a sequence of literals
+// only, or with a match that reaches the end of the input.
+
+enum
+{
+  FLASHER_LZ_HASH_BITS = 12U
+};
+
+// The largest output for size bytes of input
+size_t flasher_lz_get_bound(const size_t size);
+// Returns the size of the block in output
+size_t flasher_lz_compress(
+  const uint8_t *const input,
+  const size_t size,
+  uint8_t *const output
+);
+
+#endif
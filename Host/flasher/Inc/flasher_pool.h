@@ -0,0 +1,33 @@
+#ifndef FLASHER_POOL_H
+#define FLASHER_POOL_H
+
+#include "flasher_image.h"
+#include "flasher_session.h"
+#include <stdint.h>
+
+// Programming of several devices by a pool of worker threads. Each worker
+// takes the next device and runs its session to the end, the image and
+// the options are shared.
+
+enum
+{
+  FLASHER_MAX_DEVICES = 64U
+};
+
+typedef struct
+{
+  const char *port;
+  flasher_session session;
+  bootloader_status status;
+} flasher_device;
+
+// Returns the wall time in seconds
+double flasher_pool_run(
+  flasher_device *const devices,
+  const uint32_t devices_num,
+  const uint32_t workers_num,
+  const flasher_image *const image,
+  const flasher_options *const options
+);
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef FLASHER_SERIAL_H
+#define FLASHER_SERIAL_H
+
+#include "bootloader_defs.h"
+#include <stdint.h>
+#include <stddef.h>
+
+// Non-blocking raw serial port, 8N1. Reads and writes wait with poll up to
+// the timeout.
+
+int flasher_serial_open(const char *const path);
+void flasher_serial_close(const int fd);
+bootloader_status flasher_serial_set_baud_rate(
+  const int fd,
+  const uint32_t baud_rate
+);
+bootloader_status flasher_serial_read(
+  const int fd,
+  uint8_t *const data,
+  const size_t size,
+  const int timeout_ms
+);
+bootloader_status flasher_serial_write(
+  const int fd,
+  const uint8_t *const data,
+  const size_t size,
+  const int timeout_ms
+);
+bootloader_status flasher_serial_read_until(
+  const int fd,
+  const char *const pattern,
+  const int timeout_ms
+);
+void flasher_serial_drain(const int fd, const int quiet_ms);
+int64_t flasher_serial_get_time_ms(void);
+int64_t flasher_serial_get_time_us(void);
+
+#endif
@@ -0,0 +1,141 @@
+#ifndef FLASHER_SESSION_H
+#define FLASHER_SESSION_H
+
+#include "bootloader_defs.h"
+#include "flasher_image.h"
+#include "bootloader_timeout.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// Programming of one device over the bootloader protocol. Pages without
+// data are erased with cmd 4, the others are written with several block
+// frames in flight: with cmd 15 (COBS frames, corrupted frames are sent
+// again), cmd 14 (the same without delimiters) or cmd 6 (the first error
+// restarts the transfer). Cmd 17 streams the pages of the image as raw
+// data instead, confirmed by checkpoints, and cmd 8 sends them as one LZ4
+// block (only if selected in the options). The device erases a page ahead of
+// its first block. The image is only read, so sessions may share it.
+// Timeouts follow the round trip of cmd 16, which also sets the gaps after
+// which the device takes a frame as cut or lost. The transfer runs in
+// machine mode (cmd 18), without prompts. The descriptor of cmd 19 selects
+// the write command and the window, older bootloaders are probed instead.
+
+enum
+{
+  FLASHER_DEFAULT_BLOCK_SIZE = 512U,
+  FLASHER_MIN_BLOCK_SIZE = 16U,
+  // Encoded header, crc16 and delimiters, more than of cmd 6 and cmd 14
+  FLASHER_FRAME_OVERHEAD = WINDOW_FRAME_OVERHEAD,
+  FLASHER_DEFAULT_RETRIES = 3U,
+  FLASHER_ACK_TIMEOUT = 2 * UART_DELAY, // until the round trip is measured
+  FLASHER_TIMEOUT_MARGIN = 20U // ms, scheduling of the host and USB latency
+};
+
+typedef struct
+{
+  uint32_t baud_rate; // 0 or UART_BAUD_RATE - no switch
+  uint16_t block_size; // power of 2, up to BLOCK_SIZE
+  uint8_t window; // block frames in flight, 0 - as many as the device buffers
+  uint8_t max_retries;
+  bool verify;
+  // CMD_WRITE_FRAMED, _STREAM, _WINDOW, _COMPRESSED, _BLOCK or 0 - auto
+  uint8_t command;
+} flasher_options;
+
+// Descriptor of cmd 19. Older bootloaders are taken as built with the same
+// defs, without the commands from cmd 16 on.
+typedef struct
+{
+  bool is_known;
+  uint8_t protocol_version;
+  uint8_t version[2]; // major, minor
+  uint32_t commands; // bit i - cmd i
+  uint16_t page_size;
+  uint16_t block_size;
+  uint16_t buffer_size; // receive ring
+  uint8_t window_frames;
+  uint16_t flash_size; // KB
+  uint32_t app_address;
+  uint8_t uid[UID_SIZE];
+  uint32_t uart_clock; // Hz, 0 - unknown
+} flasher_capabilities;
+
+typedef struct
+{
+  uint32_t bytes; // acknowledged block data
+  uint32_t frames;
+  uint32_t retransmits; // frames sent again within a transfer
+  uint32_t erased_pages;
+  uint32_t retries;
+  uint32_t nacks;
+  uint32_t timeouts;
+  uint16_t longest_gaps[TIMEOUT_GAPS_NUM]; // seen by the device, in ms
+  double seconds;
+} flasher_stats;
+
+typedef struct
+{
+  int fd;
+  const char *port;
+  const flasher_options *options;
+  flasher_capabilities capabilities;
+  uint8_t command; // of the options, or selected by the capabilities
+  uint8_t window;
+  uint32_t rtt_us; // round trip of a command byte and its ACK, 0 - unknown
+  uint16_t gaps[TIMEOUT_GAPS_NUM]; // of the device, in ms
+  uint32_t ack_timeout; // ms
+  bool is_machine_mode;
+  flasher_stats stats;
+} flasher_session;
+
+void flasher_options_init(flasher_options *const options);
+bootloader_status flasher_options_check(const flasher_options *const options);
+uint8_t flasher_get_window(const uint16_t block_size);
+
+bootloader_status flasher_session_open(
+  flasher_session *const session,
+  const char *const port,
+  const flasher_options *const options
+);
+void flasher_session_close(flasher_session *const session);
+bootloader_status flasher_session_connect(flasher_session *const session);
+bootloader_status flasher_session_get_capabilities(
+  flasher_session *const session
+);
+bootloader_status flasher_session_set_baud_rate(
+  flasher_session *const session,
+  const uint32_t baud_rate
+);
+bootloader_status flasher_session_set_timeouts(
+  flasher_session *const session,
+  const uint16_t frame_gap,
+  const uint16_t byte_gap
+);
+bootloader_status flasher_session_tune_timeouts(
+  flasher_session *const session
+);
+bootloader_status flasher_session_set_mode(
+  flasher_session *const session,
+  const uint8_t mode
+);
+bootloader_status flasher_session_erase(
+  flasher_session *const session,
+  const uint32_t address,
+  const uint8_t pages_num
+);
+bootloader_status flasher_session_write(
+  flasher_session *const session,
+  const flasher_image *const image
+);
+bootloader_status flasher_session_verify(
+  flasher_session *const session,
+  const flasher_image *const image
+);
+// Connect, capabilities, baud rate switch, timeouts, machine mode, write
+// and verify as set in the options
+bootloader_status flasher_session_program(
+  flasher_session *const session,
+  const flasher_image *const image
+);
+
+#endif
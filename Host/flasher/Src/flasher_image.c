@@ -0,0 +1,318 @@
+#include "flasher_image.h"
+#include <elf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <string.h>
+
+enum
+{
+  HEX_DATA = 0x00U,
+  HEX_END_OF_FILE = 0x01U,
+  HEX_EXTENDED_SEGMENT_ADDRESS = 0x02U,
+  HEX_START_SEGMENT_ADDRESS = 0x03U,
+  HEX_EXTENDED_LINEAR_ADDRESS = 0x04U,
+  HEX_START_LINEAR_ADDRESS = 0x05U,
+  HEX_MAX_RECORD_SIZE = 5U + 0xffU // length, address, type, data, checksum
+};
+
+// Static functions ----------------------------------------------------------
+
+static int get_hex_digit(const char symbol)
+{
+  if (symbol >= '0' && symbol <= '9')
+    return symbol - '0';
+  if (symbol >= 'A' && symbol <= 'F')
+    return symbol - 'A' + 10;
+  if (symbol >= 'a' && symbol <= 'f')
+    return symbol - 'a' + 10;
+
+  return -1;
+}
+
+// Converts the digits of a record after ':' into bytes
+static bootloader_status decode_hex_record(
+  const char *const text,
+  const size_t digits_num,
+  uint8_t *const record,
+  uint16_t *const record_size
+)
+{
+  uint8_t checksum = 0;
+
+  if (digits_num % 2 || digits_num / 2 > HEX_MAX_RECORD_SIZE)
+    return BOOTLOADER_ERROR;
+
+  for (size_t i = 0; i < digits_num; i += 2)
+  {
+    int high = get_hex_digit(text[i]);
+    int low = get_hex_digit(text[i + 1]);
+
+    if (high < 0 || low < 0)
+      return BOOTLOADER_ERROR;
+    record[i / 2] = (uint8_t)(high << 4 | low);
+    checksum += record[i / 2];
+  }
+
+  *record_size = digits_num / 2;
+  if (*record_size < 5 || record[0] != *record_size - 5)
+    return BOOTLOADER_ERROR;
+
+  return checksum ? BOOTLOADER_CRC_ERROR : BOOTLOADER_OK;
+}
+
+static bool has_extension(const char *const path, const char *const extension)
+{
+  size_t path_length = strlen(path);
+  size_t extension_length = strlen(extension);
+
+  return path_length >= extension_length &&
+    strcasecmp(path + path_length - extension_length, extension) == 0;
+}
+
+static uint8_t *read_file(const char *const path, size_t *const size)
+{
+  FILE *file = fopen(path, "rb");
+  uint8_t *data = NULL;
+  long file_size = 0;
+
+  if (file == NULL)
+    return NULL;
+
+  if (fseek(file, 0, SEEK_END) == 0)
+    file_size = ftell(file);
+  if (file_size >= 0 && fseek(file, 0, SEEK_SET) == 0)
+    data = malloc(file_size + 1);
+
+  if (data && fread(data, 1, file_size, file) != (size_t)file_size)
+  {
+    free(data);
+    data = NULL;
+  }
+  fclose(file);
+
+  *size = file_size;
+  return data;
+}
+
+// Implementations -----------------------------------------------------------
+
+void flasher_image_init(flasher_image *const image)
+{
+  memset(image->memory, 0xff, sizeof(image->memory));
+  image->start = FLASHER_FLASH_END;
+  image->end = APP_START_ADDRESS;
+}
+
+bootloader_status flasher_image_put(
+  flasher_image *const image,
+  const uint32_t address,
+  const uint8_t *const data,
+  const size_t size
+)
+{
+  if (size == 0)
+    return BOOTLOADER_OK;
+  if (
+    address < APP_START_ADDRESS ||
+    address >= FLASHER_FLASH_END ||
+    size > FLASHER_FLASH_END - address
+  )
+    return BOOTLOADER_BOUNDS_ERROR;
+
+  memcpy(image->memory + (address - FLASHER_FLASH_BASE), data, size);
+  if (address < image->start)
+    image->start = address;
+  if (address + size > image->end)
+    image->end = address + size;
+
+  return BOOTLOADER_OK;
+}
+
+bootloader_status flasher_image_parse_bin(
+  flasher_image *const image,
+  const uint32_t address,
+  const uint8_t *const data,
+  const size_t size
+)
+{
+  return flasher_image_put(image, address, data, size);
+}
+
+// Intel HEX: data, end of file and extended address records are used, start
+// addresses are skipped
+bootloader_status flasher_image_parse_hex(
+  flasher_image *const image,
+  const char *const text,
+  const size_t size
+)
+{
+  uint8_t record[HEX_MAX_RECORD_SIZE];
+  uint16_t record_size = 0;
+  uint32_t base_address = 0;
+  bootloader_status status = BOOTLOADER_OK;
+
+  for (size_t position = 0; position < size && status == BOOTLOADER_OK;)
+  {
+    if (text[position] == '\r' || text[position] == '\n')
+    {
+      position++;
+      continue;
+    }
+    if (text[position] != ':')
+      return BOOTLOADER_ERROR;
+
+    size_t digits_num = 0;
+    position++;
+    while (
+      position + digits_num < size &&
+      text[position + digits_num] != '\r' &&
+      text[position + digits_num] != '\n'
+    )
+      digits_num++;
+
+    status |= decode_hex_record(
+      text + position,
+      digits_num,
+      record,
+      &record_size
+    );
+    position += digits_num;
+    if (status)
+      break;
+
+    uint32_t offset = (uint32_t)record[1] << 8 | record[2];
+    switch (record[3])
+    {
+      case HEX_DATA:
+        status |= flasher_image_put(
+          image,
+          base_address + offset,
+          record + 4,
+          record[0]
+        );
+        break;
+      case HEX_END_OF_FILE:
+        return BOOTLOADER_OK;
+      case HEX_EXTENDED_SEGMENT_ADDRESS:
+        base_address = ((uint32_t)record[4] << 8 | record[5]) << 4;
+        break;
+      case HEX_EXTENDED_LINEAR_ADDRESS:
+        base_address = ((uint32_t)record[4] << 8 | record[5]) << 16;
+        break;
+      case HEX_START_SEGMENT_ADDRESS:
+      case HEX_START_LINEAR_ADDRESS:
+        break;
+      default:
+        status |= BOOTLOADER_ERROR;
+        break;
+    }
+  }
+
+  // The end of file record is required
+  return status ? status : BOOTLOADER_ERROR;
+}
+
+// ELF32 (ARM, little-endian): loadable segments go to their load (physical)
+// addresses, so initialized data is placed after the code as in flash
+bootloader_status flasher_image_parse_elf(
+  flasher_image *const image,
+  const uint8_t *const data,
+  const size_t size
+)
+{
+  const Elf32_Ehdr *const header = (const Elf32_Ehdr*)data;
+  bootloader_status status = BOOTLOADER_OK;
+
+  if (
+    size < sizeof(Elf32_Ehdr) ||
+    memcmp(header->e_ident, ELFMAG, SELFMAG) ||
+    header->e_ident[EI_CLASS] != ELFCLASS32 ||
+    header->e_ident[EI_DATA] != ELFDATA2LSB ||
+    header->e_machine != EM_ARM ||
+    header->e_phentsize != sizeof(Elf32_Phdr) ||
+    header->e_phoff > size ||
+    (size - header->e_phoff) / sizeof(Elf32_Phdr) < header->e_phnum
+  )
+    return BOOTLOADER_ERROR;
+
+  const Elf32_Phdr *const segments = (const Elf32_Phdr*)(
+    data + header->e_phoff
+  );
+  for (uint16_t i = 0; i < header->e_phnum && status == BOOTLOADER_OK; i++)
+  {
+    const Elf32_Phdr *const segment = segments + i;
+
+    if (segment->p_type != PT_LOAD || segment->p_filesz == 0)
+      continue;
+    if (
+      segment->p_offset > size ||
+      size - segment->p_offset < segment->p_filesz
+    )
+      return BOOTLOADER_BOUNDS_ERROR;
+
+    status |= flasher_image_put(
+      image,
+      segment->p_paddr,
+      data + segment->p_offset,
+      segment->p_filesz
+    );
+  }
+
+  return status;
+}
+
+// The format is chosen by the extension: .hex, .elf (.axf) or raw binary
+// placed at bin_address
+bootloader_status flasher_image_load(
+  flasher_image *const image,
+  const char *const path,
+  const uint32_t bin_address
+)
+{
+  size_t size = 0;
+  uint8_t *data = read_file(path, &size);
+  bootloader_status status = BOOTLOADER_OK;
+
+  if (data == NULL)
+    return BOOTLOADER_ERROR;
+
+  flasher_image_init(image);
+  if (has_extension(path, ".hex") || has_extension(path, ".ihex"))
+    status = flasher_image_parse_hex(image, (const char*)data, size);
+  else if (has_extension(path, ".elf") || has_extension(path, ".axf"))
+    status = flasher_image_parse_elf(image, data, size);
+  else
+    status = flasher_image_parse_bin(image, bin_address, data, size);
+  free(data);
+
+  if (status == BOOTLOADER_OK && image->start >= image->end)
+    status = BOOTLOADER_ERROR; // no data
+
+  return status;
+}
+
+const uint8_t *flasher_image_at(
+  const flasher_image *const image,
+  const uint32_t address
+)
+{
+  return image->memory + (address - FLASHER_FLASH_BASE);
+}
+
+bool flasher_image_is_blank(
+  const flasher_image *const image,
+  const uint32_t address,
+  const uint32_t size
+)
+{
+  const uint8_t *const data = flasher_image_at(image, address);
+
+  for (uint32_t i = 0; i < size; i++)
+  {
+    if (data[i] != 0xff)
+      return false;
+  }
+
+  return true;
+}
@@ -0,0 +1,133 @@
+#include "flasher_lz.h"
+#include <string.h>
+
+enum
+{
+  LZ_MIN_MATCH = 4U,
+  LZ_LENGTH_EXTENDED = 15U,
+  LZ_LENGTH_CONTINUE = 255U,
+  LZ_HASH_SIZE = 1U << FLASHER_LZ_HASH_BITS
+};
+
+// Static functions ----------------------------------------------------------
+
+static uint32_t read_word(const uint8_t *const data)
+{
+  uint32_t word = 0;
+
+  memcpy(&word, data, sizeof(uint32_t));
+  return word;
+}
+
+static uint32_t get_hash(const uint32_t word)
+{
+  return (word * 2654435761U) >> (32U - FLASHER_LZ_HASH_BITS);
+}
+
+// The part of a length above the nibble: 255 while it continues
+static uint8_t *put_length(uint8_t *output, size_t length)
+{
+  for (; length >= LZ_LENGTH_CONTINUE; length -= LZ_LENGTH_CONTINUE)
+    *output++ = LZ_LENGTH_CONTINUE;
+  *output++ = length;
+
+  return output;
+}
+
+static uint8_t nibble(const size_t length)
+{
+  return length < LZ_LENGTH_EXTENDED ? length : LZ_LENGTH_EXTENDED;
+}
+
+// Without a match (match_size 0) the sequence ends the block
+static uint8_t *put_sequence(
+  uint8_t *output,
+  const uint8_t *const literals,
+  const size_t literals_size,
+  const uint16_t offset,
+  const size_t match_size
+)
+{
+  size_t match_length = match_size ? match_size - LZ_MIN_MATCH : 0;
+  uint8_t *const token = output++;
+
+  *token = nibble(literals_size) << 4 | nibble(match_length);
+  if (literals_size >= LZ_LENGTH_EXTENDED)
+    output = put_length(output, literals_size - LZ_LENGTH_EXTENDED);
+  memcpy(output, literals, literals_size);
+  output += literals_size;
+
+  if (match_size == 0)
+    return output;
+
+  *output++ = offset & 0xff;
+  *output++ = offset >> 8;
+  if (match_length >= LZ_LENGTH_EXTENDED)
+    output = put_length(output, match_length - LZ_LENGTH_EXTENDED);
+
+  return output;
+}
+
+// Implementations -----------------------------------------------------------
+
+// Literals only, with their length bytes and the token
+size_t flasher_lz_get_bound(const size_t size)
+{
+  return size + size / LZ_LENGTH_CONTINUE + 16U;
+}
+
+// Each position is looked up by the hash of its 4 bytes, the match found is
+// extended as far as it goes
+size_t flasher_lz_compress(
+  const uint8_t *const input,
+  const size_t size,
+  uint8_t *const output
+)
+{
+  uint32_t positions[LZ_HASH_SIZE]; // position + 1, 0 - none
+  uint8_t *end = output;
+  size_t anchor = 0;
+  size_t position = 0;
+
+  memset(positions, 0, sizeof(positions));
+  while (position + LZ_MIN_MATCH <= size)
+  {
+    uint32_t word = read_word(input + position);
+    uint32_t hash = get_hash(word);
+    size_t candidate = positions[hash];
+
+    positions[hash] = position + 1;
+    if (
+      candidate == 0 ||
+      position + 1 - candidate > LZ_WINDOW_SIZE ||
+      read_word(input + candidate - 1) != word
+    )
+    {
+      position++;
+      continue;
+    }
+
+    candidate--;
+    size_t match_size = LZ_MIN_MATCH;
+    while (
+      position + match_size < size &&
+      input[candidate + match_size] == input[position + match_size]
+    )
+      match_size++;
+
+    end = put_sequence(
+      end,
+      input + anchor,
+      position - anchor,
+      position - candidate,
+      match_size
+    );
+    position += match_size;
+    anchor = position;
+  }
+
+  // The decoder stops at the size, so nothing may follow the last match
+  if (anchor < size || size == 0)
+    end = put_sequence(end, input + anchor, size - anchor, 0, 0);
+  return end - output;
+}
@@ -0,0 +1,86 @@
+#include "flasher_pool.h"
+#include "flasher_serial.h"
+#include <pthread.h>
+
+typedef struct
+{
+  flasher_device *devices;
+  uint32_t devices_num;
+  uint32_t next_device;
+  pthread_mutex_t lock;
+  const flasher_image *image;
+  const flasher_options *options;
+} flasher_pool;
+
+// Static functions ----------------------------------------------------------
+
+static flasher_device *take_device(flasher_pool *const pool)
+{
+  flasher_device *device = NULL;
+
+  pthread_mutex_lock(&pool->lock);
+  if (pool->next_device < pool->devices_num)
+    device = pool->devices + pool->next_device++;
+  pthread_mutex_unlock(&pool->lock);
+
+  return device;
+}
+
+static void *run_worker(void *argument)
+{
+  flasher_pool *const pool = argument;
+  flasher_device *device = NULL;
+
+  while ((device = take_device(pool)) != NULL)
+  {
+    device->status = flasher_session_open(
+      &device->session,
+      device->port,
+      pool->options
+    );
+    if (device->status)
+      continue;
+
+    device->status = flasher_session_program(&device->session, pool->image);
+    flasher_session_close(&device->session);
+  }
+
+  return NULL;
+}
+
+// Implementations -----------------------------------------------------------
+
+double flasher_pool_run(
+  flasher_device *const devices,
+  const uint32_t devices_num,
+  const uint32_t workers_num,
+  const flasher_image *const image,
+  const flasher_options *const options
+)
+{
+  pthread_t workers[FLASHER_MAX_DEVICES];
+  uint32_t started = 0;
+  int64_t start_time = flasher_serial_get_time_ms();
+  flasher_pool pool = {
+    .devices = devices,
+    .devices_num = devices_num,
+    .image = image,
+    .options = options
+  };
+
+  pthread_mutex_init(&pool.lock, NULL);
+  for (; started < workers_num && started < FLASHER_MAX_DEVICES; started++)
+  {
+    if (pthread_create(workers + started, NULL, run_worker, &pool))
+      break;
+  }
+  // Without threads the devices are programmed one by one
+  if (started == 0)
+    (void)run_worker(&pool);
+
+  for (uint32_t i = 0; i < started; i++)
+    pthread_join(workers[i], NULL);
+  pthread_mutex_destroy(&pool.lock);
+
+  return (flasher_serial_get_time_ms() - start_time) / 1000.0;
+}
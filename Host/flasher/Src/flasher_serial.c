@@ -0,0 +1,246 @@
+#include "flasher_serial.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct
+{
+  uint32_t baud_rate;
+  speed_t speed;
+} baud_rate_speed;
+
+static const baud_rate_speed speeds[] = {
+  { 9600U, B9600 },
+  { 19200U, B19200 },
+  { 38400U, B38400 },
+  { 57600U, B57600 },
+  { 115200U, B115200 },
+  { 230400U, B230400 },
+  { 460800U, B460800 },
+  { 500000U, B500000 },
+  { 576000U, B576000 },
+  { 921600U, B921600 },
+  { 1000000U, B1000000 },
+  { 1152000U, B1152000 },
+  { 1500000U, B1500000 },
+  { 2000000U, B2000000 },
+  { 2500000U, B2500000 },
+  { 3000000U, B3000000 },
+  { 3500000U, B3500000 },
+  { 4000000U, B4000000 }
+};
+
+// Static functions ----------------------------------------------------------
+
+static bootloader_status wait_for(
+  const int fd,
+  const short events,
+  const int64_t deadline
+)
+{
+  struct pollfd port_poll = { .fd = fd, .events = events };
+  int64_t remaining = deadline - flasher_serial_get_time_ms();
+
+  if (remaining <= 0)
+    return BOOTLOADER_TIMEOUT;
+
+  int ready = poll(&port_poll, 1, (int)remaining);
+  if (ready < 0 && errno != EINTR)
+    return BOOTLOADER_ERROR;
+  if (ready > 0 && (port_poll.revents & (POLLERR | POLLHUP | POLLNVAL)))
+    return BOOTLOADER_ERROR;
+
+  return BOOTLOADER_OK;
+}
+
+// Implementations -----------------------------------------------------------
+
+int64_t flasher_serial_get_time_ms(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+int64_t flasher_serial_get_time_us(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+int flasher_serial_open(const char *const path)
+{
+  struct termios settings;
+  int fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+
+  if (fd < 0)
+    return -1;
+
+  if (tcgetattr(fd, &settings))
+  {
+    close(fd);
+    return -1;
+  }
+  cfmakeraw(&settings);
+  settings.c_cflag |= CLOCAL | CREAD;
+  settings.c_cflag &= ~(CSTOPB | CRTSCTS);
+  if (tcsetattr(fd, TCSANOW, &settings))
+  {
+    close(fd);
+    return -1;
+  }
+
+  if (flasher_serial_set_baud_rate(fd, UART_BAUD_RATE))
+  {
+    close(fd);
+    return -1;
+  }
+  (void)tcflush(fd, TCIOFLUSH);
+
+  return fd;
+}
+
+void flasher_serial_close(const int fd)
+{
+  if (fd >= 0)
+    close(fd);
+}
+
+bootloader_status flasher_serial_set_baud_rate(
+  const int fd,
+  const uint32_t baud_rate
+)
+{
+  struct termios settings;
+
+  for (size_t i = 0; i < sizeof(speeds) / sizeof(speeds[0]); i++)
+  {
+    if (speeds[i].baud_rate != baud_rate)
+      continue;
+
+    if (tcdrain(fd) || tcgetattr(fd, &settings))
+      return BOOTLOADER_ERROR;
+    cfsetispeed(&settings, speeds[i].speed);
+    cfsetospeed(&settings, speeds[i].speed);
+
+    return tcsetattr(fd, TCSANOW, &settings) ?
+      BOOTLOADER_ERROR :
+      BOOTLOADER_OK;
+  }
+
+  return BOOTLOADER_BOUNDS_ERROR;
+}
+
+bootloader_status flasher_serial_read(
+  const int fd,
+  uint8_t *const data,
+  const size_t size,
+  const int timeout_ms
+)
+{
+  int64_t deadline = flasher_serial_get_time_ms() + timeout_ms;
+
+  for (size_t offset = 0; offset < size;)
+  {
+    ssize_t received = read(fd, data + offset, size - offset);
+
+    if (received > 0)
+    {
+      offset += received;
+      continue;
+    }
+    if (received < 0 && errno != EAGAIN && errno != EINTR)
+      return BOOTLOADER_ERROR;
+
+    bootloader_status status = wait_for(fd, POLLIN, deadline);
+    if (status)
+      return status;
+  }
+
+  return BOOTLOADER_OK;
+}
+
+bootloader_status flasher_serial_write(
+  const int fd,
+  const uint8_t *const data,
+  const size_t size,
+  const int timeout_ms
+)
+{
+  int64_t deadline = flasher_serial_get_time_ms() + timeout_ms;
+
+  for (size_t offset = 0; offset < size;)
+  {
+    ssize_t written = write(fd, data + offset, size - offset);
+
+    if (written > 0)
+    {
+      offset += written;
+      continue;
+    }
+    if (written < 0 && errno != EAGAIN && errno != EINTR)
+      return BOOTLOADER_ERROR;
+
+    bootloader_status status = wait_for(fd, POLLOUT, deadline);
+    if (status)
+      return status;
+  }
+
+  return BOOTLOADER_OK;
+}
+
+// Skips input up to and including the pattern
+bootloader_status flasher_serial_read_until(
+  const int fd,
+  const char *const pattern,
+  const int timeout_ms
+)
+{
+  int64_t deadline = flasher_serial_get_time_ms() + timeout_ms;
+  size_t pattern_size = strlen(pattern);
+  size_t matched = 0;
+
+  while (matched < pattern_size)
+  {
+    uint8_t byte = 0;
+    int64_t remaining = deadline - flasher_serial_get_time_ms();
+    bootloader_status status = remaining > 0 ?
+      flasher_serial_read(fd, &byte, 1, (int)remaining) :
+      BOOTLOADER_TIMEOUT;
+
+    if (status)
+      return status;
+
+    if (byte == (uint8_t)pattern[matched])
+      matched++;
+    else
+      matched = byte == (uint8_t)pattern[0] ? 1 : 0;
+  }
+
+  return BOOTLOADER_OK;
+}
+
+// Discards input until the line is quiet for quiet_ms
+void flasher_serial_drain(const int fd, const int quiet_ms)
+{
+  uint8_t buffer[256];
+
+  while (true)
+  {
+    struct pollfd port_poll = { .fd = fd, .events = POLLIN };
+
+    if (poll(&port_poll, 1, quiet_ms) <= 0)
+      break;
+    if (read(fd, buffer, sizeof(buffer)) <= 0 && errno != EAGAIN)
+      break;
+  }
+  (void)tcflush(fd, TCIFLUSH);
+}
@@ -0,0 +1,1825 @@
+#include "flasher_session.h"
+#include "flasher_serial.h"
+#include "flasher_lz.h"
+#include "bootloader_crc.h"
+#include "bootloader_cobs.h"
+#include "bootloader_lz.h"
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static const char *input_prompt = "\r\n>>";
+static const char *bootloader_version_message = "\r\nBootloader version: ";
+
+// Frame of cmd 6, cmd 14 or cmd 15, written in parts when the port does not
+// take it at once
+typedef struct
+{
+  uint8_t data[BLOCK_SIZE + FLASHER_FRAME_OVERHEAD];
+  uint16_t size;
+  uint16_t offset;
+  uint32_t seq;
+} block_frame;
+
+enum
+{
+  FRAME_NEW,
+  FRAME_SENT,
+  FRAME_QUEUED, // to be sent again
+  FRAME_RECEIVED,
+  RESPONSES_BUFFER_SIZE = 2 * (FRAME_RESPONSE_SIZE + 2U)
+};
+
+// Selective repeat over cmd 14 or cmd 15. Frame seq carries block seq,
+// frame count ends the transfer.
+typedef struct
+{
+  const flasher_image *image;
+  const uint32_t *blocks;
+  uint32_t count;
+  uint16_t block_size;
+  uint8_t *states;
+  uint32_t *queue; // frames to send again
+  uint32_t queue_head;
+  uint32_t queue_size;
+  uint32_t in_flight[WINDOW_FRAMES_NUM]; // sent frames waiting for answers
+  uint8_t in_flight_head;
+  uint8_t in_flight_num;
+  uint32_t next_new;
+  uint32_t next_seq; // the first frame missing on the device
+  bool is_answered; // a valid response is taken
+  bool is_done;
+} window_sender;
+
+// Static functions ----------------------------------------------------------
+
+static void sleep_ms(const uint32_t ms)
+{
+  struct timespec time = {
+    .tv_sec = ms / 1000,
+    .tv_nsec = (long)(ms % 1000) * 1000000L
+  };
+
+  while (nanosleep(&time, &time) && errno == EINTR);
+}
+
+static bootloader_status send_byte(
+  flasher_session *const session,
+  const uint8_t byte
+)
+{
+  return flasher_serial_write(session->fd, &byte, 1, session->ack_timeout);
+}
+
+static bootloader_status read_response(
+  flasher_session *const session,
+  const int timeout_ms
+)
+{
+  uint8_t response = 0;
+  bootloader_status status = flasher_serial_read(
+    session->fd,
+    &response,
+    1,
+    timeout_ms
+  );
+
+  if (status == BOOTLOADER_TIMEOUT)
+    session->stats.timeouts++;
+  if (status == BOOTLOADER_OK && response == NACK_BYTE)
+    session->stats.nacks++;
+  if (status == BOOTLOADER_OK && response != ACK_BYTE)
+    status |= BOOTLOADER_ERROR;
+
+  return status;
+}
+
+// No prompt is sent in machine mode
+static bootloader_status read_prompt(flasher_session *const session)
+{
+  if (session->is_machine_mode)
+    return BOOTLOADER_OK;
+
+  return flasher_serial_read_until(
+    session->fd,
+    input_prompt,
+    session->ack_timeout
+  );
+}
+
+// Machine mode opcodes are the command numbers
+static uint8_t get_opcode(
+  const flasher_session *const session,
+  const uint8_t cmd
+)
+{
+  return session->is_machine_mode ? cmd - CMD_HELP : cmd;
+}
+
+static bootloader_status start_command(
+  flasher_session *const session,
+  const uint8_t cmd
+)
+{
+  bootloader_status status = send_byte(session, get_opcode(session, cmd));
+
+  if (status == BOOTLOADER_OK)
+    status |= read_response(session, session->ack_timeout);
+
+  return status;
+}
+
+static uint32_t get_baud_rate(const flasher_session *const session)
+{
+  uint32_t baud_rate = session->options->baud_rate;
+
+  return baud_rate ? baud_rate : UART_BAUD_RATE;
+}
+
+static uint16_t limit_gap(const uint32_t gap, const uint16_t min_gap)
+{
+  if (gap < min_gap)
+    return min_gap;
+
+  return gap > UART_DELAY ? UART_DELAY : gap;
+}
+
+// The longest wait for an answer within a transfer: the window on the
+// line, a page erase with a block programming, and the byte gap after
+// which a cut frame is NACKed
+static uint32_t get_ack_timeout(const flasher_session *const session)
+{
+  uint32_t rtt = (session->rtt_us + 999U) / 1000U;
+  uint32_t window_size = session->window *
+    (session->options->block_size + FLASHER_FRAME_OVERHEAD);
+
+  return 2U * rtt +
+    bootloader_timeout_get_line(
+      window_size + RESPONSES_BUFFER_SIZE,
+      get_baud_rate(session)
+    ) +
+    bootloader_timeout_get_flash(1, BLOCK_SIZE) +
+    session->gaps[TIMEOUT_BYTE_GAP] +
+    FLASHER_TIMEOUT_MARGIN;
+}
+
+// The settings of a device out of a session: human mode and UART_DELAY
+static void reset_session(flasher_session *const session)
+{
+  session->is_machine_mode = false;
+  session->rtt_us = 0;
+  session->gaps[TIMEOUT_FRAME_GAP] = UART_DELAY;
+  session->gaps[TIMEOUT_BYTE_GAP] = UART_DELAY;
+  session->ack_timeout = FLASHER_ACK_TIMEOUT;
+}
+
+static void build_frame(
+  block_frame *const frame,
+  const flasher_image *const image,
+  const uint32_t address,
+  const uint16_t size
+)
+{
+  uint32_t crc = 0;
+
+  memcpy(frame->data, &address, sizeof(uint32_t));
+  memcpy(frame->data + sizeof(uint32_t), &size, sizeof(uint16_t));
+  memcpy(frame->data + 6, flasher_image_at(image, address), size);
+  crc = bootloader_crc32_update(CRC_INIT, frame->data, 6 + size);
+  memcpy(frame->data + 6 + size, &crc, sizeof(uint32_t));
+
+  frame->size = 6 + size + sizeof(uint32_t);
+  frame->offset = 0;
+}
+
+static uint32_t get_first_page(const flasher_image *const image)
+{
+  return image->start & ~(BLOCK_SIZE - 1);
+}
+
+static uint32_t get_end_page(const flasher_image *const image)
+{
+  return (image->end + BLOCK_SIZE - 1) & ~(BLOCK_SIZE - 1);
+}
+
+// The defs this flasher is built with, until a descriptor is read
+static void init_capabilities(flasher_capabilities *const capabilities)
+{
+  memset(capabilities, 0, sizeof(flasher_capabilities));
+  capabilities->page_size = BLOCK_SIZE;
+  capabilities->block_size = BLOCK_SIZE;
+  capabilities->buffer_size = RX_RING_SIZE;
+  capabilities->window_frames = WINDOW_FRAMES_LIMIT;
+  capabilities->flash_size = FLASHER_FLASH_SIZE / 1024U;
+  capabilities->app_address = APP_START_ADDRESS;
+}
+
+static void parse_capabilities(
+  flasher_capabilities *const capabilities,
+  const uint8_t *const descriptor
+)
+{
+  capabilities->protocol_version = descriptor[0];
+  memcpy(capabilities->version, descriptor + 1, 2);
+  memcpy(&capabilities->commands, descriptor + 4, sizeof(uint32_t));
+  memcpy(&capabilities->page_size, descriptor + 8, sizeof(uint16_t));
+  memcpy(&capabilities->block_size, descriptor + 10, sizeof(uint16_t));
+  memcpy(&capabilities->buffer_size, descriptor + 12, sizeof(uint16_t));
+  capabilities->window_frames = descriptor[14];
+  memcpy(&capabilities->flash_size, descriptor + 15, sizeof(uint16_t));
+  memcpy(&capabilities->app_address, descriptor + 17, sizeof(uint32_t));
+  memcpy(capabilities->uid, descriptor + 21, UID_SIZE);
+  memcpy(&capabilities->uart_clock, descriptor + 33, sizeof(uint32_t));
+  capabilities->is_known = true;
+}
+
+// Older bootloaders are probed for the command instead
+static bool is_supported(
+  const flasher_session *const session,
+  const uint8_t cmd
+)
+{
+  const flasher_capabilities *const capabilities = &session->capabilities;
+
+  return !capabilities->is_known ||
+    (cmd - CMD_HELP < 32 && capabilities->commands >> (cmd - CMD_HELP) & 1U);
+}
+
+// The fastest write command of the device: the raw stream, then the framed
+// and windowed transfers. Cmd 15 for older bootloaders.
+static uint8_t select_command(const flasher_session *const session)
+{
+  static const uint8_t commands[] = {
+    CMD_WRITE_STREAM,
+    CMD_WRITE_FRAMED,
+    CMD_WRITE_WINDOW,
+    CMD_WRITE_BLOCK
+  };
+
+  if (!session->capabilities.is_known)
+    return CMD_WRITE_FRAMED;
+
+  for (uint8_t i = 0; i < sizeof(commands); i++)
+  {
+    if (is_supported(session, commands[i]))
+      return commands[i];
+  }
+
+  return 0;
+}
+
+// As flasher_get_window, for the receive ring of the device
+static uint8_t get_device_window(
+  const flasher_capabilities *const capabilities,
+  const uint16_t block_size
+)
+{
+  uint32_t window = capabilities->buffer_size /
+    (block_size + FLASHER_FRAME_OVERHEAD);
+
+  if (window > capabilities->window_frames)
+    window = capabilities->window_frames;
+  if (window > WINDOW_FRAMES_NUM)
+    window = WINDOW_FRAMES_NUM;
+
+  return window ? window : 1;
+}
+
+// As the device checks it: the USART divider (16x oversampling) is from 16
+// to 0xffff and gives the rate within 2%
+static bool is_baud_rate_supported(
+  const flasher_capabilities *const capabilities,
+  const uint32_t baud_rate
+)
+{
+  uint32_t clock = capabilities->uart_clock;
+
+  if (clock == 0)
+    return true;
+  if (baud_rate == 0 || baud_rate > clock / 16 || clock / baud_rate > 0xffff)
+    return false;
+
+  uint32_t actual_baud_rate = clock / ((clock + baud_rate / 2) / baud_rate);
+  uint32_t error = actual_baud_rate > baud_rate ?
+    actual_baud_rate - baud_rate :
+    baud_rate - actual_baud_rate;
+
+  return error * 50 <= baud_rate;
+}
+
+// The command, the window and the options are fitted to the device before
+// anything is erased
+static bootloader_status apply_capabilities(
+  flasher_session *const session,
+  const flasher_image *const image
+)
+{
+  const flasher_capabilities *const capabilities = &session->capabilities;
+  const flasher_options *const options = session->options;
+  uint32_t flash_end = FLASHER_FLASH_BASE +
+    capabilities->flash_size * 1024UL;
+
+  session->command = options->command ?
+    options->command :
+    select_command(session);
+  if (session->command == 0 || !is_supported(session, session->command))
+    return BOOTLOADER_ERROR;
+  if (
+    capabilities->page_size != BLOCK_SIZE ||
+    options->block_size > capabilities->block_size ||
+    image->start < capabilities->app_address ||
+    get_end_page(image) > flash_end ||
+    !is_baud_rate_supported(capabilities, get_baud_rate(session))
+  )
+    return BOOTLOADER_BOUNDS_ERROR;
+
+  uint8_t window = get_device_window(capabilities, options->block_size);
+  if (options->window == 0 || options->window > window)
+    session->window = window;
+
+  return BOOTLOADER_OK;
+}
+
+// Blocks to send: the first block of each page with data (it makes the
+// device erase the page) and the other blocks with data
+static uint32_t plan_blocks(
+  const flasher_session *const session,
+  const flasher_image *const image,
+  uint32_t *const blocks
+)
+{
+  uint16_t block_size = session->options->block_size;
+  uint32_t count = 0;
+
+  for (
+    uint32_t page = get_first_page(image);
+    page < get_end_page(image);
+    page += BLOCK_SIZE
+  )
+  {
+    if (flasher_image_is_blank(image, page, BLOCK_SIZE))
+      continue;
+
+    for (uint32_t block = page; block < page + BLOCK_SIZE; block += block_size)
+    {
+      if (block == page || !flasher_image_is_blank(image, block, block_size))
+        blocks[count++] = block;
+    }
+  }
+
+  return count;
+}
+
+// Pages without data are not covered by blocks, so they are erased
+static bootloader_status erase_blank_pages(
+  flasher_session *const session,
+  const flasher_image *const image
+)
+{
+  bootloader_status status = BOOTLOADER_OK;
+  uint32_t run_start = 0;
+  uint8_t run_pages = 0;
+
+  for (
+    uint32_t page = get_first_page(image);
+    page <= get_end_page(image) && status == BOOTLOADER_OK;
+    page += BLOCK_SIZE
+  )
+  {
+    bool is_blank = page < get_end_page(image) &&
+      flasher_image_is_blank(image, page, BLOCK_SIZE);
+
+    if (is_blank && run_pages < UINT8_MAX)
+    {
+      if (run_pages++ == 0)
+        run_start = page;
+      continue;
+    }
+
+    if (run_pages)
+      status |= flasher_session_erase(session, run_start, run_pages);
+    run_start = page;
+    run_pages = is_blank ? 1 : 0;
+  }
+
+  return status;
+}
+
+// Keeps up to window frames unacknowledged, the port is written while
+// acknowledgements are read. Returns the number of acknowledged blocks in
+// acked.
+static bootloader_status send_blocks(
+  flasher_session *const session,
+  const flasher_image *const image,
+  const uint32_t *const blocks,
+  const uint32_t count,
+  uint32_t *const acked
+)
+{
+  block_frame frame;
+  uint16_t block_size = session->options->block_size;
+  uint32_t sent = *acked;
+  int64_t deadline = flasher_serial_get_time_ms() + session->ack_timeout;
+  bootloader_status status = start_command(session, CMD_WRITE_BLOCK);
+
+  frame.size = 0;
+  while (status == BOOTLOADER_OK && *acked < count)
+  {
+    if (frame.size == 0 && sent < count && sent - *acked < session->window)
+      build_frame(&frame, image, blocks[sent], block_size);
+
+    struct pollfd port_poll = {
+      .fd = session->fd,
+      .events = frame.size ? POLLIN | POLLOUT : POLLIN
+    };
+    int64_t remaining = deadline - flasher_serial_get_time_ms();
+    if (remaining <= 0)
+    {
+      session->stats.timeouts++;
+      status |= BOOTLOADER_TIMEOUT;
+      break;
+    }
+    if (poll(&port_poll, 1, (int)remaining) < 0 && errno != EINTR)
+      status |= BOOTLOADER_ERROR;
+    if (port_poll.revents & (POLLERR | POLLHUP | POLLNVAL))
+      status |= BOOTLOADER_ERROR;
+
+    if (status == BOOTLOADER_OK && (port_poll.revents & POLLOUT))
+    {
+      ssize_t written = write(
+        session->fd,
+        frame.data + frame.offset,
+        frame.size - frame.offset
+      );
+
+      if (written > 0)
+        frame.offset += written;
+      if (frame.size && frame.offset == frame.size)
+      {
+        frame.size = 0;
+        sent++;
+        session->stats.frames++;
+      }
+    }
+
+    if (status == BOOTLOADER_OK && (port_poll.revents & POLLIN))
+    {
+      uint8_t responses[8];
+      ssize_t received = read(session->fd, responses, sizeof(responses));
+
+      for (ssize_t i = 0; i < received && status == BOOTLOADER_OK; i++)
+      {
+        if (responses[i] == ACK_BYTE && *acked < sent)
+        {
+          (*acked)++;
+          session->stats.bytes += block_size;
+          deadline = flasher_serial_get_time_ms() + session->ack_timeout;
+          continue;
+        }
+
+        if (responses[i] == NACK_BYTE)
+          session->stats.nacks++;
+        status |= BOOTLOADER_ERROR;
+      }
+    }
+  }
+
+  if (status)
+    return status;
+
+  // The end sequence is acknowledged when the last block is programmed
+  uint32_t end = END_SUBSEQUENCE;
+  status |= flasher_serial_write(
+    session->fd,
+    (uint8_t*)&end,
+    sizeof(uint32_t),
+    session->ack_timeout
+  );
+  if (status == BOOTLOADER_OK)
+    status |= read_response(session, session->ack_timeout);
+  if (status == BOOTLOADER_OK)
+    status |= read_prompt(session);
+
+  return status;
+}
+
+static void build_window_frame(
+  block_frame *const frame,
+  const window_sender *const sender,
+  const uint32_t seq
+)
+{
+  uint16_t frame_seq = seq;
+  uint32_t address = END_SUBSEQUENCE;
+  uint16_t size = 0;
+  uint32_t crc = 0;
+
+  if (seq < sender->count)
+  {
+    address = sender->blocks[seq];
+    size = sender->block_size;
+    memcpy(
+      frame->data + WINDOW_HEADER_SIZE,
+      flasher_image_at(sender->image, address),
+      size
+    );
+  }
+  memcpy(frame->data, &frame_seq, sizeof(uint16_t));
+  memcpy(frame->data + 2, &address, sizeof(uint32_t));
+  memcpy(frame->data + 6, &size, sizeof(uint16_t));
+  crc = bootloader_crc32_update(
+    CRC_INIT,
+    frame->data,
+    WINDOW_HEADER_SIZE + size
+  );
+  memcpy(frame->data + WINDOW_HEADER_SIZE + size, &crc, sizeof(uint32_t));
+
+  frame->size = WINDOW_HEADER_SIZE + size + sizeof(uint32_t);
+  frame->offset = 0;
+  frame->seq = seq;
+}
+
+// The frame starts with a delimiter, which ends a broken frame before it
+static void build_framed_frame(
+  block_frame *const frame,
+  const window_sender *const sender,
+  const uint32_t seq
+)
+{
+  uint8_t packet[FRAME_MAX_SIZE];
+  uint16_t frame_seq = seq;
+  uint16_t size = 3;
+  uint16_t crc = 0;
+
+  packet[0] = seq < sender->count ? FRAME_DATA : FRAME_END;
+  memcpy(packet + 1, &frame_seq, sizeof(uint16_t));
+  if (seq < sender->count)
+  {
+    uint32_t address = sender->blocks[seq];
+
+    memcpy(packet + 3, &address, sizeof(uint32_t));
+    memcpy(
+      packet + FRAME_HEADER_SIZE,
+      flasher_image_at(sender->image, address),
+      sender->block_size
+    );
+    size = FRAME_HEADER_SIZE + sender->block_size;
+  }
+  crc = bootloader_crc16_update(CRC16_INIT, packet, size);
+  memcpy(packet + size, &crc, sizeof(uint16_t));
+
+  frame->data[0] = FRAME_DELIMITER;
+  frame->size = 1 + bootloader_cobs_encode(
+    packet,
+    size + sizeof(uint16_t),
+    frame->data + 1
+  );
+  frame->data[frame->size++] = FRAME_DELIMITER;
+  frame->offset = 0;
+  frame->seq = seq;
+}
+
+static void queue_frame(window_sender *const sender, const uint32_t seq)
+{
+  if (sender->states[seq] != FRAME_SENT)
+    return;
+
+  sender->states[seq] = FRAME_QUEUED;
+  sender->queue[(sender->queue_head + sender->queue_size) %
+    (sender->count + 1)] = seq;
+  sender->queue_size++;
+}
+
+// Frames that are not answered are taken as lost
+static void lose_in_flight(window_sender *const sender)
+{
+  for (uint32_t seq = sender->next_seq; seq < sender->next_new; seq++)
+    queue_frame(sender, seq);
+  sender->in_flight_num = 0;
+}
+
+// Frames to send again go first. New frames are limited by the window of
+// the device, the end frame waits for all the others.
+static int64_t take_frame(window_sender *const sender)
+{
+  while (sender->queue_size)
+  {
+    uint32_t seq = sender->queue[sender->queue_head];
+
+    sender->queue_head = (sender->queue_head + 1) % (sender->count + 1);
+    sender->queue_size--;
+    if (sender->states[seq] == FRAME_QUEUED)
+      return seq;
+  }
+
+  if (
+    sender->next_new < sender->count &&
+    sender->next_new - sender->next_seq <= WINDOW_FRAMES_NUM
+  )
+    return sender->next_new++;
+  if (sender->next_new == sender->count && sender->next_seq == sender->count)
+    return sender->next_new++;
+
+  return -1;
+}
+
+static void push_in_flight(window_sender *const sender, const uint32_t seq)
+{
+  sender->in_flight[
+    (sender->in_flight_head + sender->in_flight_num) % WINDOW_FRAMES_NUM
+  ] = seq;
+  sender->in_flight_num++;
+}
+
+static int64_t pop_in_flight(window_sender *const sender)
+{
+  if (sender->in_flight_num == 0)
+    return -1;
+
+  uint32_t seq = sender->in_flight[sender->in_flight_head];
+  sender->in_flight_head = (sender->in_flight_head + 1) % WINDOW_FRAMES_NUM;
+  sender->in_flight_num--;
+
+  return seq;
+}
+
+static bool is_window_response(const uint8_t *const response)
+{
+  uint32_t crc = 0;
+
+  memcpy(&crc, response + 8, sizeof(uint32_t));
+  return (response[0] == ACK_BYTE || response[0] == NACK_BYTE) &&
+    crc == bootloader_crc32_update(CRC_INIT, response, 8);
+}
+
+// The response carries the state of the device (the first missing frame,
+// received frames after it), so it also covers the answers that are lost.
+// The first missing frame never goes back within a transfer: an answer
+// behind it is of a command started by frames taken as input, after the
+// device dropped the session.
+static bootloader_status update_window_state(
+  flasher_session *const session,
+  window_sender *const sender,
+  const uint8_t *const state
+)
+{
+  uint16_t next_seq = 0;
+  uint32_t received = 0;
+
+  memcpy(&next_seq, state, sizeof(uint16_t));
+  memcpy(&received, state + 2, sizeof(uint32_t));
+  if (next_seq < sender->next_seq)
+    return BOOTLOADER_ERROR;
+  for (uint32_t seq = sender->next_seq; seq < next_seq; seq++)
+  {
+    if (seq < sender->count)
+      sender->states[seq] = FRAME_RECEIVED;
+  }
+  if (next_seq > sender->next_seq && next_seq <= sender->count)
+  {
+    session->stats.bytes += (next_seq - sender->next_seq) * sender->block_size;
+    sender->next_seq = next_seq;
+  }
+  for (uint8_t i = 0; i < WINDOW_FRAMES_NUM; i++)
+  {
+    if ((received & (1UL << i)) && next_seq + 1U + i < sender->count)
+      sender->states[next_seq + 1U + i] = FRAME_RECEIVED;
+  }
+
+  return BOOTLOADER_OK;
+}
+
+// A NACK of a corrupted frame sends it again, of an undelimited one - all
+// unanswered frames. Other errors end the transfer.
+static bootloader_status apply_window_response(
+  flasher_session *const session,
+  window_sender *const sender,
+  const uint8_t *const response
+)
+{
+  bootloader_status status = update_window_state(
+    session,
+    sender,
+    response + 2
+  );
+
+  if (status)
+    return status;
+
+  int64_t seq = pop_in_flight(sender);
+  if (response[0] == ACK_BYTE)
+  {
+    sender->is_done = seq == sender->count;
+    return BOOTLOADER_OK;
+  }
+
+  session->stats.nacks++;
+  switch (response[1])
+  {
+    case BOOTLOADER_CRC_ERROR:
+      if (seq >= 0)
+        queue_frame(sender, seq);
+      return BOOTLOADER_OK;
+    case BOOTLOADER_BOUNDS_ERROR:
+    case BOOTLOADER_TIMEOUT:
+      if (seq >= 0)
+        queue_frame(sender, seq);
+      lose_in_flight(sender);
+      return BOOTLOADER_OK;
+    default:
+      return response[1] ? response[1] : BOOTLOADER_ERROR;
+  }
+}
+
+static bool is_in_flight(const window_sender *const sender, const uint32_t seq)
+{
+  for (uint8_t i = 0; i < sender->in_flight_num; i++)
+  {
+    uint8_t index = (sender->in_flight_head + i) % WINDOW_FRAMES_NUM;
+
+    if (sender->in_flight[index] == seq)
+      return true;
+  }
+
+  return false;
+}
+
+// The response is decoded into FRAME_RESPONSE_SIZE bytes
+static bool is_frame_response(
+  const uint8_t *const frame,
+  const uint16_t frame_size,
+  uint8_t *const response
+)
+{
+  uint16_t size = 0;
+  uint16_t crc = 0;
+
+  if (
+    frame_size > FRAME_RESPONSE_SIZE + 1 ||
+    bootloader_cobs_decode(frame, frame_size, response, &size) ||
+    size != FRAME_RESPONSE_SIZE
+  )
+    return false;
+
+  memcpy(&crc, response + 10, sizeof(uint16_t));
+  return (response[0] == FRAME_ACK || response[0] == FRAME_NACK) &&
+    crc == bootloader_crc16_update(CRC16_INIT, response, 10);
+}
+
+// Answers come in the order of the frames, so the unanswered frames sent
+// before the answered one are lost. The sequence number of a corrupted
+// frame is not known, it is the first one in flight. Any NACK sends only
+// its frame again, as the frames after it are taken by the device.
+static bootloader_status apply_frame_response(
+  flasher_session *const session,
+  window_sender *const sender,
+  const uint8_t *const response
+)
+{
+  uint16_t frame_seq = 0;
+  int64_t seq = -1;
+  bootloader_status status = update_window_state(
+    session,
+    sender,
+    response + 4
+  );
+
+  if (status)
+    return status;
+  memcpy(&frame_seq, response + 2, sizeof(uint16_t));
+  if (frame_seq == FRAME_UNKNOWN_SEQ)
+    seq = pop_in_flight(sender);
+  else if (is_in_flight(sender, frame_seq))
+  {
+    while ((seq = pop_in_flight(sender)) != frame_seq)
+      queue_frame(sender, seq);
+  }
+
+  if (response[0] == FRAME_ACK)
+  {
+    sender->is_done = frame_seq == sender->count;
+    return BOOTLOADER_OK;
+  }
+
+  session->stats.nacks++;
+  switch (response[1])
+  {
+    case BOOTLOADER_CRC_ERROR:
+    case BOOTLOADER_BOUNDS_ERROR:
+    case BOOTLOADER_TIMEOUT:
+      if (seq >= 0)
+        queue_frame(sender, seq);
+      return BOOTLOADER_OK;
+    default:
+      return response[1] ? response[1] : BOOTLOADER_ERROR;
+  }
+}
+
+// Bytes that do not start a valid response are skipped
+static bootloader_status take_window_responses(
+  flasher_session *const session,
+  window_sender *const sender,
+  uint8_t *const responses,
+  uint16_t *const size
+)
+{
+  bootloader_status status = BOOTLOADER_OK;
+
+  while (status == BOOTLOADER_OK && *size >= WINDOW_RESPONSE_SIZE)
+  {
+    uint16_t used = 1;
+
+    if (is_window_response(responses))
+    {
+      status |= apply_window_response(session, sender, responses);
+      sender->is_answered = true;
+      used = WINDOW_RESPONSE_SIZE;
+    }
+    *size -= used;
+    memmove(responses, responses + used, *size);
+  }
+
+  return status;
+}
+
+// Responses end with a delimiter, broken ones are skipped with it
+static bootloader_status take_frame_responses(
+  flasher_session *const session,
+  window_sender *const sender,
+  uint8_t *const responses,
+  uint16_t *const size
+)
+{
+  bootloader_status status = BOOTLOADER_OK;
+  uint8_t *delimiter = NULL;
+
+  while (
+    status == BOOTLOADER_OK &&
+    (delimiter = memchr(responses, FRAME_DELIMITER, *size)) != NULL
+  )
+  {
+    uint16_t frame_size = delimiter - responses;
+    uint8_t response[FRAME_RESPONSE_SIZE];
+
+    if (is_frame_response(responses, frame_size, response))
+    {
+      status |= apply_frame_response(session, sender, response);
+      sender->is_answered = true;
+    }
+    *size -= frame_size + 1;
+    memmove(responses, delimiter + 1, *size);
+  }
+  // No delimiter in a full buffer
+  if (*size == RESPONSES_BUFFER_SIZE)
+    *size = 0;
+
+  return status;
+}
+
+// Windowed transfer from block acked on. Lost and corrupted frames are sent
+// again until max_retries timeouts in a row.
+static bootloader_status send_window(
+  flasher_session *const session,
+  const flasher_image *const image,
+  const uint32_t *const blocks,
+  const uint32_t count,
+  uint32_t *const acked
+)
+{
+  block_frame frame;
+  window_sender sender = {
+    .image = image,
+    .blocks = blocks + *acked,
+    .count = count - *acked,
+    .block_size = session->options->block_size
+  };
+  bool is_framed = session->command == CMD_WRITE_FRAMED;
+  uint8_t responses[RESPONSES_BUFFER_SIZE];
+  uint16_t responses_size = 0;
+  uint8_t timeouts_num = 0;
+  int64_t deadline = flasher_serial_get_time_ms() + session->ack_timeout;
+  bootloader_status status = BOOTLOADER_OK;
+
+  sender.states = calloc(sender.count + 1, sizeof(uint8_t));
+  sender.queue = malloc((sender.count + 1) * sizeof(uint32_t));
+  if (sender.states == NULL || sender.queue == NULL)
+    status |= BOOTLOADER_ERROR;
+  if (status == BOOTLOADER_OK)
+    status |= start_command(session, session->command);
+
+  frame.size = 0;
+  while (status == BOOTLOADER_OK && !sender.is_done)
+  {
+    if (frame.size == 0 && sender.in_flight_num < session->window)
+    {
+      int64_t seq = take_frame(&sender);
+      if (seq >= 0 && is_framed)
+        build_framed_frame(&frame, &sender, seq);
+      else if (seq >= 0)
+        build_window_frame(&frame, &sender, seq);
+    }
+
+    struct pollfd port_poll = {
+      .fd = session->fd,
+      .events = frame.size ? POLLIN | POLLOUT : POLLIN
+    };
+    int64_t remaining = deadline - flasher_serial_get_time_ms();
+    if (remaining <= 0)
+    {
+      session->stats.timeouts++;
+      if (++timeouts_num > session->options->max_retries)
+        status |= BOOTLOADER_TIMEOUT;
+      lose_in_flight(&sender);
+      deadline = flasher_serial_get_time_ms() + session->ack_timeout;
+      continue;
+    }
+    if (poll(&port_poll, 1, (int)remaining) < 0 && errno != EINTR)
+      status |= BOOTLOADER_ERROR;
+    if (port_poll.revents & (POLLERR | POLLHUP | POLLNVAL))
+      status |= BOOTLOADER_ERROR;
+
+    if (status == BOOTLOADER_OK && (port_poll.revents & POLLOUT))
+    {
+      ssize_t written = write(
+        session->fd,
+        frame.data + frame.offset,
+        frame.size - frame.offset
+      );
+
+      if (written > 0)
+        frame.offset += written;
+      if (frame.size && frame.offset == frame.size)
+      {
+        if (sender.states[frame.seq] == FRAME_QUEUED)
+          session->stats.retransmits++;
+        if (sender.in_flight_num == 0)
+          deadline = flasher_serial_get_time_ms() + session->ack_timeout;
+        sender.states[frame.seq] = FRAME_SENT;
+        push_in_flight(&sender, frame.seq);
+        session->stats.frames++;
+        frame.size = 0;
+      }
+    }
+
+    if (status == BOOTLOADER_OK && (port_poll.revents & POLLIN))
+    {
+      ssize_t received = read(
+        session->fd,
+        responses + responses_size,
+        sizeof(responses) - responses_size
+      );
+
+      if (received > 0)
+        responses_size += received;
+      sender.is_answered = false;
+      status |= is_framed ?
+        take_frame_responses(session, &sender, responses, &responses_size) :
+        take_window_responses(session, &sender, responses, &responses_size);
+      if (sender.is_answered)
+      {
+        timeouts_num = 0;
+        deadline = flasher_serial_get_time_ms() + session->ack_timeout;
+      }
+    }
+  }
+
+  *acked += sender.next_seq;
+  free(sender.states);
+  free(sender.queue);
+  if (status == BOOTLOADER_OK)
+    status |= read_prompt(session);
+
+  return status;
+}
+
+// The programming of the block before the failed one is not confirmed, so
+// the transfer is resumed from the first block of its page, which makes the
+// device erase the page again
+static uint32_t get_resume_block(
+  const uint32_t *const blocks,
+  uint32_t acked
+)
+{
+  if (acked)
+    acked--;
+
+  uint32_t page = blocks[acked] & ~(BLOCK_SIZE - 1);
+  while (acked && blocks[acked - 1] >= page)
+    acked--;
+
+  return acked;
+}
+
+// A checkpoint confirms the stream up to its size when its crc32 matches
+static bootloader_status apply_checkpoint(
+  flasher_session *const session,
+  const uint8_t *const checkpoint,
+  const uint8_t *const data,
+  const uint32_t sent,
+  uint32_t *const position,
+  uint32_t *const crc
+)
+{
+  uint32_t checkpoint_position = 0;
+  uint32_t checkpoint_crc = 0;
+
+  if (checkpoint[0] != ACK_BYTE)
+  {
+    if (checkpoint[0] == NACK_BYTE)
+      session->stats.nacks++;
+    return BOOTLOADER_ERROR;
+  }
+
+  memcpy(&checkpoint_position, checkpoint + 1, sizeof(uint32_t));
+  memcpy(&checkpoint_crc, checkpoint + 5, sizeof(uint32_t));
+  if (checkpoint_position <= *position || checkpoint_position > sent)
+    return BOOTLOADER_ERROR;
+
+  uint32_t expected_crc = bootloader_crc32_update(
+    *crc,
+    data + *position,
+    checkpoint_position - *position
+  );
+  if (checkpoint_crc != expected_crc)
+    return BOOTLOADER_CRC_ERROR;
+
+  session->stats.bytes += checkpoint_position - *position;
+  session->stats.frames++;
+  *position = checkpoint_position;
+  *crc = expected_crc;
+
+  return BOOTLOADER_OK;
+}
+
+// Raw stream with cmd 17 from start + confirmed on. Up to the receive ring
+// of the device is sent ahead of the last checkpoint, so it is not
+// overwritten while the device programs. Returns the confirmed size
+// in confirmed.
+static bootloader_status send_stream(
+  flasher_session *const session,
+  const flasher_image *const image,
+  const uint32_t start,
+  const uint32_t size,
+  uint32_t *const confirmed
+)
+{
+  uint32_t request[2] = { start + *confirmed, size - *confirmed };
+  const uint8_t *const data = flasher_image_at(image, request[0]);
+  uint8_t checkpoint[STREAM_RESPONSE_SIZE];
+  uint16_t checkpoint_size = 0;
+  uint32_t sent = 0;
+  uint32_t position = 0;
+  uint32_t crc = CRC_INIT;
+  int64_t deadline = 0;
+  bootloader_status status = start_command(session, CMD_WRITE_STREAM);
+
+  if (status == BOOTLOADER_OK)
+    status |= flasher_serial_write(
+      session->fd,
+      (uint8_t*)request,
+      sizeof(request),
+      session->ack_timeout
+    );
+  if (status == BOOTLOADER_OK)
+    status |= read_response(session, session->ack_timeout);
+
+  deadline = flasher_serial_get_time_ms() + session->ack_timeout;
+  while (status == BOOTLOADER_OK && position < request[1])
+  {
+    uint32_t ahead = session->capabilities.buffer_size;
+    uint32_t limit = request[1] - position > ahead ?
+      position + ahead :
+      request[1];
+    struct pollfd port_poll = {
+      .fd = session->fd,
+      .events = sent < limit ? POLLIN | POLLOUT : POLLIN
+    };
+    int64_t remaining = deadline - flasher_serial_get_time_ms();
+    if (remaining <= 0)
+    {
+      session->stats.timeouts++;
+      status |= BOOTLOADER_TIMEOUT;
+      break;
+    }
+    if (poll(&port_poll, 1, (int)remaining) < 0 && errno != EINTR)
+      status |= BOOTLOADER_ERROR;
+    if (port_poll.revents & (POLLERR | POLLHUP | POLLNVAL))
+      status |= BOOTLOADER_ERROR;
+
+    if (status == BOOTLOADER_OK && (port_poll.revents & POLLOUT))
+    {
+      ssize_t written = write(session->fd, data + sent, limit - sent);
+
+      if (written > 0)
+        sent += written;
+    }
+
+    if (status == BOOTLOADER_OK && (port_poll.revents & POLLIN))
+    {
+      ssize_t received = read(
+        session->fd,
+        checkpoint + checkpoint_size,
+        STREAM_RESPONSE_SIZE - checkpoint_size
+      );
+
+      if (received > 0)
+        checkpoint_size += received;
+      if (checkpoint_size == STREAM_RESPONSE_SIZE)
+      {
+        status |= apply_checkpoint(
+          session,
+          checkpoint,
+          data,
+          sent,
+          &position,
+          &crc
+        );
+        checkpoint_size = 0;
+        deadline = flasher_serial_get_time_ms() + session->ack_timeout;
+      }
+    }
+  }
+
+  *confirmed += position;
+  if (status == BOOTLOADER_OK)
+    status |= read_prompt(session);
+
+  return status;
+}
+
+// The answer to a chunk of cmd 8 comes when the previous one is decoded
+// and its pages are programmed
+static bootloader_status send_chunk(
+  flasher_session *const session,
+  const uint8_t *const chunk,
+  const uint16_t size,
+  const uint32_t decoded_size
+)
+{
+  uint8_t frame[sizeof(uint16_t) + BLOCK_SIZE + sizeof(uint32_t)];
+  uint32_t crc = 0;
+
+  memcpy(frame, &size, sizeof(uint16_t));
+  memcpy(frame + sizeof(uint16_t), chunk, size);
+  crc = bootloader_crc32_update(CRC_INIT, frame, sizeof(uint16_t) + size);
+  memcpy(frame + sizeof(uint16_t) + size, &crc, sizeof(uint32_t));
+
+  bootloader_status status = flasher_serial_write(
+    session->fd,
+    frame,
+    size ? sizeof(uint16_t) + size + sizeof(uint32_t) : sizeof(uint16_t),
+    session->ack_timeout
+  );
+  if (status == BOOTLOADER_OK)
+    status |= read_response(
+      session,
+      session->ack_timeout + bootloader_timeout_get_flash(
+        decoded_size / BLOCK_SIZE + 1,
+        decoded_size + BLOCK_SIZE
+      )
+    );
+  if (status == BOOTLOADER_OK)
+    session->stats.frames++;
+
+  return status;
+}
+
+// Cmd 8 with the range from start + confirmed on, compressed as one block
+// and sent in chunks of the block size. The chunks are decoded here as
+// well, to know how much the device has programmed when it answers.
+// Returns the confirmed size in confirmed.
+static bootloader_status send_compressed(
+  flasher_session *const session,
+  const flasher_image *const image,
+  const uint32_t start,
+  const uint32_t size,
+  uint32_t *const confirmed
+)
+{
+  uint32_t request[2] = { start + *confirmed, size - *confirmed };
+  uint16_t chunk_size = session->options->block_size;
+  uint8_t *const compressed = malloc(flasher_lz_get_bound(request[1]));
+  uint8_t window[LZ_WINDOW_SIZE];
+  bootloader_lz_decoder decoder;
+  uint32_t decoded_size = 0;
+  bootloader_status status = BOOTLOADER_OK;
+
+  if (compressed == NULL)
+    return BOOTLOADER_ERROR;
+
+  size_t compressed_size = flasher_lz_compress(
+    flasher_image_at(image, request[0]),
+    request[1],
+    compressed
+  );
+  bootloader_lz_init(&decoder, window);
+  status |= start_command(session, CMD_WRITE_COMPRESSED);
+  if (status == BOOTLOADER_OK)
+    status |= flasher_serial_write(
+      session->fd,
+      (uint8_t*)request,
+      sizeof(request),
+      session->ack_timeout
+    );
+  if (status == BOOTLOADER_OK)
+    status |= read_response(session, session->ack_timeout);
+
+  for (
+    size_t offset = 0;
+    status == BOOTLOADER_OK && offset < compressed_size;
+    offset += chunk_size
+  )
+  {
+    const uint32_t position = decoder.position;
+
+    if (compressed_size - offset < chunk_size)
+      chunk_size = compressed_size - offset;
+    status |= send_chunk(
+      session,
+      compressed + offset,
+      chunk_size,
+      decoded_size
+    );
+    if (status)
+      break;
+
+    uint32_t done = request[0] - start + position;
+    session->stats.bytes += done - *confirmed;
+    *confirmed = done;
+    bootloader_lz_set_input(&decoder, compressed + offset, chunk_size);
+    (void)bootloader_lz_decode(&decoder, request[1]);
+    decoded_size = decoder.position - position;
+  }
+
+  // The end of stream is answered when everything is programmed
+  if (status == BOOTLOADER_OK)
+    status |= send_chunk(session, compressed, 0, decoded_size);
+  if (status == BOOTLOADER_OK)
+  {
+    session->stats.bytes += size - *confirmed;
+    *confirmed = size;
+    status |= read_prompt(session);
+  }
+
+  free(compressed);
+  return status;
+}
+
+// The version request is answered with the prompt (or with ACK and the
+// version in machine mode)
+static bootloader_status request_version(flasher_session *const session)
+{
+  uint8_t version[2];
+  bootloader_status status = send_byte(
+    session,
+    get_opcode(session, CMD_GET_BOOTLOADER_VER)
+  );
+
+  if (status == BOOTLOADER_OK && session->is_machine_mode)
+  {
+    status |= read_response(session, session->ack_timeout);
+    if (status == BOOTLOADER_OK)
+      status |= flasher_serial_read(
+        session->fd,
+        version,
+        sizeof(version),
+        session->ack_timeout
+      );
+  }
+  else if (status == BOOTLOADER_OK)
+    status |= flasher_serial_read_until(
+      session->fd,
+      bootloader_version_message,
+      session->ack_timeout
+    );
+  if (status == BOOTLOADER_OK)
+    status |= read_prompt(session);
+
+  return status;
+}
+
+// A transfer is resumed once the device left the command: a window one
+// ends after WINDOW_IDLE_TIME without frames. A device left idle for
+// SESSION_IDLE_TIME (e.g. a host paused by a debugger) is connected in
+// human mode with the default gaps, so they and the mode of the transfer
+// are set again.
+static bootloader_status reconnect(flasher_session *const session)
+{
+  bool is_machine_mode = session->is_machine_mode;
+  bool is_tuned = session->rtt_us != 0;
+
+  flasher_serial_drain(session->fd, WINDOW_IDLE_TIME + UART_DELAY);
+  bootloader_status status = flasher_session_connect(session);
+
+  if (status == BOOTLOADER_OK && is_tuned && !session->rtt_us)
+    status |= flasher_session_tune_timeouts(session);
+  if (status == BOOTLOADER_OK && is_machine_mode && !session->is_machine_mode)
+    status |= flasher_session_set_mode(session, MODE_MACHINE);
+
+  return status;
+}
+
+// The stream (cmd 17) or the compressed block (cmd 8) covers the pages of
+// the image, blank ones included, so none is erased separately. A failed
+// transfer is resumed from the page of the last confirmed piece, whose
+// programming is not confirmed.
+static bootloader_status write_stream(
+  flasher_session *const session,
+  const flasher_image *const image
+)
+{
+  uint32_t start = get_first_page(image);
+  // Halfword programming: the end is padded with the erased value
+  uint32_t size = (image->end - start + 1) & ~1U;
+  uint32_t confirmed = 0;
+  bootloader_status status = BOOTLOADER_OK;
+
+  for (uint8_t i = 0; status == BOOTLOADER_OK; i++)
+  {
+    status |= session->command == CMD_WRITE_STREAM ?
+      send_stream(session, image, start, size, &confirmed) :
+      send_compressed(session, image, start, size, &confirmed);
+    if (status == BOOTLOADER_OK || i == session->options->max_retries)
+      break;
+
+    uint32_t resume = confirmed ? (confirmed - 1) & ~(BLOCK_SIZE - 1) : 0;
+    session->stats.retries++;
+    session->stats.bytes -= confirmed - resume;
+    confirmed = resume;
+    status = reconnect(session);
+  }
+
+  return status;
+}
+
+// Implementations -----------------------------------------------------------
+
+void flasher_options_init(flasher_options *const options)
+{
+  options->baud_rate = UART_BAUD_RATE;
+  options->block_size = FLASHER_DEFAULT_BLOCK_SIZE;
+  options->window = 0;
+  options->max_retries = FLASHER_DEFAULT_RETRIES;
+  options->verify = false;
+  options->command = 0;
+}
+
+bootloader_status flasher_options_check(const flasher_options *const options)
+{
+  uint16_t block_size = options->block_size;
+
+  if (
+    block_size < FLASHER_MIN_BLOCK_SIZE ||
+    block_size > BLOCK_SIZE ||
+    (block_size & (block_size - 1))
+  )
+    return BOOTLOADER_BOUNDS_ERROR;
+  if (options->window > flasher_get_window(block_size))
+    return BOOTLOADER_BOUNDS_ERROR;
+  if (
+    options->command != 0 &&
+    options->command != CMD_WRITE_FRAMED &&
+    options->command != CMD_WRITE_STREAM &&
+    options->command != CMD_WRITE_WINDOW &&
+    options->command != CMD_WRITE_BLOCK &&
+    options->command != CMD_WRITE_COMPRESSED
+  )
+    return BOOTLOADER_ERROR;
+
+  return BOOTLOADER_OK;
+}
+
+// Frames in flight must fit in the receive ring of the device, or they are
+// overwritten while it programs
+uint8_t flasher_get_window(const uint16_t block_size)
+{
+  uint32_t window = RX_RING_SIZE / (block_size + FLASHER_FRAME_OVERHEAD);
+
+  if (window == 0)
+    return 1;
+
+  return window > WINDOW_FRAMES_LIMIT ? WINDOW_FRAMES_LIMIT : window;
+}
+
+bootloader_status flasher_session_open(
+  flasher_session *const session,
+  const char *const port,
+  const flasher_options *const options
+)
+{
+  memset(session, 0, sizeof(flasher_session));
+  session->port = port;
+  session->options = options;
+  init_capabilities(&session->capabilities);
+  session->command = options->command;
+  session->window = options->window ?
+    options->window :
+    flasher_get_window(options->block_size);
+  reset_session(session);
+  session->fd = flasher_serial_open(port);
+
+  return session->fd < 0 ? BOOTLOADER_ERROR : BOOTLOADER_OK;
+}
+
+void flasher_session_close(flasher_session *const session)
+{
+  flasher_serial_close(session->fd);
+  session->fd = -1;
+}
+
+// Stale output is skipped, then the version is requested. A command
+// interrupted by the host is finished by a few attempts. A device that
+// dropped the session after SESSION_IDLE_TIME is asked in human mode, and
+// the session takes its defaults once it answers.
+bootloader_status flasher_session_connect(flasher_session *const session)
+{
+  bootloader_status status = BOOTLOADER_OK;
+
+  for (uint8_t i = 0; i <= session->options->max_retries; i++)
+  {
+    flasher_serial_drain(session->fd, UART_DELAY / 5);
+    status = request_version(session);
+    if (status == BOOTLOADER_OK)
+      break;
+    if (!session->is_machine_mode && !session->rtt_us)
+      continue;
+
+    flasher_session fallback = *session;
+    reset_session(&fallback);
+    flasher_serial_drain(session->fd, UART_DELAY / 5);
+    status = request_version(&fallback);
+    if (status == BOOTLOADER_OK)
+    {
+      reset_session(session);
+      break;
+    }
+  }
+
+  return status;
+}
+
+// The descriptor is taken only with its crc32 and protocol version. Older
+// bootloaders answer cmd 19 with the prompt only.
+bootloader_status flasher_session_get_capabilities(
+  flasher_session *const session
+)
+{
+  uint8_t descriptor[CAPABILITIES_SIZE + sizeof(uint32_t)];
+  uint32_t crc = 0;
+  bootloader_status status = start_command(session, CMD_GET_CAPABILITIES);
+
+  if (status == BOOTLOADER_OK)
+    status |= flasher_serial_read(
+      session->fd,
+      descriptor,
+      sizeof(descriptor),
+      session->ack_timeout
+    );
+  if (status == BOOTLOADER_OK)
+    status |= read_prompt(session);
+  if (status)
+    return status;
+
+  memcpy(&crc, descriptor + CAPABILITIES_SIZE, sizeof(uint32_t));
+  if (crc != bootloader_crc32_update(CRC_INIT, descriptor, CAPABILITIES_SIZE))
+    return BOOTLOADER_CRC_ERROR;
+  if (descriptor[0] != PROTOCOL_VERSION)
+    return BOOTLOADER_ERROR;
+
+  parse_capabilities(&session->capabilities, descriptor);
+  return BOOTLOADER_OK;
+}
+
+// Both sides return to UART_BAUD_RATE when the new rate is not confirmed
+bootloader_status flasher_session_set_baud_rate(
+  flasher_session *const session,
+  const uint32_t baud_rate
+)
+{
+  bootloader_status status = start_command(session, CMD_SET_BAUD_RATE);
+
+  if (status == BOOTLOADER_OK)
+    status |= flasher_serial_write(
+      session->fd,
+      (uint8_t*)&baud_rate,
+      sizeof(uint32_t),
+      session->ack_timeout
+    );
+  if (status == BOOTLOADER_OK)
+    status |= read_response(session, session->ack_timeout);
+  if (status)
+    return status;
+
+  status |= flasher_serial_set_baud_rate(session->fd, baud_rate);
+  // The device switches after its response is transmitted
+  sleep_ms(10);
+  if (status == BOOTLOADER_OK)
+    status |= send_byte(session, SYNC_BYTE);
+  if (status == BOOTLOADER_OK)
+    status |= read_response(session, session->ack_timeout);
+  if (status == BOOTLOADER_OK)
+    status |= read_prompt(session);
+
+  if (status)
+    (void)flasher_serial_set_baud_rate(session->fd, UART_BAUD_RATE);
+
+  return status;
+}
+
+// The device answers with its gaps and the longest ones seen since the
+// previous cmd 16. The round trip of the command byte is measured.
+bootloader_status flasher_session_set_timeouts(
+  flasher_session *const session,
+  const uint16_t frame_gap,
+  const uint16_t byte_gap
+)
+{
+  uint16_t gaps[TIMEOUT_GAPS_NUM] = { frame_gap, byte_gap };
+  uint8_t response[TIMEOUTS_RESPONSE_SIZE];
+  uint32_t crc = 0;
+  int64_t start_time = flasher_serial_get_time_us();
+  bootloader_status status = start_command(session, CMD_SET_TIMEOUTS);
+
+  if (status)
+    return status;
+
+  session->rtt_us = flasher_serial_get_time_us() - start_time;
+  status |= flasher_serial_write(
+    session->fd,
+    (uint8_t*)gaps,
+    sizeof(gaps),
+    session->ack_timeout
+  );
+  if (status == BOOTLOADER_OK)
+    status |= read_response(session, session->ack_timeout);
+  if (status == BOOTLOADER_OK)
+    status |= flasher_serial_read(
+      session->fd,
+      response,
+      TIMEOUTS_RESPONSE_SIZE,
+      session->ack_timeout
+    );
+  memcpy(&crc, response + 8, sizeof(uint32_t));
+  if (
+    status == BOOTLOADER_OK &&
+    crc != bootloader_crc32_update(CRC_INIT, response, 8)
+  )
+    status |= BOOTLOADER_CRC_ERROR;
+  if (status == BOOTLOADER_OK)
+  {
+    memcpy(
+      session->stats.longest_gaps,
+      response + sizeof(gaps),
+      sizeof(gaps)
+    );
+    status |= read_prompt(session);
+  }
+
+  return status;
+}
+
+// The gaps of the device and the answer timeout follow the round trip
+// instead of UART_DELAY. Older bootloaders answer cmd 16 with the prompt
+// only, then UART_DELAY is kept on both sides.
+bootloader_status flasher_session_tune_timeouts(
+  flasher_session *const session
+)
+{
+  bootloader_status status = flasher_session_set_timeouts(session, 0, 0);
+
+  if (status)
+  {
+    session->rtt_us = 0;
+    return flasher_session_connect(session);
+  }
+
+  uint32_t rtt = (session->rtt_us + 999U) / 1000U;
+  uint16_t frame_gap = limit_gap(
+    4U * rtt + 2U * FLASHER_TIMEOUT_MARGIN,
+    UART_MIN_FRAME_GAP
+  );
+  uint16_t byte_gap = limit_gap(
+    2U * rtt + FLASHER_TIMEOUT_MARGIN,
+    UART_MIN_BYTE_GAP
+  );
+
+  status |= flasher_session_set_timeouts(session, frame_gap, byte_gap);
+  if (status == BOOTLOADER_OK)
+  {
+    session->gaps[TIMEOUT_FRAME_GAP] = frame_gap;
+    session->gaps[TIMEOUT_BYTE_GAP] = byte_gap;
+    session->ack_timeout = get_ack_timeout(session);
+  }
+
+  return status;
+}
+
+// The device switches after its answer, so the prompt follows it only in
+// human mode
+bootloader_status flasher_session_set_mode(
+  flasher_session *const session,
+  const uint8_t mode
+)
+{
+  bootloader_status status = start_command(session, CMD_SET_MODE);
+
+  if (status == BOOTLOADER_OK)
+    status |= flasher_serial_write(
+      session->fd,
+      &mode,
+      sizeof(uint8_t),
+      session->ack_timeout
+    );
+  if (status == BOOTLOADER_OK)
+    status |= read_response(session, session->ack_timeout);
+  if (status)
+    return status;
+
+  session->is_machine_mode = mode == MODE_MACHINE;
+  return read_prompt(session);
+}
+
+bootloader_status flasher_session_erase(
+  flasher_session *const session,
+  const uint32_t address,
+  const uint8_t pages_num
+)
+{
+  uint8_t request[5];
+  bootloader_status status = start_command(session, CMD_ERASE);
+
+  memcpy(request, &address, sizeof(uint32_t));
+  request[4] = pages_num;
+  if (status == BOOTLOADER_OK)
+    status |= flasher_serial_write(
+      session->fd,
+      request,
+      sizeof(request),
+      session->ack_timeout
+    );
+  if (status == BOOTLOADER_OK)
+    status |= read_response(
+      session,
+      bootloader_timeout_get_flash(pages_num, 0) + session->ack_timeout
+    );
+  if (status == BOOTLOADER_OK)
+  {
+    session->stats.erased_pages += pages_num;
+    status |= read_prompt(session);
+  }
+
+  return status;
+}
+
+// A failed transfer is retried after the device is back at the prompt
+bootloader_status flasher_session_write(
+  flasher_session *const session,
+  const flasher_image *const image
+)
+{
+  if (
+    session->command == CMD_WRITE_STREAM ||
+    session->command == CMD_WRITE_COMPRESSED
+  )
+    return write_stream(session, image);
+
+  uint32_t *blocks = malloc(
+    FLASHER_FLASH_SIZE / session->options->block_size * sizeof(uint32_t)
+  );
+  uint32_t acked = 0;
+  bootloader_status status = BOOTLOADER_OK;
+
+  if (blocks == NULL)
+    return BOOTLOADER_ERROR;
+
+  uint32_t count = plan_blocks(session, image, blocks);
+  status |= erase_blank_pages(session, image);
+
+  for (uint8_t i = 0; status == BOOTLOADER_OK && count; i++)
+  {
+    status |= session->command == CMD_WRITE_BLOCK ?
+      send_blocks(session, image, blocks, count, &acked) :
+      send_window(session, image, blocks, count, &acked);
+    if (status == BOOTLOADER_OK || i == session->options->max_retries)
+      break;
+
+    uint32_t resume = get_resume_block(blocks, acked);
+    session->stats.retries++;
+    session->stats.bytes -= (acked - resume) * session->options->block_size;
+    acked = resume;
+    status = reconnect(session);
+  }
+
+  free(blocks);
+  return status;
+}
+
+// The range from the first to the last page of the image is compared with
+// the crc32 of the device (over words, as by the CRC unit)
+bootloader_status flasher_session_verify(
+  flasher_session *const session,
+  const flasher_image *const image
+)
+{
+  uint32_t address = get_first_page(image);
+  uint32_t size = get_end_page(image) - address;
+  uint32_t crc = 0;
+  uint32_t expected_crc = bootloader_crc32_update_words(
+    CRC_INIT,
+    (const uint32_t*)flasher_image_at(image, address),
+    size / sizeof(uint32_t)
+  );
+  bootloader_status status = start_command(session, CMD_VERIFY);
+
+  if (status == BOOTLOADER_OK)
+    status |= flasher_serial_write(
+      session->fd,
+      (uint8_t*)&address,
+      sizeof(uint32_t),
+      session->ack_timeout
+    );
+  if (status == BOOTLOADER_OK)
+    status |= flasher_serial_write(
+      session->fd,
+      (uint8_t*)&size,
+      sizeof(uint32_t),
+      session->ack_timeout
+    );
+  if (status == BOOTLOADER_OK)
+    status |= read_response(session, session->ack_timeout);
+  if (status == BOOTLOADER_OK)
+    status |= flasher_serial_read(
+      session->fd,
+      (uint8_t*)&crc,
+      sizeof(uint32_t),
+      session->ack_timeout
+    );
+  if (status == BOOTLOADER_OK)
+    status |= read_prompt(session);
+  if (status == BOOTLOADER_OK && crc != expected_crc)
+    status |= BOOTLOADER_CRC_ERROR;
+
+  return status;
+}
+
+bootloader_status flasher_session_program(
+  flasher_session *const session,
+  const flasher_image *const image
+)
+{
+  const flasher_options *const options = session->options;
+  int64_t start_time = flasher_serial_get_time_ms();
+  bootloader_status status = flasher_session_connect(session);
+
+  // Older bootloaders are taken as built with the same defs
+  if (
+    status == BOOTLOADER_OK &&
+    flasher_session_get_capabilities(session)
+  )
+  {
+    init_capabilities(&session->capabilities);
+    status |= flasher_session_connect(session);
+  }
+  if (status == BOOTLOADER_OK)
+    status |= apply_capabilities(session, image);
+  if (
+    status == BOOTLOADER_OK &&
+    options->baud_rate &&
+    options->baud_rate != UART_BAUD_RATE
+  )
+    status |= flasher_session_set_baud_rate(session, options->baud_rate);
+  if (status == BOOTLOADER_OK && is_supported(session, CMD_SET_TIMEOUTS))
+    status |= flasher_session_tune_timeouts(session);
+  // Older bootloaders answer cmd 18 with the prompt only
+  if (
+    status == BOOTLOADER_OK &&
+    is_supported(session, CMD_SET_MODE) &&
+    flasher_session_set_mode(session, MODE_MACHINE)
+  )
+    status |= flasher_session_connect(session);
+  if (status == BOOTLOADER_OK)
+    status |= flasher_session_write(session, image);
+  if (status == BOOTLOADER_OK && options->verify)
+    status |= flasher_session_verify(session, image);
+  // Prompts and the default gaps are back for commands typed by hand, after
+  // a failure too (the device is connected again once the line is idle)
+  bootloader_status restore_status = BOOTLOADER_OK;
+  if (status && (session->is_machine_mode || session->rtt_us))
+  {
+    flasher_serial_drain(session->fd, WINDOW_IDLE_TIME + UART_DELAY);
+    restore_status |= flasher_session_connect(session);
+  }
+  if (restore_status == BOOTLOADER_OK && session->is_machine_mode)
+    restore_status |= flasher_session_set_mode(session, MODE_HUMAN);
+  if (restore_status == BOOTLOADER_OK && session->rtt_us)
+    restore_status |= flasher_session_set_timeouts(session, 0, 0);
+  if (status == BOOTLOADER_OK)
+    status |= restore_status;
+
+  session->stats.seconds = (flasher_serial_get_time_ms() - start_time) /
+    1000.0;
+  return status;
+}
@@ -0,0 +1,221 @@
+#include "flasher_image.h"
+#include "flasher_pool.h"
+#include "flasher_session.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// Host flasher: writes an application image through the bootloader to
+// one or several devices.
+// Usage: flasher [-b baud rate] [-a address] [-s block size] [-w window]
+// [-r retries] [-j workers] [-c command] [-V] port [port ...] image
+// -a - address of a raw binary (APP_START_ADDRESS by default)
+// -j - devices programmed at once (all by default)
+// -c - write command: 17 (raw stream), 15, 14, 8 (compressed) or 6, the
+// fastest one of the device by default (15 for bootloaders without cmd 19)
+// -V - verify the written range by its crc32
+
+static char *usage = "Usage: %s [-b baud rate] [-a address] [-s block size]"
+  " [-w window] [-r retries] [-j workers] [-c command] [-V]"
+  " port [port ...] image\n";
+
+// Large, so they are not kept on the stack
+static flasher_image image;
+static flasher_device devices[FLASHER_MAX_DEVICES];
+
+// Static functions ----------------------------------------------------------
+
+static bool parse_number(const char *const text, uint32_t *const value)
+{
+  char *end = NULL;
+  unsigned long number = strtoul(text, &end, 0);
+
+  *value = number;
+  return *text && *end == '\0' && number <= UINT32_MAX;
+}
+
+static void print_stats(const flasher_device *const device)
+{
+  const flasher_session *const session = &device->session;
+  const flasher_stats *const stats = &session->stats;
+  const flasher_capabilities *const capabilities = &session->capabilities;
+
+  printf(
+    "%s: %s, %u bytes in %.2f s (%.1f KB/s)\n",
+    device->port,
+    device->status == BOOTLOADER_CRC_ERROR ?
+      "verification failed" :
+      device->status ? "failed" : "done",
+    stats->bytes,
+    stats->seconds,
+    stats->seconds > 0 ? stats->bytes / 1024.0 / stats->seconds : 0
+  );
+  printf(
+    "  frames: %u, window: %u, retransmits: %u, erased pages: %u,"
+    " retries: %u, NACKs: %u, timeouts: %u\n",
+    stats->frames,
+    session->window,
+    stats->retransmits,
+    stats->erased_pages,
+    stats->retries,
+    stats->nacks,
+    stats->timeouts
+  );
+  if (capabilities->is_known)
+  {
+    printf(
+      "  device: protocol %u, bootloader %u.%u, flash %u KB, command %u, ID ",
+      capabilities->protocol_version,
+      capabilities->version[0],
+      capabilities->version[1],
+      capabilities->flash_size,
+      session->command - CMD_HELP
+    );
+    for (uint8_t i = 0; i < UID_SIZE; i++)
+      printf("%02x", capabilities->uid[i]);
+    printf("\n");
+  }
+  if (session->rtt_us)
+    printf(
+      "  round trip: %.1f ms, frame / byte gap: %u / %u ms (longest %u / %u"
+      " ms), answer timeout: %u ms\n",
+      session->rtt_us / 1000.0,
+      session->gaps[TIMEOUT_FRAME_GAP],
+      session->gaps[TIMEOUT_BYTE_GAP],
+      stats->longest_gaps[TIMEOUT_FRAME_GAP],
+      stats->longest_gaps[TIMEOUT_BYTE_GAP],
+      session->ack_timeout
+    );
+}
+
+static void print_total(const uint32_t devices_num, const double seconds)
+{
+  uint64_t bytes = 0;
+  uint32_t failed = 0;
+
+  for (uint32_t i = 0; i < devices_num; i++)
+  {
+    bytes += devices[i].session.stats.bytes;
+    if (devices[i].status)
+      failed++;
+  }
+
+  printf(
+    "Total: %u of %u devices done, %llu bytes in %.2f s (%.1f KB/s)\n",
+    devices_num - failed,
+    devices_num,
+    (unsigned long long)bytes,
+    seconds,
+    seconds > 0 ? bytes / 1024.0 / seconds : 0
+  );
+}
+
+// Implementations -----------------------------------------------------------
+
+int main(int argc, char *argv[])
+{
+  flasher_options options;
+  uint32_t bin_address = APP_START_ADDRESS;
+  uint32_t workers_num = FLASHER_MAX_DEVICES;
+  uint32_t value = 0;
+  bool is_valid = true;
+  int option = 0;
+
+  flasher_options_init(&options);
+  while ((option = getopt(argc, argv, "b:a:s:w:r:j:c:V")) != -1)
+  {
+    bool is_number = optarg && parse_number(optarg, &value);
+
+    switch (option)
+    {
+      case 'b':
+        options.baud_rate = value;
+        break;
+      case 'a':
+        bin_address = value;
+        break;
+      case 's':
+        options.block_size = value <= BLOCK_SIZE ? value : 0;
+        break;
+      case 'w':
+        options.window = value <= UINT8_MAX ? value : UINT8_MAX;
+        break;
+      case 'r':
+        options.max_retries = value <= UINT8_MAX ? value : UINT8_MAX;
+        break;
+      case 'j':
+        workers_num = value;
+        is_number &= value > 0;
+        break;
+      case 'c':
+        options.command = value <= 0xffU - '0' ? value + '0' : UINT8_MAX;
+        break;
+      case 'V':
+        options.verify = true;
+        is_number = true;
+        break;
+      default:
+        is_number = false;
+        break;
+    }
+    is_valid &= is_number;
+  }
+
+  uint32_t devices_num = argc - optind - 1;
+  if (
+    !is_valid ||
+    argc - optind < 2 ||
+    devices_num > FLASHER_MAX_DEVICES ||
+    flasher_options_check(&options)
+  )
+  {
+    fprintf(stderr, usage, argv[0]);
+    fprintf(
+      stderr,
+      "Block size: power of 2 from %u to %u, window: up to %u frames,"
+      " command: 17, 15, 14, 8 or 6, up to %u ports\n",
+      FLASHER_MIN_BLOCK_SIZE,
+      BLOCK_SIZE,
+      flasher_get_window(
+        options.block_size ? options.block_size : FLASHER_MIN_BLOCK_SIZE
+      ),
+      FLASHER_MAX_DEVICES
+    );
+    return EXIT_FAILURE;
+  }
+
+  char *image_path = argv[argc - 1];
+  if (flasher_image_load(&image, image_path, bin_address))
+  {
+    fprintf(stderr, "%s: no image data for the application area\n", image_path);
+    return EXIT_FAILURE;
+  }
+  printf(
+    "%s: 0x%08x - 0x%08x\n",
+    image_path,
+    image.start,
+    image.end
+  );
+
+  // The image is loaded once and only read by the sessions
+  bool is_failed = false;
+  for (uint32_t i = 0; i < devices_num; i++)
+    devices[i].port = argv[optind + i];
+  double seconds = flasher_pool_run(
+    devices,
+    devices_num,
+    workers_num < devices_num ? workers_num : devices_num,
+    &image,
+    &options
+  );
+
+  for (uint32_t i = 0; i < devices_num; i++)
+  {
+    print_stats(devices + i);
+    is_failed |= devices[i].status != BOOTLOADER_OK;
+  }
+  if (devices_num > 1)
+    print_total(devices_num, seconds);
+
+  return is_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
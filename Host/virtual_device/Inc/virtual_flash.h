@@ -0,0 +1,38 @@
+#ifndef VIRTUAL_FLASH_H
+#define VIRTUAL_FLASH_H
+
+#include "bootloader_defs.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// 128 KB flash of STM32F103 with its programming rules: pages are erased to
+// 0xff, a halfword is programmed only if it is erased (or with 0x0000),
+// otherwise the operation stops with PGERR. Operations are done at once,
+// their duration (datasheet typical values) is returned to the caller.
+
+#define VIRTUAL_FLASH_BASE 0x08000000UL
+#define VIRTUAL_FLASH_SIZE (FLASH_PAGES_NUM * BLOCK_SIZE)
+#define VIRTUAL_FLASH_END (VIRTUAL_FLASH_BASE + VIRTUAL_FLASH_SIZE - 1)
+
+enum
+{
+  VIRTUAL_FLASH_ERASE_TIME_US = 20000U, // per page
+  VIRTUAL_FLASH_PROGRAM_TIME_US = 52U // per halfword
+};
+
+void virtual_flash_init(uint8_t *const memory);
+bootloader_status virtual_flash_erase(
+  const uint32_t address,
+  const uint8_t pages_num,
+  uint32_t *const time_us
+);
+bootloader_status virtual_flash_program(
+  const uint32_t address,
+  const uint8_t *const data,
+  const uint16_t size,
+  uint32_t *const time_us
+);
+bool virtual_flash_is_page_erased(const uint32_t address);
+uint8_t *virtual_flash_map(const uint32_t address, const uint32_t size);
+
+#endif
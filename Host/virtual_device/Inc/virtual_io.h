@@ -0,0 +1,11 @@
+#ifndef VIRTUAL_IO_H
+#define VIRTUAL_IO_H
+
+#include <stdbool.h>
+
+// bootloader_io on a pseudo-terminal and the virtual flash. With delays the
+// line rate of the set baud rate (10 bits per byte) and the flash timings
+// are kept, background programming overlaps reception as on the MCU.
+void virtual_io_setup(const int uart_fd, const bool delays);
+
+#endif
@@ -0,0 +1,126 @@
+#include "bootloader_cmd.h"
+#include "virtual_flash.h"
+#include "virtual_io.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <unistd.h>
+
+// Virtual device: the command layer of the bootloader on a pseudo-terminal,
+// flash is kept in a file.
+// Usage: virtual_device [-n] [flash file]
+// -n - no delays (line rate and flash timings)
+
+static char *default_flash_path = "virtual_flash.bin";
+
+// Static functions ----------------------------------------------------------
+
+static uint8_t *open_flash(const char *const path)
+{
+  struct stat flash_stat;
+  int fd = open(path, O_RDWR | O_CREAT, 0644);
+
+  if (fd < 0 || fstat(fd, &flash_stat))
+    return NULL;
+
+  bool is_new = flash_stat.st_size == 0;
+  if (is_new && ftruncate(fd, VIRTUAL_FLASH_SIZE))
+    return NULL;
+  if (!is_new && flash_stat.st_size != VIRTUAL_FLASH_SIZE)
+  {
+    fprintf(
+      stderr,
+      "%s: not a %u byte flash image\n",
+      path,
+      VIRTUAL_FLASH_SIZE
+    );
+    return NULL;
+  }
+
+  uint8_t *memory = mmap(
+    NULL,
+    VIRTUAL_FLASH_SIZE,
+    PROT_READ | PROT_WRITE,
+    MAP_SHARED,
+    fd,
+    0
+  );
+  close(fd);
+  if (memory == MAP_FAILED)
+    return NULL;
+
+  if (is_new)
+    memset(memory, 0xff, VIRTUAL_FLASH_SIZE);
+
+  return memory;
+}
+
+// The slave side stays open, so the master is readable when the host
+// reconnects
+static int open_uart()
+{
+  struct termios settings;
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+
+  if (master < 0 || grantpt(master) || unlockpt(master))
+    return -1;
+
+  char *slave_path = ptsname(master);
+  int slave = slave_path ? open(slave_path, O_RDWR | O_NOCTTY) : -1;
+  if (slave < 0 || tcgetattr(slave, &settings))
+    return -1;
+
+  cfmakeraw(&settings);
+  if (tcsetattr(slave, TCSANOW, &settings))
+    return -1;
+
+  printf("Virtual device: %s\n", slave_path);
+  fflush(stdout);
+
+  return master;
+}
+
+// Implementations -----------------------------------------------------------
+
+int main(int argc, char *argv[])
+{
+  bool delays = true;
+  char *flash_path = default_flash_path;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "-n") == 0)
+      delays = false;
+    else
+      flash_path = argv[i];
+  }
+
+  uint8_t *memory = open_flash(flash_path);
+  if (memory == NULL)
+  {
+    perror(flash_path);
+    return EXIT_FAILURE;
+  }
+  virtual_flash_init(memory);
+
+  int uart = open_uart();
+  if (uart < 0)
+  {
+    perror("pseudo-terminal");
+    return EXIT_FAILURE;
+  }
+  virtual_io_setup(uart, delays);
+
+  (void)bootloader_io_init();
+  (void)bootloader_start_output();
+
+  while (true)
+  {
+    if (bootloader_io_wait_input())
+      (void)bootloader_proccess_input();
+  }
+}
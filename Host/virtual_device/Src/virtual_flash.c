@@ -0,0 +1,103 @@
+#include "virtual_flash.h"
+#include <string.h>
+
+static uint8_t *flash_memory = NULL;
+
+// Static functions ----------------------------------------------------------
+
+static bool is_range_in_flash(const uint32_t address, const uint32_t size)
+{
+  return !(
+    size == 0 ||
+    address < VIRTUAL_FLASH_BASE ||
+    address > VIRTUAL_FLASH_END ||
+    size - 1 > VIRTUAL_FLASH_END - address
+  );
+}
+
+// Implementations -----------------------------------------------------------
+
+void virtual_flash_init(uint8_t *const memory)
+{
+  flash_memory = memory;
+}
+
+bootloader_status virtual_flash_erase(
+  const uint32_t address,
+  const uint8_t pages_num,
+  uint32_t *const time_us
+)
+{
+  *time_us = 0;
+
+  if (
+    (address - VIRTUAL_FLASH_BASE) % BLOCK_SIZE ||
+    !is_range_in_flash(address, pages_num * BLOCK_SIZE)
+  )
+    return BOOTLOADER_BOUNDS_ERROR;
+
+  memset(
+    virtual_flash_map(address, pages_num * BLOCK_SIZE),
+    0xff,
+    pages_num * BLOCK_SIZE
+  );
+  *time_us = pages_num * VIRTUAL_FLASH_ERASE_TIME_US;
+
+  return BOOTLOADER_OK;
+}
+
+bootloader_status virtual_flash_program(
+  const uint32_t address,
+  const uint8_t *const data,
+  const uint16_t size,
+  uint32_t *const time_us
+)
+{
+  *time_us = 0;
+
+  if (
+    address % sizeof(uint16_t) ||
+    size % sizeof(uint16_t) ||
+    !is_range_in_flash(address, size)
+  )
+    return BOOTLOADER_BOUNDS_ERROR;
+
+  uint8_t *const target = virtual_flash_map(address, size);
+
+  for (uint16_t i = 0; i < size; i += sizeof(uint16_t))
+  {
+    uint16_t current = target[i] | (target[i + 1] << 8);
+    uint16_t value = data[i] | (data[i + 1] << 8);
+
+    *time_us += VIRTUAL_FLASH_PROGRAM_TIME_US;
+    // PGERR: the halfword is left as it is
+    if (current != 0xffff && value != 0x0000)
+      return BOOTLOADER_ERROR;
+
+    target[i] = data[i];
+    target[i + 1] = data[i + 1];
+  }
+
+  return BOOTLOADER_OK;
+}
+
+bool virtual_flash_is_page_erased(const uint32_t address)
+{
+  const uint8_t *const page = virtual_flash_map(address, BLOCK_SIZE);
+
+  for (uint16_t i = 0; i < BLOCK_SIZE; i++)
+  {
+    if (page[i] != 0xff)
+      return false;
+  }
+
+  return true;
+}
+
+uint8_t *virtual_flash_map(const uint32_t address, const uint32_t size)
+{
+  if (!is_range_in_flash(address, size))
+    return NULL;
+
+  return flash_memory + (address - VIRTUAL_FLASH_BASE);
+}
@@ -0,0 +1,498 @@
+#include "bootloader_io.h"
+#include "bootloader_crc.h"
+#include "bootloader_timeout.h"
+#include "virtual_io.h"
+#include "virtual_flash.h"
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+enum
+{
+  VIRTUAL_DEV_ID = 0x410U, // medium-density STM32F1
+  VIRTUAL_PCLK2 = 72000000U,
+  VIRTUAL_BITS_PER_BYTE = 10U, // start, 8 data bits, stop
+  VIRTUAL_WAIT_INPUT_MS = 100U
+};
+
+static int uart = -1;
+static bool with_delays = true;
+static uint32_t baud_rate = UART_BAUD_RATE;
+// Time (ns) when the lines and the flash are free
+static uint64_t rx_free_time;
+static uint64_t tx_free_time;
+static uint64_t flash_free_time;
+static bootloader_status program_status = BOOTLOADER_OK;
+static bool flash_session = false;
+
+// Static functions ----------------------------------------------------------
+
+static uint64_t get_time()
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static void sleep_until(const uint64_t time)
+{
+  struct timespec deadline = {
+    .tv_sec = time / 1000000000ULL,
+    .tv_nsec = time % 1000000000ULL
+  };
+
+  if (!with_delays)
+    return;
+
+  while (
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR
+  )
+    continue;
+}
+
+// Moves the free time of a line or the flash by the duration of a transfer
+// or an operation that starts when the previous one ends
+static uint64_t occupy(uint64_t *const free_time, const uint64_t duration)
+{
+  uint64_t now = get_time();
+
+  if (!with_delays)
+    return now;
+
+  if (*free_time < now)
+    *free_time = now;
+  *free_time += duration;
+
+  return *free_time;
+}
+
+static uint64_t get_line_time(const uint32_t size)
+{
+  return (uint64_t)size * VIRTUAL_BITS_PER_BYTE * 1000000000ULL / baud_rate;
+}
+
+// Deadline of the wait for a byte after the previous one (or the start)
+static uint64_t get_gap_deadline(const bootloader_gap gap, const uint64_t time)
+{
+  return time + bootloader_timeout_get(gap) * 1000000ULL;
+}
+
+static void track_gap(const bootloader_gap gap, const uint64_t time)
+{
+  bootloader_timeout_track(gap, (get_time() - time) / 1000000ULL);
+}
+
+static bool is_flash_busy()
+{
+  return with_delays && get_time() < flash_free_time;
+}
+
+// The cmd_9 scratch pages are the only ones below the application
+static bool is_address_in_bounds(const uint32_t address)
+{
+  return !(
+    address < DELTA_SCRATCH_ADDRESS ||
+    address + sizeof(uint16_t) - 1 > VIRTUAL_FLASH_END
+  );
+}
+
+static bool is_range_in_bounds(const uint32_t address, const uint16_t size)
+{
+  return size != 0 &&
+    size % sizeof(uint16_t) == 0 &&
+    is_address_in_bounds(address) &&
+    is_address_in_bounds(address + size - sizeof(uint16_t));
+}
+
+static bool is_page_address(const uint32_t address)
+{
+  return (address - VIRTUAL_FLASH_BASE) % BLOCK_SIZE == 0;
+}
+
+static bootloader_status write_all(
+  const uint8_t *const data,
+  const uint16_t size
+)
+{
+  for (uint16_t offset = 0; offset < size;)
+  {
+    ssize_t written = write(uart, data + offset, size - offset);
+
+    if (written < 0 && errno != EINTR && errno != EAGAIN)
+      return BOOTLOADER_ERROR;
+    if (written > 0)
+      offset += written;
+  }
+
+  return BOOTLOADER_OK;
+}
+
+// Implementations -----------------------------------------------------------
+
+void virtual_io_setup(const int uart_fd, const bool delays)
+{
+  uart = uart_fd;
+  with_delays = delays;
+}
+
+bootloader_status bootloader_io_init()
+{
+  return uart < 0 ? BOOTLOADER_ERROR : BOOTLOADER_OK;
+}
+
+bootloader_status bootloader_io_read(
+  uint8_t *const data,
+  const uint16_t size
+)
+{
+  uint64_t last_time = get_time();
+  bootloader_gap gap = TIMEOUT_FRAME_GAP;
+
+  for (uint16_t offset = 0; offset < size;)
+  {
+    uint64_t deadline = get_gap_deadline(gap, last_time);
+    uint64_t now = get_time();
+    if (now >= deadline)
+      return BOOTLOADER_TIMEOUT;
+
+    struct pollfd uart_poll = { .fd = uart, .events = POLLIN };
+    int ready = poll(&uart_poll, 1, (deadline - now) / 1000000ULL + 1);
+    if (ready <= 0)
+      continue;
+
+    ssize_t received = read(uart, data + offset, size - offset);
+    if (received > 0)
+    {
+      offset += received;
+      track_gap(gap, last_time);
+      last_time = get_time();
+      gap = TIMEOUT_BYTE_GAP;
+    }
+  }
+
+  // The bytes are taken as they would arrive at the line rate
+  sleep_until(occupy(&rx_free_time, get_line_time(size)));
+
+  return BOOTLOADER_OK;
+}
+
+// Bytes are read one by one, so the next frame stays in the port
+bootloader_status bootloader_io_read_frame(
+  uint8_t *const data,
+  const uint16_t max_size,
+  uint16_t *const size
+)
+{
+  uint64_t last_time = get_time();
+  bootloader_gap gap = TIMEOUT_FRAME_GAP;
+  uint32_t received_num = 0;
+  bool is_overflow = false;
+  uint8_t byte = 0;
+
+  *size = 0;
+  while (true)
+  {
+    uint64_t deadline = get_gap_deadline(gap, last_time);
+    uint64_t now = get_time();
+    if (now >= deadline)
+      return BOOTLOADER_TIMEOUT;
+
+    struct pollfd uart_poll = { .fd = uart, .events = POLLIN };
+    int ready = poll(&uart_poll, 1, (deadline - now) / 1000000ULL + 1);
+    if (ready <= 0 || read(uart, &byte, 1) != 1)
+      continue;
+
+    received_num++;
+    track_gap(gap, last_time);
+    last_time = get_time();
+    gap = TIMEOUT_BYTE_GAP;
+    if (byte == FRAME_DELIMITER)
+      break;
+    if (*size < max_size)
+      data[(*size)++] = byte;
+    else
+      is_overflow = true;
+  }
+
+  sleep_until(occupy(&rx_free_time, get_line_time(received_num)));
+
+  return is_overflow ? BOOTLOADER_BOUNDS_ERROR : BOOTLOADER_OK;
+}
+
+bool bootloader_io_wait_input()
+{
+  struct pollfd uart_poll = { .fd = uart, .events = POLLIN };
+
+  return poll(&uart_poll, 1, VIRTUAL_WAIT_INPUT_MS) > 0 &&
+    (uart_poll.revents & POLLIN);
+}
+
+bootloader_status bootloader_io_write(
+  const uint8_t *const data,
+  const uint16_t size
+)
+{
+  bootloader_status status = bootloader_io_write_start(data, size);
+
+  return status | bootloader_io_write_wait();
+}
+
+bootloader_status bootloader_io_write_start(
+  const uint8_t *const data,
+  const uint16_t size
+)
+{
+  bootloader_status status = bootloader_io_write_wait();
+  if (status)
+    return status;
+
+  (void)occupy(&tx_free_time, get_line_time(size));
+
+  return write_all(data, size);
+}
+
+bootloader_status bootloader_io_write_wait()
+{
+  sleep_until(tx_free_time);
+
+  return BOOTLOADER_OK;
+}
+
+bootloader_status bootloader_io_check_baud_rate(const uint32_t baud_rate)
+{
+  // 16x oversampling: BRR = pclk / baud_rate, from 16 to 0xffff
+  if (
+    baud_rate == 0 ||
+    baud_rate > VIRTUAL_PCLK2 / 16 ||
+    VIRTUAL_PCLK2 / baud_rate > 0xffff
+  )
+    return BOOTLOADER_BOUNDS_ERROR;
+
+  uint32_t brr = (VIRTUAL_PCLK2 + baud_rate / 2) / baud_rate;
+  uint32_t actual_baud_rate = VIRTUAL_PCLK2 / brr;
+  uint32_t error = actual_baud_rate > baud_rate ?
+    actual_baud_rate - baud_rate :
+    baud_rate - actual_baud_rate;
+
+  if (error * 50 > baud_rate)
+    return BOOTLOADER_BOUNDS_ERROR;
+
+  return BOOTLOADER_OK;
+}
+
+bootloader_status bootloader_io_set_baud_rate(const uint32_t new_baud_rate)
+{
+  // The last response leaves at the old baud rate
+  (void)bootloader_io_write_wait();
+  baud_rate = new_baud_rate;
+
+  return BOOTLOADER_OK;
+}
+
+uint32_t bootloader_io_get_dev_id()
+{
+  return VIRTUAL_DEV_ID;
+}
+
+uint16_t bootloader_io_get_flash_size()
+{
+  return VIRTUAL_FLASH_SIZE / 1024U;
+}
+
+// The process id tells the virtual devices apart
+void bootloader_io_get_uid(uint8_t *const uid)
+{
+  uint32_t pid = getpid();
+
+  memcpy(uid, "VIRTUALD", UID_SIZE - sizeof(uint32_t));
+  memcpy(uid + UID_SIZE - sizeof(uint32_t), &pid, sizeof(uint32_t));
+}
+
+uint32_t bootloader_io_get_uart_clock()
+{
+  return VIRTUAL_PCLK2;
+}
+
+// Cycles of a 72 MHz core
+uint32_t bootloader_io_get_cycles()
+{
+  return (uint32_t)(get_time() * 72U / 1000U);
+}
+
+uint32_t bootloader_io_get_ticks()
+{
+  return (uint32_t)(get_time() / 1000000ULL);
+}
+
+bootloader_status bootloader_io_flash_begin()
+{
+  if (is_flash_busy())
+    return BOOTLOADER_BUSY;
+
+  flash_session = true;
+  return BOOTLOADER_OK;
+}
+
+bootloader_status bootloader_io_flash_program(
+  const uint32_t address,
+  const uint8_t *const data,
+  const uint16_t size
+)
+{
+  uint32_t time_us = 0;
+  bootloader_status status = BOOTLOADER_OK;
+
+  if (!flash_session)
+    return BOOTLOADER_ERROR;
+
+  if (!is_range_in_bounds(address, size))
+    status = BOOTLOADER_BOUNDS_ERROR;
+  else
+    status = virtual_flash_program(address, data, size, &time_us);
+  sleep_until(occupy(&flash_free_time, time_us * 1000ULL));
+
+  if (status)
+    (void)bootloader_io_flash_end();
+
+  return status;
+}
+
+bootloader_status bootloader_io_flash_end()
+{
+  flash_session = false;
+
+  return BOOTLOADER_OK;
+}
+
+// Programming is done at once, its duration is added to the flash free time,
+// after the erase started before it
+bootloader_status bootloader_io_program_start(
+  const uint32_t address,
+  const uint8_t *const data,
+  const uint16_t size
+)
+{
+  uint32_t time_us = 0;
+
+  if (!is_range_in_bounds(address, size))
+    return BOOTLOADER_BOUNDS_ERROR;
+  if (program_status)
+    return program_status; // the erase has failed
+
+  program_status |= virtual_flash_program(address, data, size, &time_us);
+  (void)occupy(&flash_free_time, time_us * 1000ULL);
+
+  return program_status;
+}
+
+bootloader_status bootloader_io_erase_start(
+  uint32_t address,
+  uint8_t pages_num
+)
+{
+  uint32_t time_us = 0;
+
+  if (
+    pages_num == 0 ||
+    !is_page_address(address) ||
+    !is_address_in_bounds(address) ||
+    !is_address_in_bounds(
+      address + pages_num * BLOCK_SIZE - sizeof(uint16_t)
+    )
+  )
+    return BOOTLOADER_BOUNDS_ERROR;
+  if (is_flash_busy())
+    return BOOTLOADER_BUSY;
+
+  while (pages_num && virtual_flash_is_page_erased(address))
+  {
+    address += BLOCK_SIZE;
+    pages_num--;
+  }
+  if (pages_num == 0)
+    return BOOTLOADER_OK;
+
+  program_status |= virtual_flash_erase(address, pages_num, &time_us);
+  (void)occupy(&flash_free_time, time_us * 1000ULL);
+
+  return program_status;
+}
+
+bootloader_status bootloader_io_program_wait()
+{
+  sleep_until(flash_free_time);
+
+  bootloader_status status = program_status;
+  program_status = BOOTLOADER_OK;
+
+  return status;
+}
+
+bool bootloader_io_flash_irq()
+{
+  return false;
+}
+
+bootloader_status bootloader_io_erase(
+  const uint32_t address,
+  const uint8_t pages_num
+)
+{
+  uint32_t time_us = 0;
+
+  if (!is_address_in_bounds(address) || !is_page_address(address))
+    return BOOTLOADER_BOUNDS_ERROR;
+  if (is_flash_busy())
+    return BOOTLOADER_BUSY;
+
+  bootloader_status status = virtual_flash_erase(address, pages_num, &time_us);
+  sleep_until(occupy(&flash_free_time, time_us * 1000ULL));
+
+  return status;
+}
+
+bootloader_status bootloader_io_read_flash(
+  const uint32_t address,
+  uint8_t *const value
+)
+{
+  const uint8_t *const source = virtual_flash_map(address, sizeof(uint16_t));
+
+  if (source == NULL)
+    return BOOTLOADER_BOUNDS_ERROR;
+
+  *value = *source;
+
+  return BOOTLOADER_OK;
+}
+
+bootloader_status bootloader_io_get_flash_crc(
+  const uint32_t address,
+  const uint32_t size,
+  uint32_t *const crc
+)
+{
+  const uint8_t *const source = virtual_flash_map(address, size);
+
+  if (source == NULL || address % sizeof(uint32_t) || size % sizeof(uint32_t))
+    return BOOTLOADER_BOUNDS_ERROR;
+
+  *crc = bootloader_crc32_update_words(
+    CRC_INIT,
+    (const uint32_t*)source,
+    size / sizeof(uint32_t)
+  );
+
+  return BOOTLOADER_OK;
+}
+
+const uint8_t *bootloader_io_map_flash(
+  const uint32_t address,
+  const uint32_t size
+)
+{
+  return virtual_flash_map(address, size);
+}
@@ -0,0 +1,79 @@
+# File for host tools
+
+CC = gcc
+FLAGS = -std=c99 -D_GNU_SOURCE -g3 -O2 -Wall
+BUILD_DIR = Host/build
+BOOTLOADER = External/bootloader
+VIRTUAL_DEVICE_DIR = Host/virtual_device
+VIRTUAL_DEVICE = $(BUILD_DIR)/virtual_device.out
+FLASHER_DIR = Host/flasher
+FLASHER = $(BUILD_DIR)/flasher.out
+
+C_INCLUDES += \
+-I$(BOOTLOADER)/Inc \
+-I$(VIRTUAL_DEVICE_DIR)/Inc \
+-I$(FLASHER_DIR)/Inc
+
+VIRTUAL_DEVICE_SOURCES += \
+$(BOOTLOADER)/Src/bootloader_cmd.c \
+$(BOOTLOADER)/Src/bootloader_crc.c \
+$(BOOTLOADER)/Src/bootloader_cobs.c \
+$(BOOTLOADER)/Src/bootloader_timeout.c \
+$(BOOTLOADER)/Src/bootloader_lz.c \
+$(BOOTLOADER)/Src/bootloader_delta.c \
+$(VIRTUAL_DEVICE_DIR)/Src/virtual_flash.c \
+$(VIRTUAL_DEVICE_DIR)/Src/virtual_io.c \
+$(VIRTUAL_DEVICE_DIR)/Src/main.c
+
+FLASHER_SOURCES += \
+$(BOOTLOADER)/Src/bootloader_crc.c \
+$(BOOTLOADER)/Src/bootloader_cobs.c \
+$(BOOTLOADER)/Src/bootloader_timeout.c \
+$(BOOTLOADER)/Src/bootloader_lz.c \
+$(FLASHER_DIR)/Src/flasher_image.c \
+$(FLASHER_DIR)/Src/flasher_lz.c \
+$(FLASHER_DIR)/Src/flasher_pool.c \
+$(FLASHER_DIR)/Src/flasher_serial.c \
+$(FLASHER_DIR)/Src/flasher_session.c \
+$(FLASHER_DIR)/Src/main.c
+
+VIRTUAL_DEVICE_OBJECTS = \
+$(addprefix $(BUILD_DIR)/virtual_device/,$(notdir $(VIRTUAL_DEVICE_SOURCES:.c=.o)))
+
+FLASHER_OBJECTS = \
+$(addprefix $(BUILD_DIR)/flasher/,$(notdir $(FLASHER_SOURCES:.c=.o)))
+
+all: $(VIRTUAL_DEVICE) $(FLASHER)
+
+# Both programs have main.c, so the sources are found per directory
+$(BUILD_DIR)/virtual_device/%.o: $(BOOTLOADER)/Src/%.c | $(BUILD_DIR)/virtual_device
+	$(CC) $(FLAGS) -MD $(C_INCLUDES) -c $< -o $@
+
+$(BUILD_DIR)/virtual_device/%.o: $(VIRTUAL_DEVICE_DIR)/Src/%.c | $(BUILD_DIR)/virtual_device
+	$(CC) $(FLAGS) -MD $(C_INCLUDES) -c $< -o $@
+
+$(BUILD_DIR)/flasher/%.o: $(BOOTLOADER)/Src/%.c | $(BUILD_DIR)/flasher
+	$(CC) $(FLAGS) -MD $(C_INCLUDES) -c $< -o $@
+
+$(BUILD_DIR)/flasher/%.o: $(FLASHER_DIR)/Src/%.c | $(BUILD_DIR)/flasher
+	$(CC) $(FLAGS) -MD $(C_INCLUDES) -c $< -o $@
+
+$(VIRTUAL_DEVICE): $(VIRTUAL_DEVICE_OBJECTS)
+	$(CC) $(FLAGS) $(VIRTUAL_DEVICE_OBJECTS) -o $@
+
+$(FLASHER): $(FLASHER_OBJECTS)
+	$(CC) $(FLAGS) $(FLASHER_OBJECTS) -pthread -o $@
+
+$(BUILD_DIR)/virtual_device $(BUILD_DIR)/flasher:
+	mkdir -p $@
+
+.PHONY = virtual_device
+virtual_device: $(VIRTUAL_DEVICE)
+	./$(VIRTUAL_DEVICE)
+
+.PHONY = clean
+clean:
+	rm -rf $(BUILD_DIR)
+
+-include $(VIRTUAL_DEVICE_OBJECTS:.o=.d)
+-include $(FLASHER_OBJECTS:.o=.d)
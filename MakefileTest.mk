@@ -8,6 +8,8 @@ CFLAGS = -DTEST -DUNITY_INCLUDE_CONFIG_H
 TESTS_DIR = Tests
 UNITY_DIR = External/Unity-2.5.2
 BOOTLOADER = External/bootloader
+VIRTUAL_DEVICE_DIR = Host/virtual_device
+FLASHER_DIR = Host/flasher
 
 C_INCLUDES += \
 -I$(BOOTLOADER)/Inc \
@@ -16,16 +18,42 @@ C_INCLUDES += \
 -I$(UNITY_DIR)/extras/memory/src \
 -I$(TESTS_DIR) \
 -I$(TESTS_DIR)/mocks/Inc \
+-I$(VIRTUAL_DEVICE_DIR)/Inc \
+-I$(FLASHER_DIR)/Inc \
 -ICore/Inc \
 
 C_SOURCES += \
 $(BOOTLOADER)/Src/bootloader_cmd.c \
+$(BOOTLOADER)/Src/bootloader_crc.c \
+$(BOOTLOADER)/Src/bootloader_cobs.c \
+$(BOOTLOADER)/Src/bootloader_timeout.c \
+$(BOOTLOADER)/Src/bootloader_lz.c \
+$(BOOTLOADER)/Src/bootloader_delta.c \
+$(VIRTUAL_DEVICE_DIR)/Src/virtual_flash.c \
+$(FLASHER_DIR)/Src/flasher_image.c \
+$(FLASHER_DIR)/Src/flasher_lz.c \
 $(UNITY_DIR)/src/unity.c \
 $(UNITY_DIR)/extras/fixture/src/unity_fixture.c \
 $(UNITY_DIR)/extras/memory/src/unity_memory.c \
 $(TESTS_DIR)/host_tests.c \
 $(TESTS_DIR)/host_tests/bootloader/bootloader_test_runner.c \
 $(TESTS_DIR)/host_tests/bootloader/bootloader_test.c \
+$(TESTS_DIR)/host_tests/bootloader_crc/bootloader_crc_test_runner.c \
+$(TESTS_DIR)/host_tests/bootloader_crc/bootloader_crc_test.c \
+$(TESTS_DIR)/host_tests/bootloader_cobs/bootloader_cobs_test_runner.c \
+$(TESTS_DIR)/host_tests/bootloader_cobs/bootloader_cobs_test.c \
+$(TESTS_DIR)/host_tests/bootloader_timeout/bootloader_timeout_test_runner.c \
+$(TESTS_DIR)/host_tests/bootloader_timeout/bootloader_timeout_test.c \
+$(TESTS_DIR)/host_tests/bootloader_lz/bootloader_lz_test_runner.c \
+$(TESTS_DIR)/host_tests/bootloader_lz/bootloader_lz_test.c \
+$(TESTS_DIR)/host_tests/bootloader_delta/bootloader_delta_test_runner.c \
+$(TESTS_DIR)/host_tests/bootloader_delta/bootloader_delta_test.c \
+$(TESTS_DIR)/host_tests/virtual_flash/virtual_flash_test_runner.c \
+$(TESTS_DIR)/host_tests/virtual_flash/virtual_flash_test.c \
+$(TESTS_DIR)/host_tests/flasher_image/flasher_image_test_runner.c \
+$(TESTS_DIR)/host_tests/flasher_image/flasher_image_test.c \
+$(TESTS_DIR)/host_tests/flasher_lz/flasher_lz_test_runner.c \
+$(TESTS_DIR)/host_tests/flasher_lz/flasher_lz_test.c \
 $(TESTS_DIR)/mocks/Src/mock_bootloader_io.c
 
 OBJECTS = $(addprefix $(BUILD_DIR)/,$(notdir $(C_SOURCES:.c=.o)))
@@ -34,12 +62,15 @@ all: $(TARGET)
 
 vpath %.c $(dir $(C_SOURCES))
 
-$(BUILD_DIR)/%.o: %.c
+$(BUILD_DIR)/%.o: %.c | $(BUILD_DIR)
 	$(CC) $(FLAGS) $(CFLAGS) -MD $(C_INCLUDES) -c $< -o $@
 
 $(TARGET): $(OBJECTS)
 	$(CC) $(FLAGS) $(OBJECTS) -o $(TARGET)
 
+$(BUILD_DIR):
+	mkdir -p $@
+
 .PHONY = start
 start: $(TARGET)
 	./$(TARGET) -v # -v - print tests
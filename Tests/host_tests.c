@@ -7,6 +7,14 @@ void unity_config_put_c(uint8_t a);
 static void run_all_tests()
 {
 	RUN_TEST_GROUP(bootloader);
+	RUN_TEST_GROUP(bootloader_crc);
+	RUN_TEST_GROUP(bootloader_cobs);
+	RUN_TEST_GROUP(bootloader_timeout);
+	RUN_TEST_GROUP(bootloader_lz);
+	RUN_TEST_GROUP(bootloader_delta);
+	RUN_TEST_GROUP(virtual_flash);
+	RUN_TEST_GROUP(flasher_image);
+	RUN_TEST_GROUP(flasher_lz);
 }
 
 int main(int argc, char *argv[])
@@ -1,6 +1,10 @@
 #include "unity_fixture.h"
 #include "bootloader_cmd.h"
 #include "mock_bootloader_io.h"
+#include "bootloader_delta.h"
+#include "bootloader_crc.h"
+#include "bootloader_cobs.h"
+#include "bootloader_timeout.h"
 #include <string.h>
 
 // Defines -------------------------------------------------------------------
@@ -21,6 +25,114 @@ static void check_data(
     TEST_ASSERT_BYTES_EQUAL(expected[i], actual[i]);
 }
 
+// Frame of cmd_14: header (sequence number, address, size), data, crc32
+static void build_window_frame(
+  uint8_t *const frame,
+  const uint16_t seq,
+  const uint32_t address,
+  const uint8_t *const data,
+  const uint16_t size
+)
+{
+  uint32_t crc = 0;
+
+  memcpy(frame, &seq, sizeof(uint16_t));
+  memcpy(frame + 2, &address, sizeof(uint32_t));
+  memcpy(frame + 6, &size, sizeof(uint16_t));
+  memcpy(frame + WINDOW_HEADER_SIZE, data, size);
+  crc = bootloader_crc32_update(CRC_INIT, frame, WINDOW_HEADER_SIZE + size);
+  memcpy(frame + WINDOW_HEADER_SIZE + size, &crc, sizeof(uint32_t));
+}
+
+static void build_window_response(
+  uint8_t *const response,
+  const bootloader_status status,
+  const uint16_t next_seq,
+  const uint32_t received
+)
+{
+  uint32_t crc = 0;
+
+  response[0] = status ? NACK_BYTE : ACK_BYTE;
+  response[1] = status;
+  memcpy(response + 2, &next_seq, sizeof(uint16_t));
+  memcpy(response + 4, &received, sizeof(uint32_t));
+  crc = bootloader_crc32_update(CRC_INIT, response, 8);
+  memcpy(response + 8, &crc, sizeof(uint32_t));
+}
+
+static void expect_window_frame(
+  const uint8_t *const frame,
+  const uint16_t size
+)
+{
+  mock_bootloader_io_expect_read_then_return(frame, WINDOW_HEADER_SIZE);
+  if (size)
+    mock_bootloader_io_expect_read_then_return(
+      frame + WINDOW_HEADER_SIZE,
+      size
+    );
+  mock_bootloader_io_expect_read_then_return(
+    frame + WINDOW_HEADER_SIZE + size,
+    sizeof(uint32_t)
+  );
+}
+
+// Frame of cmd_15: type, sequence number, address, data, crc16 - encoded,
+// without the delimiter. Returns the encoded size.
+static uint16_t build_framed(
+  uint8_t *const frame,
+  const uint8_t type,
+  const uint16_t seq,
+  const uint32_t address,
+  const uint8_t *const data,
+  const uint16_t size
+)
+{
+  uint8_t packet[FRAME_MAX_SIZE];
+  uint16_t packet_size = 3;
+  uint16_t crc = 0;
+
+  packet[0] = type;
+  memcpy(packet + 1, &seq, sizeof(uint16_t));
+  if (type == FRAME_DATA)
+  {
+    memcpy(packet + 3, &address, sizeof(uint32_t));
+    memcpy(packet + FRAME_HEADER_SIZE, data, size);
+    packet_size = FRAME_HEADER_SIZE + size;
+  }
+  crc = bootloader_crc16_update(CRC16_INIT, packet, packet_size);
+  memcpy(packet + packet_size, &crc, sizeof(uint16_t));
+
+  return bootloader_cobs_encode(packet, packet_size + 2, frame);
+}
+
+// Encoded response of cmd_15 with the delimiter. Returns its size.
+static uint16_t build_frame_response(
+  uint8_t *const response,
+  const bootloader_status status,
+  const uint16_t seq,
+  const uint16_t next_seq,
+  const uint32_t received
+)
+{
+  uint8_t packet[FRAME_RESPONSE_SIZE];
+  uint16_t crc = 0;
+  uint16_t size = 0;
+
+  packet[0] = status ? FRAME_NACK : FRAME_ACK;
+  packet[1] = status;
+  memcpy(packet + 2, &seq, sizeof(uint16_t));
+  memcpy(packet + 4, &next_seq, sizeof(uint16_t));
+  memcpy(packet + 6, &received, sizeof(uint32_t));
+  crc = bootloader_crc16_update(CRC16_INIT, packet, 10);
+  memcpy(packet + 10, &crc, sizeof(uint16_t));
+
+  size = bootloader_cobs_encode(packet, FRAME_RESPONSE_SIZE, response);
+  response[size++] = FRAME_DELIMITER;
+  return size;
+}
+
 // Tests ---------------------------------------------------------------------
 
 TEST_GROUP(bootloader);
@@ -62,7 +174,22 @@ TEST(bootloader, output_help_success)
   "Get id of chip - '1';\r\n"
   "Get bootloader version - '2';\r\n"
   "Write to memory (2 bytes) - '3';\r\n"
-  "Erase - '4'.";
+  "Erase - '4';\r\n"
+  "Read pages from flash - '5';\r\n"
+  "Write block to memory (up to 1 page) - '6';\r\n"
+  "Set baud rate - '7';\r\n"
+  "Write compressed data - '8';\r\n"
+  "Write patch to application - '9';\r\n"
+  "Get CRC of application pages - ':';\r\n"
+  "Get CRC of flash range - ';';\r\n"
+  "Read flash range (binary) - '<';\r\n"
+  "Get boot and command cycles - '=';\r\n"
+  "Write blocks with a window - '>';\r\n"
+  "Write blocks in COBS frames - '?';\r\n"
+  "Set timeouts - '@';\r\n"
+  "Write raw stream - 'A';\r\n"
+  "Set mode (0 - human, 1 - machine) - 'B';\r\n"
+  "Get capabilities - 'C'.\r\n";
   static char *input_data = "0";
   char *input_prompt = "\r\n>>";
 
@@ -148,6 +275,7 @@ TEST(bootloader, write_success)
 
   mock_bootloader_io_expect_read_then_return((uint8_t*)input_cmd, 1);
 
+  mock_bootloader_io_expect_flash_begin();
   mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
   for (uint8_t i = 0; i < 4; i++)
   {
@@ -166,6 +294,7 @@ TEST(bootloader, write_success)
     (uint8_t*)&end_seq,
     sizeof(end_seq)
   );
+  mock_bootloader_io_expect_flash_end();
 
   mock_bootloader_io_expect_write(
     (uint8_t*)input_prompt,
@@ -188,6 +317,7 @@ TEST(bootloader, write_bound_error)
 
   mock_bootloader_io_expect_read_then_return((uint8_t*)input_cmd, 1);
 
+  mock_bootloader_io_expect_flash_begin();
   mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
   mock_bootloader_io_expect_read_then_return(
     (uint8_t*)&input_addr,
@@ -199,6 +329,7 @@ TEST(bootloader, write_bound_error)
   );
   mock_bootloader_io_expect_program((uint8_t*)&input_data);
   mock_bootloader_io_expect_write(&nack_byte, sizeof(nack_byte));
+  mock_bootloader_io_expect_flash_end();
 
   mock_bootloader_io_expect_write(
     (uint8_t*)input_prompt,
@@ -227,6 +358,7 @@ TEST(bootloader, write_middle_success)
 
   mock_bootloader_io_expect_read_then_return((uint8_t*)input_cmd, 1);
 
+  mock_bootloader_io_expect_flash_begin();
   mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
   for (uint8_t i = 0; i < 4; i++)
   {
@@ -245,6 +377,7 @@ TEST(bootloader, write_middle_success)
     (uint8_t*)&end_seq,
     sizeof(end_seq)
   );
+  mock_bootloader_io_expect_flash_end();
 
   mock_bootloader_io_expect_write(
     (uint8_t*)input_prompt,
@@ -291,7 +424,7 @@ TEST(bootloader, erase_success)
 TEST(bootloader, erase_start_bound_error)
 {
   static char *input_cmd = "4";
-  static uint32_t input_addr = APP_START_ADDRESS - 1;
+  static uint32_t input_addr = DELTA_SCRATCH_ADDRESS - 1;
   static uint8_t input_page_num = 32;
   static char *input_prompt = "\r\n>>";
   static uint8_t nack_byte = NACK_BYTE;
@@ -353,3 +486,1726 @@ TEST(bootloader, erase_end_bound_error)
 
   TEST_ASSERT_EQUAL(BOOTLOADER_BOUNDS_ERROR, status);
 }
+
+TEST(bootloader, write_block_success)
+{
+  static char *input_cmd = "6";
+  static uint32_t input_addr = APP_START_ADDRESS;
+  static uint16_t input_size = 8;
+  static uint8_t input_data[8] = {
+    0x53, 0xf5, 0x44, 0x33, 0xaa, 0x55, 0x00, 0xff
+  };
+  static uint32_t input_crc = 0x14d42351;
+  static char *input_prompt = "\r\n>>";
+  static uint8_t ack_byte = ACK_BYTE;
+  static uint32_t end_seq = END_SUBSEQUENCE;
+
+  mock_bootloader_io_expect_read_then_return((uint8_t*)input_cmd, 1);
+
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_addr,
+    sizeof(uint32_t)
+  );
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_size,
+    sizeof(uint16_t)
+  );
+  mock_bootloader_io_expect_read_then_return(input_data, input_size);
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_crc,
+    sizeof(uint32_t)
+  );
+  mock_bootloader_io_expect_program_wait();
+  // The block starts a page, which is erased ahead of it
+  mock_bootloader_io_expect_erase_start((uint8_t*)&input_addr, 1);
+  mock_bootloader_io_expect_program_start(input_data, input_size);
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&end_seq,
+    sizeof(end_seq)
+  );
+  mock_bootloader_io_expect_program_wait();
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+
+  mock_bootloader_io_expect_write(
+    (uint8_t*)input_prompt,
+    strlen(input_prompt) + 1
+  );
+
+  bootloader_status status = bootloader_proccess_input();
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_OK, status);
+}
+
+TEST(bootloader, write_block_crc_error)
+{
+  static char *input_cmd = "6";
+  static uint32_t input_addr = APP_START_ADDRESS;
+  static uint16_t input_size = 8;
+  static uint8_t input_data[8] = {
+    0x53, 0xf5, 0x44, 0x33, 0xaa, 0x55, 0x00, 0xfe
+  };
+  static uint32_t input_crc = 0x14d42351;
+  // The next block in flight, its data would erase pages as cmd_4
+  static char *input_in_flight = "4";
+  static char *input_prompt = "\r\n>>";
+  static uint8_t ack_byte = ACK_BYTE;
+  static uint8_t nack_byte = NACK_BYTE;
+
+  mock_bootloader_io_expect_read_then_return((uint8_t*)input_cmd, 1);
+
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_addr,
+    sizeof(uint32_t)
+  );
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_size,
+    sizeof(uint16_t)
+  );
+  mock_bootloader_io_expect_read_then_return(input_data, input_size);
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_crc,
+    sizeof(uint32_t)
+  );
+  mock_bootloader_io_expect_program_wait();
+  mock_bootloader_io_expect_write(&nack_byte, sizeof(nack_byte));
+  mock_bootloader_io_expect_read_then_return((uint8_t*)input_in_flight, 1);
+  mock_bootloader_io_expect_read_timeout();
+
+  mock_bootloader_io_expect_write(
+    (uint8_t*)input_prompt,
+    strlen(input_prompt) + 1
+  );
+
+  bootloader_status status = bootloader_proccess_input();
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_CRC_ERROR, status);
+}
+
+TEST(bootloader, write_block_size_error)
+{
+  static char *input_cmd = "6";
+  static uint32_t input_addr = APP_START_ADDRESS;
+  static uint16_t input_size = BLOCK_SIZE + 2;
+  static char *input_prompt = "\r\n>>";
+  static uint8_t ack_byte = ACK_BYTE;
+  static uint8_t nack_byte = NACK_BYTE;
+
+  mock_bootloader_io_expect_read_then_return((uint8_t*)input_cmd, 1);
+
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_addr,
+    sizeof(uint32_t)
+  );
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_size,
+    sizeof(uint16_t)
+  );
+  mock_bootloader_io_expect_program_wait();
+  mock_bootloader_io_expect_write(&nack_byte, sizeof(nack_byte));
+  mock_bootloader_io_expect_read_timeout();
+
+  mock_bootloader_io_expect_write(
+    (uint8_t*)input_prompt,
+    strlen(input_prompt) + 1
+  );
+
+  bootloader_status status = bootloader_proccess_input();
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_BOUNDS_ERROR, status);
+}
+
+TEST(bootloader, write_block_pipelined_success)
+{
+  static char *input_cmd = "6";
+  static uint32_t input_addr[2] = {
+    APP_START_ADDRESS,
+    APP_START_ADDRESS + 8U
+  };
+  static uint16_t input_size = 8;
+  static uint8_t input_data[2][8] = {
+    { 0x53, 0xf5, 0x44, 0x33, 0xaa, 0x55, 0x00, 0xff },
+    { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08 }
+  };
+  static uint32_t input_crc[2] = { 0x14d42351, 0x736e042a };
+  static char *input_prompt = "\r\n>>";
+  static uint8_t ack_byte = ACK_BYTE;
+  static uint32_t end_seq = END_SUBSEQUENCE;
+
+  mock_bootloader_io_expect_read_then_return((uint8_t*)input_cmd, 1);
+
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  for (uint8_t i = 0; i < 2; i++)
+  {
+    mock_bootloader_io_expect_read_then_return(
+      (uint8_t*)&input_addr[i],
+      sizeof(uint32_t)
+    );
+    mock_bootloader_io_expect_read_then_return(
+      (uint8_t*)&input_size,
+      sizeof(uint16_t)
+    );
+    mock_bootloader_io_expect_read_then_return(input_data[i], input_size);
+    mock_bootloader_io_expect_read_then_return(
+      (uint8_t*)&input_crc[i],
+      sizeof(uint32_t)
+    );
+    // The previous block is finished only after this one is received
+    mock_bootloader_io_expect_program_wait();
+    if (i == 0)
+      mock_bootloader_io_expect_erase_start((uint8_t*)&input_addr[i], 1);
+    mock_bootloader_io_expect_program_start(input_data[i], input_size);
+    mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  }
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&end_seq,
+    sizeof(end_seq)
+  );
+  mock_bootloader_io_expect_program_wait();
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+
+  mock_bootloader_io_expect_write(
+    (uint8_t*)input_prompt,
+    strlen(input_prompt) + 1
+  );
+
+  bootloader_status status = bootloader_proccess_input();
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_OK, status);
+}
+
+TEST(bootloader, set_baud_rate_success)
+{
+  static char *input_cmd = "7";
+  static uint32_t input_baud_rate = 2000000;
+  static uint8_t input_sync = SYNC_BYTE;
+  static char *input_prompt = "\r\n>>";
+  static uint8_t ack_byte = ACK_BYTE;
+
+  mock_bootloader_io_expect_read_then_return((uint8_t*)input_cmd, 1);
+
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_baud_rate,
+    sizeof(uint32_t)
+  );
+  mock_bootloader_io_expect_check_baud_rate((uint8_t*)&input_baud_rate);
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_set_baud_rate((uint8_t*)&input_baud_rate);
+  mock_bootloader_io_expect_read_then_return(&input_sync, 1);
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+
+  mock_bootloader_io_expect_write(
+    (uint8_t*)input_prompt,
+    strlen(input_prompt) + 1
+  );
+
+  bootloader_status status = bootloader_proccess_input();
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_OK, status);
+}
+
+TEST(bootloader, set_baud_rate_sync_error)
+{
+  static char *input_cmd = "7";
+  static uint32_t input_baud_rate = 2000000;
+  static uint32_t default_baud_rate = UART_BAUD_RATE;
+  static uint8_t input_sync = 0x00;
+  static char *input_prompt = "\r\n>>";
+  static uint8_t ack_byte = ACK_BYTE;
+
+  mock_bootloader_io_expect_read_then_return((uint8_t*)input_cmd, 1);
+
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_baud_rate,
+    sizeof(uint32_t)
+  );
+  mock_bootloader_io_expect_check_baud_rate((uint8_t*)&input_baud_rate);
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_set_baud_rate((uint8_t*)&input_baud_rate);
+  mock_bootloader_io_expect_read_then_return(&input_sync, 1);
+  mock_bootloader_io_expect_set_baud_rate((uint8_t*)&default_baud_rate);
+
+  mock_bootloader_io_expect_write(
+    (uint8_t*)input_prompt,
+    strlen(input_prompt) + 1
+  );
+
+  bootloader_status status = bootloader_proccess_input();
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_ERROR, status);
+}
+
+TEST(bootloader, set_baud_rate_bound_error)
+{
+  static char *input_cmd = "7";
+  static uint32_t input_baud_rate = 9000000;
+  static char *input_prompt = "\r\n>>";
+  static uint8_t ack_byte = ACK_BYTE;
+  static uint8_t nack_byte = NACK_BYTE;
+
+  mock_bootloader_io_expect_read_then_return((uint8_t*)input_cmd, 1);
+
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_baud_rate,
+    sizeof(uint32_t)
+  );
+  mock_bootloader_io_expect_check_baud_rate((uint8_t*)&input_baud_rate);
+  mock_bootloader_io_expect_write(&nack_byte, sizeof(nack_byte));
+
+  mock_bootloader_io_expect_write(
+    (uint8_t*)input_prompt,
+    strlen(input_prompt) + 1
+  );
+
+  bootloader_status status = bootloader_proccess_input();
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_BOUNDS_ERROR, status);
+}
+
+TEST(bootloader, write_compressed_success)
+{
+  static char *input_cmd = "8";
+  static uint32_t input_addr = APP_START_ADDRESS;
+  static uint32_t input_raw_size = 16;
+  static uint16_t input_chunk_size = 4;
+  // 1 literal 0xff, then a match of 15 bytes with offset 1
+  static uint8_t input_chunk[4] = { 0x1b, 0xff, 0x01, 0x00 };
+  static uint32_t input_crc = 0x5d6656f4;
+  static uint16_t end_of_stream = 0;
+  static uint8_t expected_data[16] = {
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+  };
+  static char *input_prompt = "\r\n>>";
+  static uint8_t ack_byte = ACK_BYTE;
+
+  mock_bootloader_io_expect_read_then_return((uint8_t*)input_cmd, 1);
+
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_addr,
+    sizeof(uint32_t)
+  );
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_raw_size,
+    sizeof(uint32_t)
+  );
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_chunk_size,
+    sizeof(uint16_t)
+  );
+  mock_bootloader_io_expect_read_then_return(input_chunk, input_chunk_size);
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_crc,
+    sizeof(uint32_t)
+  );
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&end_of_stream,
+    sizeof(uint16_t)
+  );
+  mock_bootloader_io_expect_program_wait();
+  mock_bootloader_io_expect_erase_start((uint8_t*)&input_addr, 1);
+  mock_bootloader_io_expect_program_start(expected_data, input_raw_size);
+  mock_bootloader_io_expect_program_wait();
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+
+  mock_bootloader_io_expect_write(
+    (uint8_t*)input_prompt,
+    strlen(input_prompt) + 1
+  );
+
+  bootloader_status status = bootloader_proccess_input();
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_OK, status);
+}
+
+TEST(bootloader, write_compressed_odd_size_success)
+{
+  static char *input_cmd = "8";
+  static uint32_t input_addr = APP_START_ADDRESS;
+  static uint32_t input_raw_size = 15;
+  static uint16_t input_chunk_size = 4;
+  // 1 literal 0xab, then a match of 14 bytes with offset 1
+  static uint8_t input_chunk[4] = { 0x1a, 0xab, 0x01, 0x00 };
+  static uint32_t input_crc = 0xedc897ef;
+  static uint16_t end_of_stream = 0;
+  // Padded with the erased value up to a halfword
+  static uint8_t expected_data[16] = {
+    0xab, 0xab, 0xab, 0xab, 0xab, 0xab, 0xab, 0xab,
+    0xab, 0xab, 0xab, 0xab, 0xab, 0xab, 0xab, 0xff
+  };
+  static char *input_prompt = "\r\n>>";
+  static uint8_t ack_byte = ACK_BYTE;
+
+  mock_bootloader_io_expect_read_then_return((uint8_t*)input_cmd, 1);
+
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_addr,
+    sizeof(uint32_t)
+  );
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_raw_size,
+    sizeof(uint32_t)
+  );
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_chunk_size,
+    sizeof(uint16_t)
+  );
+  mock_bootloader_io_expect_read_then_return(input_chunk, input_chunk_size);
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_crc,
+    sizeof(uint32_t)
+  );
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&end_of_stream,
+    sizeof(uint16_t)
+  );
+  mock_bootloader_io_expect_program_wait();
+  mock_bootloader_io_expect_erase_start((uint8_t*)&input_addr, 1);
+  mock_bootloader_io_expect_program_start(
+    expected_data,
+    sizeof(expected_data)
+  );
+  mock_bootloader_io_expect_program_wait();
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+
+  mock_bootloader_io_expect_write(
+    (uint8_t*)input_prompt,
+    strlen(input_prompt) + 1
+  );
+
+  bootloader_status status = bootloader_proccess_input();
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_OK, status);
+}
+
+TEST(bootloader, write_compressed_size_error)
+{
+  static char *input_cmd = "8";
+  static uint32_t input_addr = APP_START_ADDRESS;
+  static uint32_t input_raw_size = 8;
+  static uint16_t input_chunk_size = 4;
+  // Decodes to 16 bytes, more than declared
+  static uint8_t input_chunk[4] = { 0x1b, 0xff, 0x01, 0x00 };
+  static uint32_t input_crc = 0x5d6656f4;
+  static uint16_t end_of_stream = 0;
+  static char *input_prompt = "\r\n>>";
+  static uint8_t ack_byte = ACK_BYTE;
+  static uint8_t nack_byte = NACK_BYTE;
+
+  mock_bootloader_io_expect_read_then_return((uint8_t*)input_cmd, 1);
+
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_addr,
+    sizeof(uint32_t)
+  );
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_raw_size,
+    sizeof(uint32_t)
+  );
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_chunk_size,
+    sizeof(uint16_t)
+  );
+  mock_bootloader_io_expect_read_then_return(input_chunk, input_chunk_size);
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_crc,
+    sizeof(uint32_t)
+  );
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&end_of_stream,
+    sizeof(uint16_t)
+  );
+  mock_bootloader_io_expect_program_wait();
+  mock_bootloader_io_expect_write(&nack_byte, sizeof(nack_byte));
+
+  mock_bootloader_io_expect_write(
+    (uint8_t*)input_prompt,
+    strlen(input_prompt) + 1
+  );
+
+  bootloader_status status = bootloader_proccess_input();
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_ERROR, status);
+}
+
+TEST(bootloader, write_delta_success)
+{
+  static char *input_cmd = "9";
+  static uint32_t input_size = 2 * BLOCK_SIZE;
+  static uint32_t input_installed_size = 2 * BLOCK_SIZE;
+  static uint16_t input_first_page = 0;
+  static uint32_t input_installed_crc = 0x45412e64;
+  static uint8_t installed[2 * BLOCK_SIZE];
+  static uint8_t scratch[2 * BLOCK_SIZE];
+  static uint16_t input_chunk_size = 19;
+  // The first page is kept, 2 bytes are inserted at the start of the second
+  static uint8_t input_chunk[19] = {
+    DELTA_OP_COPY, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04,
+    DELTA_OP_INSERT, 0x02, 0x00, 0xab, 0xcd,
+    DELTA_OP_COPY, 0x00, 0x04, 0x00, 0x00, 0xfe, 0x03
+  };
+  static uint32_t input_crc = 0xe260a471;
+  static uint16_t end_of_stream = 0;
+  static uint32_t expected_scratch_addr = DELTA_SCRATCH_ADDRESS + BLOCK_SIZE;
+  static uint8_t expected_saved_data[8] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07
+  };
+  static uint32_t expected_addr = APP_START_ADDRESS + BLOCK_SIZE;
+  static uint8_t expected_data[8] = {
+    0xab, 0xcd, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05
+  };
+  static char *input_prompt = "\r\n>>";
+  static uint8_t ack_byte = ACK_BYTE;
+
+  for (uint16_t i = 0; i < sizeof(installed); i++)
+    installed[i] = (uint8_t)i;
+
+  mock_bootloader_io_expect_read_then_return((uint8_t*)input_cmd, 1);
+
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_size,
+    sizeof(uint32_t)
+  );
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_installed_size,
+    sizeof(uint32_t)
+  );
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_first_page,
+    sizeof(uint16_t)
+  );
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_installed_crc,
+    sizeof(uint32_t)
+  );
+  mock_bootloader_io_expect_map_flash_then_return(installed);
+  mock_bootloader_io_expect_map_flash_then_return(scratch);
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_chunk_size,
+    sizeof(uint16_t)
+  );
+  mock_bootloader_io_expect_read_then_return(input_chunk, input_chunk_size);
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_crc,
+    sizeof(uint32_t)
+  );
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  // The first page is unchanged
+  mock_bootloader_io_expect_program_wait();
+  mock_bootloader_io_expect_program_wait();
+  // The installed second page is saved before it is erased
+  mock_bootloader_io_expect_erase_start((uint8_t*)&expected_scratch_addr, 1);
+  mock_bootloader_io_expect_program_start(
+    expected_saved_data,
+    sizeof(expected_saved_data)
+  );
+  mock_bootloader_io_expect_program_wait();
+  mock_bootloader_io_expect_erase_start((uint8_t*)&expected_addr, 1);
+  mock_bootloader_io_expect_program_start(
+    expected_data,
+    sizeof(expected_data)
+  );
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&end_of_stream,
+    sizeof(uint16_t)
+  );
+  mock_bootloader_io_expect_program_wait();
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+
+  mock_bootloader_io_expect_write(
+    (uint8_t*)input_prompt,
+    strlen(input_prompt) + 1
+  );
+
+  bootloader_status status = bootloader_proccess_input();
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_OK, status);
+}
+
+TEST(bootloader, write_delta_installed_crc_error)
+{
+  static char *input_cmd = "9";
+  static uint32_t input_size = 2 * BLOCK_SIZE;
+  static uint32_t input_installed_size = 2 * BLOCK_SIZE;
+  static uint16_t input_first_page = 0;
+  static uint32_t input_installed_crc = 0x45412e65;
+  static uint8_t installed[2 * BLOCK_SIZE];
+  static uint8_t scratch[2 * BLOCK_SIZE];
+  static char *input_prompt = "\r\n>>";
+  static uint8_t ack_byte = ACK_BYTE;
+  static uint8_t nack_byte = NACK_BYTE;
+
+  for (uint16_t i = 0; i < sizeof(installed); i++)
+    installed[i] = (uint8_t)i;
+
+  mock_bootloader_io_expect_read_then_return((uint8_t*)input_cmd, 1);
+
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_size,
+    sizeof(uint32_t)
+  );
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_installed_size,
+    sizeof(uint32_t)
+  );
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_first_page,
+    sizeof(uint16_t)
+  );
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_installed_crc,
+    sizeof(uint32_t)
+  );
+  mock_bootloader_io_expect_map_flash_then_return(installed);
+  mock_bootloader_io_expect_map_flash_then_return(scratch);
+  mock_bootloader_io_expect_write(&nack_byte, sizeof(nack_byte));
+
+  mock_bootloader_io_expect_write(
+    (uint8_t*)input_prompt,
+    strlen(input_prompt) + 1
+  );
+
+  bootloader_status status = bootloader_proccess_input();
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_CRC_ERROR, status);
+}
+
+// The link was lost after the second page had been erased
+TEST(bootloader, write_delta_resume_success)
+{
+  static char *input_cmd = "9";
+  static uint32_t input_size = 2 * BLOCK_SIZE;
+  static uint32_t input_installed_size = 2 * BLOCK_SIZE;
+  static uint16_t input_first_page = 1;
+  static uint32_t input_installed_crc = 0x45412e64;
+  static uint8_t installed[2 * BLOCK_SIZE];
+  static uint8_t scratch[2 * BLOCK_SIZE];
+  static uint16_t input_chunk_size = 19;
+  // The first page is kept, 2 bytes are inserted before a copy of it
+  static uint8_t input_chunk[19] = {
+    DELTA_OP_COPY, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04,
+    DELTA_OP_INSERT, 0x02, 0x00, 0xab, 0xcd,
+    DELTA_OP_COPY, 0x00, 0x00, 0x00, 0x00, 0xfe, 0x03
+  };
+  static uint32_t input_crc = 0xc29427f2;
+  static uint16_t end_of_stream = 0;
+  static uint32_t expected_addr = APP_START_ADDRESS + BLOCK_SIZE;
+  static uint8_t expected_restored_data[8] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07
+  };
+  static uint8_t expected_data[8] = {
+    0xab, 0xcd, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05
+  };
+  static char *input_prompt = "\r\n>>";
+  static uint8_t ack_byte = ACK_BYTE;
+
+  for (uint16_t i = 0; i < BLOCK_SIZE; i++)
+  {
+    installed[i] = (uint8_t)i;
+    installed[BLOCK_SIZE + i] = 0xff;
+    scratch[BLOCK_SIZE + i] = (uint8_t)i;
+  }
+
+  mock_bootloader_io_expect_read_then_return((uint8_t*)input_cmd, 1);
+
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_size,
+    sizeof(uint32_t)
+  );
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_installed_size,
+    sizeof(uint32_t)
+  );
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_first_page,
+    sizeof(uint16_t)
+  );
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_installed_crc,
+    sizeof(uint32_t)
+  );
+  mock_bootloader_io_expect_map_flash_then_return(installed);
+  mock_bootloader_io_expect_map_flash_then_return(scratch);
+  // The second page is put back from the scratch page
+  mock_bootloader_io_expect_erase_start((uint8_t*)&expected_addr, 1);
+  mock_bootloader_io_expect_program_start(
+    expected_restored_data,
+    sizeof(expected_restored_data)
+  );
+  mock_bootloader_io_expect_program_wait();
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_chunk_size,
+    sizeof(uint16_t)
+  );
+  mock_bootloader_io_expect_read_then_return(input_chunk, input_chunk_size);
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_crc,
+    sizeof(uint32_t)
+  );
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  // The first page is rebuilt already, the second one is saved already
+  mock_bootloader_io_expect_program_wait();
+  mock_bootloader_io_expect_erase_start((uint8_t*)&expected_addr, 1);
+  mock_bootloader_io_expect_program_start(
+    expected_data,
+    sizeof(expected_data)
+  );
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&end_of_stream,
+    sizeof(uint16_t)
+  );
+  mock_bootloader_io_expect_program_wait();
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+
+  mock_bootloader_io_expect_write(
+    (uint8_t*)input_prompt,
+    strlen(input_prompt) + 1
+  );
+
+  bootloader_status status = bootloader_proccess_input();
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_OK, status);
+}
+
+TEST(bootloader, get_pages_crc_success)
+{
+  static char *input_cmd = ":";
+  static uint32_t page_crc = 0x12345678;
+  static uint8_t expected_response[2 + APP_PAGES_NUM * 4 + 4];
+  static char *input_prompt = "\r\n>>";
+  static uint8_t ack_byte = ACK_BYTE;
+
+  expected_response[0] = APP_START_PAGE;
+  expected_response[1] = APP_PAGES_NUM;
+  for (uint8_t i = 0; i < APP_PAGES_NUM; i++)
+    memcpy(expected_response + 2 + i * 4, &page_crc, sizeof(uint32_t));
+  uint32_t response_crc = bootloader_crc32_update(
+    CRC_INIT,
+    expected_response,
+    sizeof(expected_response) - 4
+  );
+  memcpy(
+    expected_response + sizeof(expected_response) - 4,
+    &response_crc,
+    sizeof(uint32_t)
+  );
+
+  mock_bootloader_io_create(APP_PAGES_NUM + 6);
+  mock_bootloader_io_expect_read_then_return((uint8_t*)input_cmd, 1);
+  mock_bootloader_io_expect_get_flash_size_then_return();
+
+  for (uint8_t i = 0; i < APP_PAGES_NUM; i++)
+    mock_bootloader_io_expect_get_flash_crc_then_return((uint8_t*)&page_crc);
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_write(
+    expected_response,
+    sizeof(expected_response)
+  );
+
+  mock_bootloader_io_expect_write(
+    (uint8_t*)input_prompt,
+    strlen(input_prompt) + 1
+  );
+
+  bootloader_status status = bootloader_proccess_input();
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_OK, status);
+}
+
+TEST(bootloader, verify_success)
+{
+  static char *input_cmd = ";";
+  static uint32_t input_addr = APP_START_ADDRESS;
+  static uint32_t input_size = 54 * BLOCK_SIZE;
+  static uint32_t range_crc = 0x89abcdef;
+  static char *input_prompt = "\r\n>>";
+  static uint8_t ack_byte = ACK_BYTE;
+
+  mock_bootloader_io_expect_read_then_return((uint8_t*)input_cmd, 1);
+
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_addr,
+    sizeof(uint32_t)
+  );
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_size,
+    sizeof(uint32_t)
+  );
+  mock_bootloader_io_expect_get_flash_crc_then_return((uint8_t*)&range_crc);
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_write((uint8_t*)&range_crc, sizeof(uint32_t));
+
+  mock_bootloader_io_expect_write(
+    (uint8_t*)input_prompt,
+    strlen(input_prompt) + 1
+  );
+
+  bootloader_status status = bootloader_proccess_input();
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_OK, status);
+}
+
+TEST(bootloader, verify_size_error)
+{
+  static char *input_cmd = ";";
+  static uint32_t input_addr = APP_START_ADDRESS;
+  static uint32_t input_size = 6;
+  static uint32_t range_crc = 0x89abcdef;
+  static char *input_prompt = "\r\n>>";
+  static uint8_t ack_byte = ACK_BYTE;
+  static uint8_t nack_byte = NACK_BYTE;
+
+  mock_bootloader_io_expect_read_then_return((uint8_t*)input_cmd, 1);
+
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_addr,
+    sizeof(uint32_t)
+  );
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_size,
+    sizeof(uint32_t)
+  );
+  mock_bootloader_io_expect_get_flash_crc_then_return((uint8_t*)&range_crc);
+  mock_bootloader_io_expect_write(&nack_byte, sizeof(nack_byte));
+
+  mock_bootloader_io_expect_write(
+    (uint8_t*)input_prompt,
+    strlen(input_prompt) + 1
+  );
+
+  bootloader_status status = bootloader_proccess_input();
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_BOUNDS_ERROR, status);
+}
+
+TEST(bootloader, read_binary_success)
+{
+  static char *input_cmd = "<";
+  static uint32_t input_addr = APP_START_ADDRESS;
+  static uint32_t input_size = TX_CHUNK_SIZE + 8;
+  static uint8_t flash[TX_CHUNK_SIZE + 8];
+  static uint32_t range_crc = 0x89abcdef;
+  static char *input_prompt = "\r\n>>";
+  static uint8_t ack_byte = ACK_BYTE;
+
+  for (uint32_t i = 0; i < sizeof(flash); i++)
+    flash[i] = (uint8_t)i;
+
+  mock_bootloader_io_expect_read_then_return((uint8_t*)input_cmd, 1);
+
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_addr,
+    sizeof(uint32_t)
+  );
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_size,
+    sizeof(uint32_t)
+  );
+  mock_bootloader_io_expect_get_flash_crc_then_return((uint8_t*)&range_crc);
+  mock_bootloader_io_expect_map_flash_then_return(flash);
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  // Split into DMA transmissions
+  mock_bootloader_io_expect_write_start(flash, TX_CHUNK_SIZE);
+  mock_bootloader_io_expect_write_start(flash + TX_CHUNK_SIZE, 8);
+  mock_bootloader_io_expect_write_wait();
+  mock_bootloader_io_expect_write((uint8_t*)&range_crc, sizeof(uint32_t));
+
+  mock_bootloader_io_expect_write(
+    (uint8_t*)input_prompt,
+    strlen(input_prompt) + 1
+  );
+
+  bootloader_status status = bootloader_proccess_input();
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_OK, status);
+}
+
+TEST(bootloader, read_binary_bound_error)
+{
+  static char *input_cmd = "<";
+  static uint32_t input_addr = 0x08000000 + 0x400 * 127;
+  static uint32_t input_size = 2 * BLOCK_SIZE;
+  static uint32_t range_crc = 0x89abcdef;
+  static char *input_prompt = "\r\n>>";
+  static uint8_t ack_byte = ACK_BYTE;
+  static uint8_t nack_byte = NACK_BYTE;
+
+  mock_bootloader_io_expect_read_then_return((uint8_t*)input_cmd, 1);
+
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_addr,
+    sizeof(uint32_t)
+  );
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_size,
+    sizeof(uint32_t)
+  );
+  mock_bootloader_io_expect_get_flash_crc_then_return((uint8_t*)&range_crc);
+  mock_bootloader_io_expect_write(&nack_byte, sizeof(nack_byte));
+
+  mock_bootloader_io_expect_write(
+    (uint8_t*)input_prompt,
+    strlen(input_prompt) + 1
+  );
+
+  bootloader_status status = bootloader_proccess_input();
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_BOUNDS_ERROR, status);
+}
+
+TEST(bootloader, get_stats_success)
+{
+  static char *version_cmd = "2";
+  static char *id_cmd = "1";
+  static char *input_cmd = "=";
+  static char *bootloader_version_message = "\r\nBootloader version: ";
+  static char *version_message = "0.1";
+  static char *id_message = "\r\nChip ID: ";
+  static char *id_num_message = "1034";
+  static uint8_t expected_response[
+    2 + BOOT_STAGES_NUM * 4 + COMMANDS_NUM * 8 + 4
+  ];
+  static char *input_prompt = "\r\n>>";
+  static uint8_t ack_byte = ACK_BYTE;
+  // Cycles of each read: the boot stages, then the start and the end of
+  // cmd_2 and cmd_1. The counters of cmd_13 are recorded after its answer.
+  uint32_t stages[BOOT_STAGES_NUM] = { 1000, 1010, 1020, 1030, 1040 };
+  uint32_t command[2] = { 1, 10 }; // calls, cycles of the last call
+  uint32_t crc = 0;
+  uint16_t size = 0;
+
+  expected_response[size++] = BOOT_STAGES_NUM;
+  memcpy(expected_response + size, stages, sizeof(stages));
+  size += sizeof(stages);
+  expected_response[size++] = COMMANDS_NUM;
+  memcpy(expected_response + size + 1 * 8, command, sizeof(command));
+  memcpy(expected_response + size + 2 * 8, command, sizeof(command));
+  size += COMMANDS_NUM * 8;
+  crc = bootloader_crc32_update(CRC_INIT, expected_response, size);
+  memcpy(expected_response + size, &crc, sizeof(uint32_t));
+
+  mock_bootloader_io_set_cycles(1000, 10);
+  for (uint8_t i = 0; i < BOOT_STAGE_FIRST_COMMAND; i++)
+    bootloader_mark_boot_stage(i);
+
+  mock_bootloader_io_expect_read_then_return((uint8_t*)version_cmd, 1);
+  mock_bootloader_io_expect_write(
+    (uint8_t*)bootloader_version_message,
+    strlen(bootloader_version_message) + 1
+  );
+  mock_bootloader_io_expect_write((uint8_t*)version_message, 3);
+  mock_bootloader_io_expect_write(
+    (uint8_t*)input_prompt,
+    strlen(input_prompt) + 1
+  );
+  mock_bootloader_io_expect_read_then_return((uint8_t*)id_cmd, 1);
+  mock_bootloader_io_expect_write(
+    (uint8_t*)id_message,
+    strlen(id_message) + 1
+  );
+  mock_bootloader_io_expect_get_id_then_return();
+  mock_bootloader_io_expect_write(
+    (uint8_t*)id_num_message,
+    strlen(id_num_message) + 1
+  );
+  mock_bootloader_io_expect_write(
+    (uint8_t*)input_prompt,
+    strlen(input_prompt) + 1
+  );
+  mock_bootloader_io_expect_read_then_return((uint8_t*)input_cmd, 1);
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_write(
+    expected_response,
+    sizeof(expected_response)
+  );
+
+  mock_bootloader_io_expect_write(
+    (uint8_t*)input_prompt,
+    strlen(input_prompt) + 1
+  );
+
+  bootloader_status status = bootloader_proccess_input();
+  status |= bootloader_proccess_input();
+  status |= bootloader_proccess_input();
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_OK, status);
+}
+
+TEST(bootloader, write_window_success)
+{
+  static char *input_cmd = ">";
+  static uint32_t page_addr = APP_START_ADDRESS;
+  static uint8_t input_data[2][8] = {
+    { 0x53, 0xf5, 0x44, 0x33, 0xaa, 0x55, 0x00, 0xff },
+    { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08 }
+  };
+  static uint8_t input_frames[3][WINDOW_HEADER_SIZE + 8 + 4];
+  static uint8_t expected_responses[3][WINDOW_RESPONSE_SIZE];
+  static char *input_prompt = "\r\n>>";
+  static uint8_t ack_byte = ACK_BYTE;
+
+  // The second frame comes first: the page is erased ahead of it
+  build_window_frame(
+    input_frames[0],
+    1,
+    APP_START_ADDRESS + 8,
+    input_data[1],
+    8
+  );
+  build_window_frame(input_frames[1], 0, APP_START_ADDRESS, input_data[0], 8);
+  build_window_frame(input_frames[2], 2, END_SUBSEQUENCE, NULL, 0);
+  build_window_response(expected_responses[0], BOOTLOADER_OK, 0, 0x01);
+  build_window_response(expected_responses[1], BOOTLOADER_OK, 2, 0x00);
+  build_window_response(expected_responses[2], BOOTLOADER_OK, 2, 0x00);
+
+  mock_bootloader_io_expect_read_then_return((uint8_t*)input_cmd, 1);
+
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  expect_window_frame(input_frames[0], 8);
+  mock_bootloader_io_expect_program_wait();
+  mock_bootloader_io_expect_erase_start((uint8_t*)&page_addr, 1);
+  mock_bootloader_io_expect_program_start(input_data[1], 8);
+  mock_bootloader_io_expect_write(
+    expected_responses[0],
+    WINDOW_RESPONSE_SIZE
+  );
+  expect_window_frame(input_frames[1], 8);
+  mock_bootloader_io_expect_program_wait();
+  mock_bootloader_io_expect_program_start(input_data[0], 8);
+  mock_bootloader_io_expect_write(
+    expected_responses[1],
+    WINDOW_RESPONSE_SIZE
+  );
+  expect_window_frame(input_frames[2], 0);
+  mock_bootloader_io_expect_program_wait();
+  mock_bootloader_io_expect_write(
+    expected_responses[2],
+    WINDOW_RESPONSE_SIZE
+  );
+
+  mock_bootloader_io_expect_write(
+    (uint8_t*)input_prompt,
+    strlen(input_prompt) + 1
+  );
+
+  bootloader_status status = bootloader_proccess_input();
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_OK, status);
+}
+
+TEST(bootloader, write_window_retransmit_success)
+{
+  static char *input_cmd = ">";
+  static uint32_t page_addr = APP_START_ADDRESS;
+  static uint8_t input_data[2][8] = {
+    { 0x53, 0xf5, 0x44, 0x33, 0xaa, 0x55, 0x00, 0xff },
+    { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08 }
+  };
+  static uint8_t input_frames[4][WINDOW_HEADER_SIZE + 8 + 4];
+  static uint8_t expected_responses[4][WINDOW_RESPONSE_SIZE];
+  static char *input_prompt = "\r\n>>";
+  static uint8_t ack_byte = ACK_BYTE;
+
+  build_window_frame(input_frames[0], 0, APP_START_ADDRESS, input_data[0], 8);
+  build_window_frame(
+    input_frames[1],
+    1,
+    APP_START_ADDRESS + 8,
+    input_data[1],
+    8
+  );
+  memcpy(input_frames[2], input_frames[1], sizeof(input_frames[1]));
+  input_frames[2][WINDOW_HEADER_SIZE] ^= 0x01; // corrupted
+  build_window_frame(input_frames[3], 2, END_SUBSEQUENCE, NULL, 0);
+  build_window_response(expected_responses[0], BOOTLOADER_OK, 1, 0x00);
+  build_window_response(expected_responses[1], BOOTLOADER_CRC_ERROR, 1, 0x00);
+  build_window_response(expected_responses[2], BOOTLOADER_OK, 2, 0x00);
+
+  mock_bootloader_io_expect_read_then_return((uint8_t*)input_cmd, 1);
+
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  expect_window_frame(input_frames[0], 8);
+  mock_bootloader_io_expect_program_wait();
+  mock_bootloader_io_expect_erase_start((uint8_t*)&page_addr, 1);
+  mock_bootloader_io_expect_program_start(input_data[0], 8);
+  mock_bootloader_io_expect_write(
+    expected_responses[0],
+    WINDOW_RESPONSE_SIZE
+  );
+  // The corrupted frame is sent again, the repeated one is only answered
+  expect_window_frame(input_frames[2], 8);
+  mock_bootloader_io_expect_write(
+    expected_responses[1],
+    WINDOW_RESPONSE_SIZE
+  );
+  expect_window_frame(input_frames[1], 8);
+  mock_bootloader_io_expect_program_wait();
+  mock_bootloader_io_expect_program_start(input_data[1], 8);
+  mock_bootloader_io_expect_write(
+    expected_responses[2],
+    WINDOW_RESPONSE_SIZE
+  );
+  expect_window_frame(input_frames[0], 8);
+  mock_bootloader_io_expect_write(
+    expected_responses[2],
+    WINDOW_RESPONSE_SIZE
+  );
+  expect_window_frame(input_frames[3], 0);
+  mock_bootloader_io_expect_program_wait();
+  mock_bootloader_io_expect_write(
+    expected_responses[2],
+    WINDOW_RESPONSE_SIZE
+  );
+
+  mock_bootloader_io_expect_write(
+    (uint8_t*)input_prompt,
+    strlen(input_prompt) + 1
+  );
+
+  bootloader_status status = bootloader_proccess_input();
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_OK, status);
+}
+
+// Frames beyond the window would overrun the receive ring
+TEST(bootloader, write_window_beyond_limit_error)
+{
+  static char *input_cmd = ">";
+  static uint8_t input_data[8] = {
+    0x53, 0xf5, 0x44, 0x33, 0xaa, 0x55, 0x00, 0xff
+  };
+  static uint8_t input_frames[2][WINDOW_HEADER_SIZE + 8 + 4];
+  static uint8_t expected_responses[2][WINDOW_RESPONSE_SIZE];
+  static char *input_prompt = "\r\n>>";
+  static uint8_t ack_byte = ACK_BYTE;
+
+  build_window_frame(
+    input_frames[0],
+    WINDOW_FRAMES_LIMIT + 1,
+    APP_START_ADDRESS,
+    input_data,
+    8
+  );
+  build_window_frame(input_frames[1], 0, END_SUBSEQUENCE, NULL, 0);
+  build_window_response(
+    expected_responses[0],
+    BOOTLOADER_BOUNDS_ERROR,
+    0,
+    0x00
+  );
+  build_window_response(expected_responses[1], BOOTLOADER_OK, 0, 0x00);
+
+  mock_bootloader_io_expect_read_then_return((uint8_t*)input_cmd, 1);
+
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_read_then_return(
+    input_frames[0],
+    WINDOW_HEADER_SIZE
+  );
+  mock_bootloader_io_expect_read_timeout();
+  mock_bootloader_io_expect_write(
+    expected_responses[0],
+    WINDOW_RESPONSE_SIZE
+  );
+  expect_window_frame(input_frames[1], 0);
+  mock_bootloader_io_expect_program_wait();
+  mock_bootloader_io_expect_write(
+    expected_responses[1],
+    WINDOW_RESPONSE_SIZE
+  );
+
+  mock_bootloader_io_expect_write(
+    (uint8_t*)input_prompt,
+    strlen(input_prompt) + 1
+  );
+
+  bootloader_status status = bootloader_proccess_input();
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_OK, status);
+}
+
+TEST(bootloader, write_framed_success)
+{
+  static char *input_cmd = "?";
+  static uint32_t page_addr = APP_START_ADDRESS;
+  static uint8_t input_data[2][8] = {
+    { 0x53, 0xf5, 0x44, 0x33, 0xaa, 0x55, 0x00, 0xff },
+    { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08 }
+  };
+  static uint8_t input_frames[3][FRAME_BUFFER_SIZE];
+  static uint16_t input_sizes[3];
+  static uint8_t expected_responses[3][FRAME_RESPONSE_SIZE + 2];
+  static uint16_t expected_sizes[3];
+  static char *input_prompt = "\r\n>>";
+  static uint8_t ack_byte = ACK_BYTE;
+
+  input_sizes[0] = build_framed(
+    input_frames[0],
+    FRAME_DATA,
+    0,
+    APP_START_ADDRESS,
+    input_data[0],
+    8
+  );
+  input_sizes[1] = build_framed(
+    input_frames[1],
+    FRAME_DATA,
+    1,
+    APP_START_ADDRESS + 8,
+    input_data[1],
+    8
+  );
+  input_sizes[2] = build_framed(input_frames[2], FRAME_END, 2, 0, NULL, 0);
+  expected_sizes[0] = build_frame_response(
+    expected_responses[0],
+    BOOTLOADER_OK,
+    0,
+    1,
+    0x00
+  );
+  expected_sizes[1] = build_frame_response(
+    expected_responses[1],
+    BOOTLOADER_OK,
+    1,
+    2,
+    0x00
+  );
+  expected_sizes[2] = build_frame_response(
+    expected_responses[2],
+    BOOTLOADER_OK,
+    2,
+    2,
+    0x00
+  );
+
+  mock_bootloader_io_expect_read_then_return((uint8_t*)input_cmd, 1);
+
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  // The delimiter ahead of a frame gives an empty one
+  mock_bootloader_io_expect_read_frame_then_return((uint8_t*)"", 0);
+  mock_bootloader_io_expect_read_frame_then_return(
+    input_frames[0],
+    input_sizes[0]
+  );
+  mock_bootloader_io_expect_program_wait();
+  mock_bootloader_io_expect_erase_start((uint8_t*)&page_addr, 1);
+  mock_bootloader_io_expect_program_start(input_data[0], 8);
+  mock_bootloader_io_expect_write(expected_responses[0], expected_sizes[0]);
+  mock_bootloader_io_expect_read_frame_then_return(
+    input_frames[1],
+    input_sizes[1]
+  );
+  mock_bootloader_io_expect_program_wait();
+  mock_bootloader_io_expect_program_start(input_data[1], 8);
+  mock_bootloader_io_expect_write(expected_responses[1], expected_sizes[1]);
+  mock_bootloader_io_expect_read_frame_then_return(
+    input_frames[2],
+    input_sizes[2]
+  );
+  mock_bootloader_io_expect_program_wait();
+  mock_bootloader_io_expect_write(expected_responses[2], expected_sizes[2]);
+
+  mock_bootloader_io_expect_write(
+    (uint8_t*)input_prompt,
+    strlen(input_prompt) + 1
+  );
+
+  bootloader_status status = bootloader_proccess_input();
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_OK, status);
+}
+
+TEST(bootloader, write_framed_corrupted_success)
+{
+  static char *input_cmd = "?";
+  static uint32_t page_addr = APP_START_ADDRESS;
+  static uint8_t input_data[8] = {
+    0x53, 0xf5, 0x44, 0x33, 0xaa, 0x55, 0x00, 0xff
+  };
+  static uint8_t input_frames[3][FRAME_BUFFER_SIZE];
+  static uint16_t input_sizes[3];
+  static uint8_t expected_responses[3][FRAME_RESPONSE_SIZE + 2];
+  static uint16_t expected_sizes[3];
+  static char *input_prompt = "\r\n>>";
+  static uint8_t ack_byte = ACK_BYTE;
+
+  input_sizes[0] = build_framed(
+    input_frames[0],
+    FRAME_DATA,
+    0,
+    APP_START_ADDRESS,
+    input_data,
+    8
+  );
+  // A lost byte: the frame is answered at its delimiter
+  memcpy(input_frames[1], input_frames[0], input_sizes[0]);
+  memmove(input_frames[1] + 5, input_frames[1] + 6, input_sizes[0] - 6);
+  input_sizes[1] = input_sizes[0] - 1;
+  input_sizes[2] = build_framed(input_frames[2], FRAME_END, 1, 0, NULL, 0);
+  expected_sizes[0] = build_frame_response(
+    expected_responses[0],
+    BOOTLOADER_CRC_ERROR,
+    FRAME_UNKNOWN_SEQ,
+    0,
+    0x00
+  );
+  expected_sizes[1] = build_frame_response(
+    expected_responses[1],
+    BOOTLOADER_OK,
+    0,
+    1,
+    0x00
+  );
+  expected_sizes[2] = build_frame_response(
+    expected_responses[2],
+    BOOTLOADER_OK,
+    1,
+    1,
+    0x00
+  );
+
+  mock_bootloader_io_expect_read_then_return((uint8_t*)input_cmd, 1);
+
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_read_frame_then_return(
+    input_frames[1],
+    input_sizes[1]
+  );
+  mock_bootloader_io_expect_write(expected_responses[0], expected_sizes[0]);
+  mock_bootloader_io_expect_read_frame_then_return(
+    input_frames[0],
+    input_sizes[0]
+  );
+  mock_bootloader_io_expect_program_wait();
+  mock_bootloader_io_expect_erase_start((uint8_t*)&page_addr, 1);
+  mock_bootloader_io_expect_program_start(input_data, 8);
+  mock_bootloader_io_expect_write(expected_responses[1], expected_sizes[1]);
+  mock_bootloader_io_expect_read_frame_then_return(
+    input_frames[2],
+    input_sizes[2]
+  );
+  mock_bootloader_io_expect_program_wait();
+  mock_bootloader_io_expect_write(expected_responses[2], expected_sizes[2]);
+
+  mock_bootloader_io_expect_write(
+    (uint8_t*)input_prompt,
+    strlen(input_prompt) + 1
+  );
+
+  bootloader_status status = bootloader_proccess_input();
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_OK, status);
+}
+
+TEST(bootloader, set_timeouts_success)
+{
+  static char *input_cmd = "@";
+  static uint16_t input_gaps[TIMEOUT_GAPS_NUM] = { 50, 10 };
+  static uint8_t expected_response[TIMEOUTS_RESPONSE_SIZE];
+  static char *input_prompt = "\r\n>>";
+  static uint8_t ack_byte = ACK_BYTE;
+  uint16_t longest_gaps[TIMEOUT_GAPS_NUM] = { 30, 4 };
+  uint32_t crc = 0;
+
+  bootloader_timeout_track(TIMEOUT_FRAME_GAP, longest_gaps[0]);
+  bootloader_timeout_track(TIMEOUT_BYTE_GAP, longest_gaps[1]);
+  memcpy(expected_response, input_gaps, sizeof(input_gaps));
+  memcpy(expected_response + 4, longest_gaps, sizeof(longest_gaps));
+  crc = bootloader_crc32_update(CRC_INIT, expected_response, 8);
+  memcpy(expected_response + 8, &crc, sizeof(uint32_t));
+
+  mock_bootloader_io_expect_read_then_return((uint8_t*)input_cmd, 1);
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)input_gaps,
+    sizeof(input_gaps)
+  );
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_write(
+    expected_response,
+    TIMEOUTS_RESPONSE_SIZE
+  );
+
+  mock_bootloader_io_expect_write(
+    (uint8_t*)input_prompt,
+    strlen(input_prompt) + 1
+  );
+
+  bootloader_status status = bootloader_proccess_input();
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_OK, status);
+  TEST_ASSERT_EQUAL(50, bootloader_timeout_get(TIMEOUT_FRAME_GAP));
+  TEST_ASSERT_EQUAL(10, bootloader_timeout_get(TIMEOUT_BYTE_GAP));
+  TEST_ASSERT_EQUAL(0, bootloader_timeout_get_longest(TIMEOUT_FRAME_GAP));
+  bootloader_timeout_reset();
+}
+
+TEST(bootloader, set_timeouts_bound_error)
+{
+  static char *input_cmd = "@";
+  // The byte gap is longer than the frame gap
+  static uint16_t input_gaps[TIMEOUT_GAPS_NUM] = { 50, 60 };
+  static char *input_prompt = "\r\n>>";
+  static uint8_t ack_byte = ACK_BYTE;
+  static uint8_t nack_byte = NACK_BYTE;
+
+  mock_bootloader_io_expect_read_then_return((uint8_t*)input_cmd, 1);
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)input_gaps,
+    sizeof(input_gaps)
+  );
+  mock_bootloader_io_expect_write(&nack_byte, sizeof(nack_byte));
+
+  mock_bootloader_io_expect_write(
+    (uint8_t*)input_prompt,
+    strlen(input_prompt) + 1
+  );
+
+  bootloader_status status = bootloader_proccess_input();
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_BOUNDS_ERROR, status);
+  TEST_ASSERT_EQUAL(UART_DELAY, bootloader_timeout_get(TIMEOUT_FRAME_GAP));
+  TEST_ASSERT_EQUAL(UART_DELAY, bootloader_timeout_get(TIMEOUT_BYTE_GAP));
+}
+
+TEST(bootloader, write_stream_success)
+{
+  static char *input_cmd = "A";
+  // The first piece ends at the page boundary, the second starts a page
+  static uint32_t input_addr = APP_START_ADDRESS + BLOCK_SIZE - 4;
+  static uint32_t page_addr = APP_START_ADDRESS + BLOCK_SIZE;
+  static uint32_t input_size = 8;
+  static uint8_t input_data[8] = {
+    0x53, 0xf5, 0x44, 0x33, 0xaa, 0x55, 0x00, 0xff
+  };
+  static uint8_t expected_checkpoints[2][STREAM_RESPONSE_SIZE];
+  static char *input_prompt = "\r\n>>";
+  static uint8_t ack_byte = ACK_BYTE;
+
+  for (uint8_t i = 0; i < 2; i++)
+  {
+    uint32_t position = (i + 1) * 4;
+    uint32_t crc = bootloader_crc32_update(CRC_INIT, input_data, position);
+
+    expected_checkpoints[i][0] = ACK_BYTE;
+    memcpy(expected_checkpoints[i] + 1, &position, sizeof(uint32_t));
+    memcpy(expected_checkpoints[i] + 5, &crc, sizeof(uint32_t));
+  }
+
+  mock_bootloader_io_expect_read_then_return((uint8_t*)input_cmd, 1);
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_addr,
+    sizeof(uint32_t)
+  );
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_size,
+    sizeof(uint32_t)
+  );
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+
+  mock_bootloader_io_expect_read_then_return(input_data, 4);
+  mock_bootloader_io_expect_program_wait();
+  mock_bootloader_io_expect_program_start(input_data, 4);
+  mock_bootloader_io_expect_write(
+    expected_checkpoints[0],
+    STREAM_RESPONSE_SIZE
+  );
+  mock_bootloader_io_expect_read_then_return(input_data + 4, 4);
+  mock_bootloader_io_expect_program_wait();
+  mock_bootloader_io_expect_erase_start((uint8_t*)&page_addr, 1);
+  mock_bootloader_io_expect_program_start(input_data + 4, 4);
+  mock_bootloader_io_expect_program_wait();
+  mock_bootloader_io_expect_write(
+    expected_checkpoints[1],
+    STREAM_RESPONSE_SIZE
+  );
+
+  mock_bootloader_io_expect_write(
+    (uint8_t*)input_prompt,
+    strlen(input_prompt) + 1
+  );
+
+  bootloader_status status = bootloader_proccess_input();
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_OK, status);
+}
+
+TEST(bootloader, write_stream_bounds_error)
+{
+  static char *input_cmd = "A";
+  static uint32_t input_addr = APP_START_ADDRESS;
+  // Beyond the end of flash
+  static uint32_t input_size = APP_PAGES_NUM * BLOCK_SIZE + 2;
+  static char *input_prompt = "\r\n>>";
+  static uint8_t ack_byte = ACK_BYTE;
+  static uint8_t nack_byte = NACK_BYTE;
+
+  mock_bootloader_io_expect_read_then_return((uint8_t*)input_cmd, 1);
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_addr,
+    sizeof(uint32_t)
+  );
+  mock_bootloader_io_expect_read_then_return(
+    (uint8_t*)&input_size,
+    sizeof(uint32_t)
+  );
+  mock_bootloader_io_expect_write(&nack_byte, sizeof(nack_byte));
+
+  mock_bootloader_io_expect_write(
+    (uint8_t*)input_prompt,
+    strlen(input_prompt) + 1
+  );
+
+  bootloader_status status = bootloader_proccess_input();
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_BOUNDS_ERROR, status);
+}
+
+TEST(bootloader, machine_mode_success)
+{
+  static char *input_cmd = "B";
+  static uint8_t input_opcodes[3] = {
+    CMD_GET_BOOTLOADER_VER - CMD_HELP,
+    0x7f, // unknown
+    CMD_SET_MODE - CMD_HELP
+  };
+  static uint8_t input_modes[2] = { MODE_MACHINE, MODE_HUMAN };
+  static uint8_t expected_version[3] = {
+    ACK_BYTE,
+    BOOTLOADER_VER_MAJOR - '0',
+    BOOTLOADER_VER_MINOR - '0'
+  };
+  static char *input_prompt = "\r\n>>";
+  static uint8_t ack_byte = ACK_BYTE;
+  static uint8_t nack_byte = NACK_BYTE;
+
+  // No prompt after the switch
+  mock_bootloader_io_expect_read_then_return((uint8_t*)input_cmd, 1);
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_read_then_return(input_modes, 1);
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+
+  mock_bootloader_io_expect_read_then_return(input_opcodes, 1);
+  mock_bootloader_io_expect_write(expected_version, sizeof(expected_version));
+
+  mock_bootloader_io_expect_read_then_return(input_opcodes + 1, 1);
+  mock_bootloader_io_expect_write(&nack_byte, sizeof(nack_byte));
+
+  // Back in human mode
+  mock_bootloader_io_expect_read_then_return(input_opcodes + 2, 1);
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_read_then_return(input_modes + 1, 1);
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_write(
+    (uint8_t*)input_prompt,
+    strlen(input_prompt) + 1
+  );
+
+  bootloader_status status = bootloader_proccess_input();
+  status |= bootloader_proccess_input();
+  status |= bootloader_proccess_input();
+  status |= bootloader_proccess_input();
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_OK, status);
+}
+
+TEST(bootloader, set_mode_bounds_error)
+{
+  static char *input_cmd = "B";
+  static uint8_t input_mode = MODE_MACHINE + 1;
+  static char *input_prompt = "\r\n>>";
+  static uint8_t ack_byte = ACK_BYTE;
+  static uint8_t nack_byte = NACK_BYTE;
+
+  mock_bootloader_io_expect_read_then_return((uint8_t*)input_cmd, 1);
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_read_then_return(&input_mode, 1);
+  mock_bootloader_io_expect_write(&nack_byte, sizeof(nack_byte));
+
+  mock_bootloader_io_expect_write(
+    (uint8_t*)input_prompt,
+    strlen(input_prompt) + 1
+  );
+
+  bootloader_status status = bootloader_proccess_input();
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_BOUNDS_ERROR, status);
+}
+
+TEST(bootloader, get_capabilities_success)
+{
+  static char *input_cmd = "C";
+  static uint8_t input_uid[UID_SIZE] = {
+    0x31, 0xff, 0xd6, 0x05, 0x42, 0x47, 0x36, 0x37, 0x24, 0x61, 0x12, 0x43
+  };
+  static uint8_t expected_response[CAPABILITIES_SIZE + sizeof(uint32_t)];
+  static char *input_prompt = "\r\n>>";
+  static uint8_t ack_byte = ACK_BYTE;
+  uint8_t header[4] = { PROTOCOL_VERSION, 0, 1, COMMANDS_NUM };
+  uint32_t commands = 0xfffff; // 20 commands
+  uint16_t sizes[3] = { BLOCK_SIZE, BLOCK_SIZE, RX_RING_SIZE };
+  uint16_t flash_size = 128;
+  uint32_t address = APP_START_ADDRESS;
+  uint32_t clock = 72000000;
+  uint32_t crc = 0;
+
+  memcpy(expected_response, header, sizeof(header));
+  memcpy(expected_response + 4, &commands, sizeof(uint32_t));
+  memcpy(expected_response + 8, sizes, sizeof(sizes));
+  expected_response[14] = WINDOW_FRAMES_LIMIT;
+  memcpy(expected_response + 15, &flash_size, sizeof(uint16_t));
+  memcpy(expected_response + 17, &address, sizeof(uint32_t));
+  memcpy(expected_response + 21, input_uid, UID_SIZE);
+  memcpy(expected_response + 33, &clock, sizeof(uint32_t));
+  crc = bootloader_crc32_update(CRC_INIT, expected_response, 37);
+  memcpy(expected_response + 37, &crc, sizeof(uint32_t));
+
+  mock_bootloader_io_expect_read_then_return((uint8_t*)input_cmd, 1);
+  mock_bootloader_io_expect_get_flash_size_then_return();
+  mock_bootloader_io_expect_get_uid_then_return(input_uid);
+  mock_bootloader_io_expect_get_uart_clock_then_return();
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_write(
+    expected_response,
+    sizeof(expected_response)
+  );
+
+  mock_bootloader_io_expect_write(
+    (uint8_t*)input_prompt,
+    strlen(input_prompt) + 1
+  );
+
+  bootloader_status status = bootloader_proccess_input();
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_OK, status);
+}
+
+TEST(bootloader, get_capabilities_machine_mode_success)
+{
+  static char *input_cmd = "B";
+  static uint8_t input_opcodes[2] = {
+    CMD_GET_CAPABILITIES - CMD_HELP,
+    CMD_SET_MODE - CMD_HELP
+  };
+  static uint8_t input_modes[2] = { MODE_MACHINE, MODE_HUMAN };
+  static uint8_t input_uid[UID_SIZE] = {
+    0x31, 0xff, 0xd6, 0x05, 0x42, 0x47, 0x36, 0x37, 0x24, 0x61, 0x12, 0x43
+  };
+  static uint8_t expected_response[CAPABILITIES_SIZE + sizeof(uint32_t)];
+  static char *input_prompt = "\r\n>>";
+  static uint8_t ack_byte = ACK_BYTE;
+  uint8_t header[4] = { PROTOCOL_VERSION, 0, 1, COMMANDS_NUM };
+  uint32_t commands = 0xfffde; // without help and read (0 and 5)
+  uint16_t sizes[3] = { BLOCK_SIZE, BLOCK_SIZE, RX_RING_SIZE };
+  uint16_t flash_size = 128;
+  uint32_t address = APP_START_ADDRESS;
+  uint32_t clock = 72000000;
+  uint32_t crc = 0;
+
+  memcpy(expected_response, header, sizeof(header));
+  memcpy(expected_response + 4, &commands, sizeof(uint32_t));
+  memcpy(expected_response + 8, sizes, sizeof(sizes));
+  expected_response[14] = WINDOW_FRAMES_LIMIT;
+  memcpy(expected_response + 15, &flash_size, sizeof(uint16_t));
+  memcpy(expected_response + 17, &address, sizeof(uint32_t));
+  memcpy(expected_response + 21, input_uid, UID_SIZE);
+  memcpy(expected_response + 33, &clock, sizeof(uint32_t));
+  crc = bootloader_crc32_update(CRC_INIT, expected_response, 37);
+  memcpy(expected_response + 37, &crc, sizeof(uint32_t));
+
+  mock_bootloader_io_expect_read_then_return((uint8_t*)input_cmd, 1);
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_read_then_return(input_modes, 1);
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+
+  mock_bootloader_io_expect_read_then_return(input_opcodes, 1);
+  mock_bootloader_io_expect_get_flash_size_then_return();
+  mock_bootloader_io_expect_get_uid_then_return(input_uid);
+  mock_bootloader_io_expect_get_uart_clock_then_return();
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_write(
+    expected_response,
+    sizeof(expected_response)
+  );
+
+  // Back in human mode
+  mock_bootloader_io_expect_read_then_return(input_opcodes + 1, 1);
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_read_then_return(input_modes + 1, 1);
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_write(
+    (uint8_t*)input_prompt,
+    strlen(input_prompt) + 1
+  );
+
+  bootloader_status status = bootloader_proccess_input();
+  status |= bootloader_proccess_input();
+  status |= bootloader_proccess_input();
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_OK, status);
+}
+
+TEST(bootloader, session_idle_success)
+{
+  static char *input_cmd = "B";
+  static uint8_t input_mode = MODE_MACHINE;
+  static char *version_cmd = "2";
+  static char *bootloader_version_message = "\r\nBootloader version: ";
+  static char *version_message = "0.1";
+  static char *input_prompt = "\r\n>>";
+  static uint8_t ack_byte = ACK_BYTE;
+
+  mock_bootloader_io_set_ticks(1000);
+  mock_bootloader_io_expect_read_then_return((uint8_t*)input_cmd, 1);
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+  mock_bootloader_io_expect_read_then_return(&input_mode, 1);
+  mock_bootloader_io_expect_write(&ack_byte, sizeof(ack_byte));
+
+  // The host is gone: the next command is taken in human mode
+  mock_bootloader_io_expect_read_then_return((uint8_t*)version_cmd, 1);
+  mock_bootloader_io_expect_write(
+    (uint8_t*)bootloader_version_message,
+    strlen(bootloader_version_message) + 1
+  );
+  mock_bootloader_io_expect_write((uint8_t*)version_message, 3);
+  mock_bootloader_io_expect_write(
+    (uint8_t*)input_prompt,
+    strlen(input_prompt) + 1
+  );
+
+  bootloader_status status = bootloader_proccess_input();
+  status |= bootloader_timeout_set(50, 10);
+  mock_bootloader_io_set_ticks(1000 + SESSION_IDLE_TIME);
+  status |= bootloader_proccess_input();
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_OK, status);
+  TEST_ASSERT_EQUAL(UART_DELAY, bootloader_timeout_get(TIMEOUT_FRAME_GAP));
+  TEST_ASSERT_EQUAL(UART_DELAY, bootloader_timeout_get(TIMEOUT_BYTE_GAP));
+}
@@ -12,4 +12,37 @@ TEST_GROUP_RUNNER(bootloader)
   RUN_TEST_CASE(bootloader, erase_success);
   RUN_TEST_CASE(bootloader, erase_start_bound_error);
   RUN_TEST_CASE(bootloader, erase_end_bound_error);
+  RUN_TEST_CASE(bootloader, write_block_success);
+  RUN_TEST_CASE(bootloader, write_block_crc_error);
+  RUN_TEST_CASE(bootloader, write_block_size_error);
+  RUN_TEST_CASE(bootloader, write_block_pipelined_success);
+  RUN_TEST_CASE(bootloader, set_baud_rate_success);
+  RUN_TEST_CASE(bootloader, set_baud_rate_sync_error);
+  RUN_TEST_CASE(bootloader, set_baud_rate_bound_error);
+  RUN_TEST_CASE(bootloader, write_compressed_success);
+  RUN_TEST_CASE(bootloader, write_compressed_odd_size_success);
+  RUN_TEST_CASE(bootloader, write_compressed_size_error);
+  RUN_TEST_CASE(bootloader, write_delta_success);
+  RUN_TEST_CASE(bootloader, write_delta_installed_crc_error);
+  RUN_TEST_CASE(bootloader, write_delta_resume_success);
+  RUN_TEST_CASE(bootloader, get_pages_crc_success);
+  RUN_TEST_CASE(bootloader, verify_success);
+  RUN_TEST_CASE(bootloader, verify_size_error);
+  RUN_TEST_CASE(bootloader, read_binary_success);
+  RUN_TEST_CASE(bootloader, read_binary_bound_error);
+  RUN_TEST_CASE(bootloader, get_stats_success);
+  RUN_TEST_CASE(bootloader, write_window_success);
+  RUN_TEST_CASE(bootloader, write_window_retransmit_success);
+  RUN_TEST_CASE(bootloader, write_window_beyond_limit_error);
+  RUN_TEST_CASE(bootloader, write_framed_success);
+  RUN_TEST_CASE(bootloader, write_framed_corrupted_success);
+  RUN_TEST_CASE(bootloader, set_timeouts_success);
+  RUN_TEST_CASE(bootloader, set_timeouts_bound_error);
+  RUN_TEST_CASE(bootloader, write_stream_success);
+  RUN_TEST_CASE(bootloader, write_stream_bounds_error);
+  RUN_TEST_CASE(bootloader, machine_mode_success);
+  RUN_TEST_CASE(bootloader, set_mode_bounds_error);
+  RUN_TEST_CASE(bootloader, get_capabilities_success);
+  RUN_TEST_CASE(bootloader, get_capabilities_machine_mode_success);
+  RUN_TEST_CASE(bootloader, session_idle_success);
 }
\ No newline at end of file
@@ -0,0 +1,115 @@
+#include "unity_fixture.h"
+#include "bootloader_cobs.h"
+#include <string.h>
+
+static uint8_t frame[FRAME_BUFFER_SIZE];
+static uint8_t data[FRAME_MAX_SIZE];
+
+// Tests ---------------------------------------------------------------------
+
+TEST_GROUP(bootloader_cobs);
+
+TEST_SETUP(bootloader_cobs)
+{
+  memset(frame, 0, sizeof(frame));
+  memset(data, 0, sizeof(data));
+}
+
+TEST_TEAR_DOWN(bootloader_cobs)
+{
+}
+
+TEST(bootloader_cobs, encode_zeros)
+{
+  static uint8_t input_data[] = { 0x11, 0x00, 0x00, 0x22, 0x33, 0x00 };
+  static uint8_t expected_frame[] = {
+    0x02, 0x11, 0x01, 0x03, 0x22, 0x33, 0x01
+  };
+
+  uint16_t size = bootloader_cobs_encode(
+    input_data,
+    sizeof(input_data),
+    frame
+  );
+
+  TEST_ASSERT_EQUAL(sizeof(expected_frame), size);
+  TEST_ASSERT_EQUAL_MEMORY(expected_frame, frame, sizeof(expected_frame));
+}
+
+TEST(bootloader_cobs, encode_long_block)
+{
+  uint16_t size = 0;
+  uint16_t decoded_size = 0;
+
+  memset(data, 0xa5, 300);
+  size = bootloader_cobs_encode(data, 300, frame);
+  // 254 bytes without a zero end a block
+  TEST_ASSERT_EQUAL_HEX8(0xff, frame[0]);
+  TEST_ASSERT_EQUAL_HEX8(300 - 254 + 1, frame[255]);
+
+  bootloader_status status = bootloader_cobs_decode(
+    frame,
+    size,
+    frame,
+    &decoded_size
+  );
+
+  TEST_ASSERT_EQUAL(300 + 2, size);
+  TEST_ASSERT_EQUAL(BOOTLOADER_OK, status);
+  TEST_ASSERT_EQUAL(300, decoded_size);
+  TEST_ASSERT_EQUAL_MEMORY(data, frame, 300);
+}
+
+TEST(bootloader_cobs, decode_in_place)
+{
+  static uint8_t input_data[] = { 0x00, 0x53, 0xf5, 0x00, 0x44 };
+  uint16_t size = bootloader_cobs_encode(
+    input_data,
+    sizeof(input_data),
+    frame
+  );
+  uint16_t decoded_size = 0;
+
+  TEST_ASSERT_NULL(memchr(frame, FRAME_DELIMITER, size));
+
+  bootloader_status status = bootloader_cobs_decode(
+    frame,
+    size,
+    frame,
+    &decoded_size
+  );
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_OK, status);
+  TEST_ASSERT_EQUAL(sizeof(input_data), decoded_size);
+  TEST_ASSERT_EQUAL_MEMORY(input_data, frame, sizeof(input_data));
+}
+
+TEST(bootloader_cobs, decode_delimiter_error)
+{
+  static uint8_t input_frame[] = { 0x03, 0x11, 0x00, 0x01 };
+  uint16_t size = 0;
+
+  bootloader_status status = bootloader_cobs_decode(
+    input_frame,
+    sizeof(input_frame),
+    data,
+    &size
+  );
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_ERROR, status);
+}
+
+TEST(bootloader_cobs, decode_cut_error)
+{
+  static uint8_t input_frame[] = { 0x02, 0x11, 0x05, 0x22, 0x33 };
+  uint16_t size = 0;
+
+  bootloader_status status = bootloader_cobs_decode(
+    input_frame,
+    sizeof(input_frame),
+    data,
+    &size
+  );
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_ERROR, status);
+}
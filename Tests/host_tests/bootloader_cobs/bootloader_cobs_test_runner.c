@@ -0,0 +1,10 @@
+#include "unity_fixture.h"
+
+TEST_GROUP_RUNNER(bootloader_cobs)
+{
+  RUN_TEST_CASE(bootloader_cobs, encode_zeros);
+  RUN_TEST_CASE(bootloader_cobs, encode_long_block);
+  RUN_TEST_CASE(bootloader_cobs, decode_in_place);
+  RUN_TEST_CASE(bootloader_cobs, decode_delimiter_error);
+  RUN_TEST_CASE(bootloader_cobs, decode_cut_error);
+}
\ No newline at end of file
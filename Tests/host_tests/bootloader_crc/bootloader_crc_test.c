@@ -0,0 +1,66 @@
+#include "unity_fixture.h"
+#include "bootloader_crc.h"
+#include <string.h>
+
+// Tests ---------------------------------------------------------------------
+
+TEST_GROUP(bootloader_crc);
+
+TEST_SETUP(bootloader_crc)
+{
+}
+
+TEST_TEAR_DOWN(bootloader_crc)
+{
+}
+
+TEST(bootloader_crc, check_value)
+{
+  static char *input_data = "123456789";
+
+  uint32_t crc = bootloader_crc32_update(
+    CRC_INIT,
+    (uint8_t*)input_data,
+    strlen(input_data)
+  );
+
+  TEST_ASSERT_EQUAL_HEX32(0x0376E6E7, crc);
+}
+
+TEST(bootloader_crc, split_update)
+{
+  static char *input_data = "123456789";
+
+  uint32_t crc = bootloader_crc32_update(CRC_INIT, (uint8_t*)input_data, 4);
+  crc = bootloader_crc32_update(crc, (uint8_t*)input_data + 4, 5);
+
+  TEST_ASSERT_EQUAL_HEX32(0x0376E6E7, crc);
+}
+
+TEST(bootloader_crc, words_update)
+{
+  static uint32_t input_data[2] = { 0x34333231, 0x38373635 };
+  static char *expected_order = "43218765";
+
+  uint32_t crc = bootloader_crc32_update_words(CRC_INIT, input_data, 2);
+  uint32_t expected_crc = bootloader_crc32_update(
+    CRC_INIT,
+    (uint8_t*)expected_order,
+    strlen(expected_order)
+  );
+
+  TEST_ASSERT_EQUAL_HEX32(expected_crc, crc);
+}
+
+TEST(bootloader_crc, crc16_check_value)
+{
+  static char *input_data = "123456789";
+
+  uint16_t crc = bootloader_crc16_update(
+    CRC16_INIT,
+    (uint8_t*)input_data,
+    strlen(input_data)
+  );
+
+  TEST_ASSERT_EQUAL_HEX16(0x29B1, crc);
+}
@@ -0,0 +1,9 @@
+#include "unity_fixture.h"
+
+TEST_GROUP_RUNNER(bootloader_crc)
+{
+  RUN_TEST_CASE(bootloader_crc, check_value);
+  RUN_TEST_CASE(bootloader_crc, split_update);
+  RUN_TEST_CASE(bootloader_crc, words_update);
+  RUN_TEST_CASE(bootloader_crc, crc16_check_value);
+}
\ No newline at end of file
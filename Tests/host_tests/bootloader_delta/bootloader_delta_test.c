@@ -0,0 +1,163 @@
+#include "unity_fixture.h"
+#include "bootloader_delta.h"
+#include <string.h>
+
+static uint8_t window[2 * BLOCK_SIZE];
+static uint8_t source[2 * BLOCK_SIZE];
+static uint8_t backup[BLOCK_SIZE];
+static bootloader_delta_decoder decoder;
+
+// Tests ---------------------------------------------------------------------
+
+TEST_GROUP(bootloader_delta);
+
+TEST_SETUP(bootloader_delta)
+{
+  memset(window, 0, sizeof(window));
+  for (uint16_t i = 0; i < sizeof(source); i++)
+    source[i] = (uint8_t)i;
+  memset(backup, 0xee, sizeof(backup));
+  bootloader_delta_init(&decoder, window, source, sizeof(source), backup);
+}
+
+TEST_TEAR_DOWN(bootloader_delta)
+{
+}
+
+TEST(bootloader_delta, insert_only)
+{
+  static uint8_t input[] = { DELTA_OP_INSERT, 0x04, 0x00, 'a', 'b', 'c', 'd' };
+
+  bootloader_delta_set_input(&decoder, input, sizeof(input));
+  bootloader_status status = bootloader_delta_decode(&decoder, BLOCK_SIZE);
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_OK, status);
+  TEST_ASSERT_EQUAL(4, decoder.position);
+  TEST_ASSERT_EQUAL_MEMORY("abcd", window, 4);
+  TEST_ASSERT_TRUE(bootloader_delta_is_finished(&decoder));
+}
+
+TEST(bootloader_delta, copy_and_add)
+{
+  // Copy 2 bytes from offset 16, then add 1 to 2 bytes from offset 32
+  static uint8_t input[] = {
+    DELTA_OP_COPY, 0x10, 0x00, 0x00, 0x00, 0x02, 0x00,
+    DELTA_OP_ADD, 0x20, 0x00, 0x00, 0x00, 0x02, 0x00, 0x01, 0x01
+  };
+  static uint8_t expected[] = { 0x10, 0x11, 0x21, 0x22 };
+
+  bootloader_delta_set_input(&decoder, input, sizeof(input));
+  bootloader_status status = bootloader_delta_decode(&decoder, BLOCK_SIZE);
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_OK, status);
+  TEST_ASSERT_EQUAL(sizeof(expected), decoder.position);
+  TEST_ASSERT_EQUAL_MEMORY(expected, window, sizeof(expected));
+  TEST_ASSERT_TRUE(bootloader_delta_is_finished(&decoder));
+}
+
+TEST(bootloader_delta, copy_stops_at_limit)
+{
+  // Copy the first page and 4 bytes of the second one
+  static uint8_t input[] = {
+    DELTA_OP_COPY, 0x00, 0x00, 0x00, 0x00, 0x04, 0x04
+  };
+
+  bootloader_delta_set_input(&decoder, input, sizeof(input));
+  bootloader_status status = bootloader_delta_decode(&decoder, BLOCK_SIZE);
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_OK, status);
+  TEST_ASSERT_EQUAL(BLOCK_SIZE, decoder.position);
+  TEST_ASSERT_FALSE(bootloader_delta_is_finished(&decoder));
+
+  status = bootloader_delta_decode(&decoder, 2 * BLOCK_SIZE);
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_OK, status);
+  TEST_ASSERT_EQUAL(BLOCK_SIZE + 4, decoder.position);
+  TEST_ASSERT_EQUAL_MEMORY(source, window, BLOCK_SIZE + 4);
+  TEST_ASSERT_TRUE(bootloader_delta_is_finished(&decoder));
+}
+
+TEST(bootloader_delta, copy_from_backup)
+{
+  // The first page is rewritten: its last 2 bytes come from the backup
+  static uint8_t input[] = {
+    DELTA_OP_COPY, 0xfe, 0x03, 0x00, 0x00, 0x04, 0x00
+  };
+  static uint8_t expected[] = { 0xee, 0xee, 0x00, 0x01 };
+
+  decoder.position = BLOCK_SIZE;
+  bootloader_delta_set_input(&decoder, input, sizeof(input));
+  bootloader_status status = bootloader_delta_decode(
+    &decoder,
+    2 * BLOCK_SIZE
+  );
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_OK, status);
+  TEST_ASSERT_EQUAL(BLOCK_SIZE + 4, decoder.position);
+  TEST_ASSERT_EQUAL_MEMORY(expected, window + BLOCK_SIZE, sizeof(expected));
+}
+
+TEST(bootloader_delta, split_input)
+{
+  static uint8_t input[] = {
+    DELTA_OP_INSERT, 0x02, 0x00, 0xab, 0xcd,
+    DELTA_OP_COPY, 0x04, 0x00, 0x00, 0x00, 0x02, 0x00
+  };
+  static uint8_t expected[] = { 0xab, 0xcd, 0x04, 0x05 };
+
+  bootloader_delta_set_input(&decoder, input, 4);
+  bootloader_status status = bootloader_delta_decode(&decoder, BLOCK_SIZE);
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_OK, status);
+  TEST_ASSERT_EQUAL(1, decoder.position);
+  TEST_ASSERT_FALSE(bootloader_delta_is_finished(&decoder));
+
+  bootloader_delta_set_input(&decoder, input + 4, sizeof(input) - 4);
+  status = bootloader_delta_decode(&decoder, BLOCK_SIZE);
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_OK, status);
+  TEST_ASSERT_EQUAL(sizeof(expected), decoder.position);
+  TEST_ASSERT_EQUAL_MEMORY(expected, window, sizeof(expected));
+  TEST_ASSERT_TRUE(bootloader_delta_is_finished(&decoder));
+}
+
+TEST(bootloader_delta, rewritten_source_error)
+{
+  // The first page is rewritten and no longer in the backup
+  static uint8_t input[] = {
+    DELTA_OP_COPY, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00
+  };
+
+  decoder.position = 2 * BLOCK_SIZE;
+  bootloader_delta_set_input(&decoder, input, sizeof(input));
+  bootloader_status status = bootloader_delta_decode(
+    &decoder,
+    3 * BLOCK_SIZE
+  );
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_BOUNDS_ERROR, status);
+}
+
+TEST(bootloader_delta, source_bounds_error)
+{
+  static uint8_t input[] = {
+    DELTA_OP_COPY, 0xff, 0x07, 0x00, 0x00, 0x02, 0x00
+  };
+
+  bootloader_delta_set_input(&decoder, input, sizeof(input));
+  bootloader_status status = bootloader_delta_decode(&decoder, BLOCK_SIZE);
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_BOUNDS_ERROR, status);
+  TEST_ASSERT_EQUAL(1, decoder.position);
+}
+
+TEST(bootloader_delta, op_error)
+{
+  static uint8_t input[] = { 0x00, 0x01, 0x00, 0xff };
+
+  bootloader_delta_set_input(&decoder, input, sizeof(input));
+  bootloader_status status = bootloader_delta_decode(&decoder, BLOCK_SIZE);
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_ERROR, status);
+  TEST_ASSERT_EQUAL(0, decoder.position);
+}
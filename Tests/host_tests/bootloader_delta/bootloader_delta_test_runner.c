@@ -0,0 +1,13 @@
+#include "unity_fixture.h"
+
+TEST_GROUP_RUNNER(bootloader_delta)
+{
+  RUN_TEST_CASE(bootloader_delta, insert_only);
+  RUN_TEST_CASE(bootloader_delta, copy_and_add);
+  RUN_TEST_CASE(bootloader_delta, copy_stops_at_limit);
+  RUN_TEST_CASE(bootloader_delta, copy_from_backup);
+  RUN_TEST_CASE(bootloader_delta, split_input);
+  RUN_TEST_CASE(bootloader_delta, rewritten_source_error);
+  RUN_TEST_CASE(bootloader_delta, source_bounds_error);
+  RUN_TEST_CASE(bootloader_delta, op_error);
+}
\ No newline at end of file
@@ -0,0 +1,98 @@
+#include "unity_fixture.h"
+#include "bootloader_lz.h"
+#include <string.h>
+
+static uint8_t window[LZ_WINDOW_SIZE];
+static bootloader_lz_decoder decoder;
+
+// Tests ---------------------------------------------------------------------
+
+TEST_GROUP(bootloader_lz);
+
+TEST_SETUP(bootloader_lz)
+{
+  memset(window, 0, sizeof(window));
+  bootloader_lz_init(&decoder, window);
+}
+
+TEST_TEAR_DOWN(bootloader_lz)
+{
+}
+
+TEST(bootloader_lz, literals_only)
+{
+  static uint8_t input[] = { 0x40, 'a', 'b', 'c', 'd' };
+
+  bootloader_lz_set_input(&decoder, input, sizeof(input));
+  bootloader_status status = bootloader_lz_decode(&decoder, LZ_WINDOW_SIZE);
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_OK, status);
+  TEST_ASSERT_EQUAL(4, decoder.position);
+  TEST_ASSERT_EQUAL_MEMORY("abcd", window, 4);
+  TEST_ASSERT_TRUE(bootloader_lz_is_finished(&decoder));
+}
+
+TEST(bootloader_lz, overlapping_match)
+{
+  // 2 literals, then a match of 8 bytes with offset 2
+  static uint8_t input[] = { 0x24, 0x12, 0x34, 0x02, 0x00 };
+  static uint8_t expected[] = {
+    0x12, 0x34, 0x12, 0x34, 0x12, 0x34, 0x12, 0x34, 0x12, 0x34
+  };
+
+  bootloader_lz_set_input(&decoder, input, sizeof(input));
+  bootloader_status status = bootloader_lz_decode(&decoder, LZ_WINDOW_SIZE);
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_OK, status);
+  TEST_ASSERT_EQUAL(sizeof(expected), decoder.position);
+  TEST_ASSERT_EQUAL_MEMORY(expected, window, sizeof(expected));
+  TEST_ASSERT_TRUE(bootloader_lz_is_finished(&decoder));
+}
+
+TEST(bootloader_lz, extended_match_stops_at_limit)
+{
+  // 1 literal, then a match of 15 + 255 + 10 + 4 = 284 bytes with offset 1
+  static uint8_t input[] = { 0x1f, 0xff, 0x01, 0x00, 0xff, 0x0a };
+
+  bootloader_lz_set_input(&decoder, input, sizeof(input));
+  bootloader_status status = bootloader_lz_decode(&decoder, 100);
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_OK, status);
+  TEST_ASSERT_EQUAL(100, decoder.position);
+  TEST_ASSERT_FALSE(bootloader_lz_is_finished(&decoder));
+
+  status = bootloader_lz_decode(&decoder, LZ_WINDOW_SIZE);
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_OK, status);
+  TEST_ASSERT_EQUAL(285, decoder.position);
+  TEST_ASSERT_EACH_EQUAL_HEX8(0xff, window, 285);
+  TEST_ASSERT_TRUE(bootloader_lz_is_finished(&decoder));
+}
+
+TEST(bootloader_lz, split_input)
+{
+  static uint8_t input[] = { 0x24, 0x12, 0x34, 0x02, 0x00 };
+
+  bootloader_lz_set_input(&decoder, input, 3);
+  bootloader_status status = bootloader_lz_decode(&decoder, LZ_WINDOW_SIZE);
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_OK, status);
+  TEST_ASSERT_EQUAL(2, decoder.position);
+
+  bootloader_lz_set_input(&decoder, input + 3, 2);
+  status = bootloader_lz_decode(&decoder, LZ_WINDOW_SIZE);
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_OK, status);
+  TEST_ASSERT_EQUAL(10, decoder.position);
+}
+
+TEST(bootloader_lz, offset_error)
+{
+  // The offset points before the first decoded byte
+  static uint8_t input[] = { 0x10, 0x12, 0x02, 0x00 };
+
+  bootloader_lz_set_input(&decoder, input, sizeof(input));
+  bootloader_status status = bootloader_lz_decode(&decoder, LZ_WINDOW_SIZE);
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_BOUNDS_ERROR, status);
+}
@@ -0,0 +1,10 @@
+#include "unity_fixture.h"
+
+TEST_GROUP_RUNNER(bootloader_lz)
+{
+  RUN_TEST_CASE(bootloader_lz, literals_only);
+  RUN_TEST_CASE(bootloader_lz, overlapping_match);
+  RUN_TEST_CASE(bootloader_lz, extended_match_stops_at_limit);
+  RUN_TEST_CASE(bootloader_lz, split_input);
+  RUN_TEST_CASE(bootloader_lz, offset_error);
+}
\ No newline at end of file
@@ -0,0 +1,93 @@
+#include "unity_fixture.h"
+#include "bootloader_timeout.h"
+
+// Tests ---------------------------------------------------------------------
+
+TEST_GROUP(bootloader_timeout);
+
+TEST_SETUP(bootloader_timeout)
+{
+  bootloader_timeout_reset();
+}
+
+TEST_TEAR_DOWN(bootloader_timeout)
+{
+  bootloader_timeout_reset();
+}
+
+TEST(bootloader_timeout, default_gaps)
+{
+  TEST_ASSERT_EQUAL(UART_DELAY, bootloader_timeout_get(TIMEOUT_FRAME_GAP));
+  TEST_ASSERT_EQUAL(UART_DELAY, bootloader_timeout_get(TIMEOUT_BYTE_GAP));
+  TEST_ASSERT_EQUAL(0, bootloader_timeout_get_longest(TIMEOUT_FRAME_GAP));
+  TEST_ASSERT_EQUAL(0, bootloader_timeout_get_longest(TIMEOUT_BYTE_GAP));
+}
+
+TEST(bootloader_timeout, set_success)
+{
+  bootloader_status status = bootloader_timeout_set(40, 5);
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_OK, status);
+  TEST_ASSERT_EQUAL(40, bootloader_timeout_get(TIMEOUT_FRAME_GAP));
+  TEST_ASSERT_EQUAL(5, bootloader_timeout_get(TIMEOUT_BYTE_GAP));
+
+  // 0 - the default gap
+  status = bootloader_timeout_set(0, 0);
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_OK, status);
+  TEST_ASSERT_EQUAL(UART_DELAY, bootloader_timeout_get(TIMEOUT_FRAME_GAP));
+  TEST_ASSERT_EQUAL(UART_DELAY, bootloader_timeout_get(TIMEOUT_BYTE_GAP));
+}
+
+TEST(bootloader_timeout, set_bounds_error)
+{
+  bootloader_status status = bootloader_timeout_set(
+    UART_MIN_FRAME_GAP - 1,
+    UART_MIN_BYTE_GAP
+  );
+  status |= bootloader_timeout_set(UART_MIN_FRAME_GAP, UART_MIN_BYTE_GAP - 1);
+  status |= bootloader_timeout_set(UART_MIN_FRAME_GAP, UART_MIN_FRAME_GAP + 1);
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_BOUNDS_ERROR, status);
+  TEST_ASSERT_EQUAL(UART_DELAY, bootloader_timeout_get(TIMEOUT_FRAME_GAP));
+  TEST_ASSERT_EQUAL(UART_DELAY, bootloader_timeout_get(TIMEOUT_BYTE_GAP));
+}
+
+TEST(bootloader_timeout, track_longest)
+{
+  bootloader_timeout_track(TIMEOUT_FRAME_GAP, 12);
+  bootloader_timeout_track(TIMEOUT_FRAME_GAP, 7);
+  bootloader_timeout_track(TIMEOUT_BYTE_GAP, 0x12345);
+
+  TEST_ASSERT_EQUAL(12, bootloader_timeout_get_longest(TIMEOUT_FRAME_GAP));
+  TEST_ASSERT_EQUAL(
+    UINT16_MAX,
+    bootloader_timeout_get_longest(TIMEOUT_BYTE_GAP)
+  );
+
+  bootloader_timeout_clear_longest();
+
+  TEST_ASSERT_EQUAL(0, bootloader_timeout_get_longest(TIMEOUT_FRAME_GAP));
+  TEST_ASSERT_EQUAL(0, bootloader_timeout_get_longest(TIMEOUT_BYTE_GAP));
+}
+
+TEST(bootloader_timeout, line_time)
+{
+  // 10 bits per byte, rounded up
+  TEST_ASSERT_EQUAL(1, bootloader_timeout_get_line(1, 115200));
+  TEST_ASSERT_EQUAL(45, bootloader_timeout_get_line(512, 115200));
+  TEST_ASSERT_EQUAL(534, bootloader_timeout_get_line(512, 9600));
+}
+
+TEST(bootloader_timeout, flash_time)
+{
+  uint32_t erase_time = bootloader_timeout_get_flash(2, 0);
+  uint32_t program_time = bootloader_timeout_get_flash(0, BLOCK_SIZE);
+
+  TEST_ASSERT_EQUAL(2 * 2 * FLASH_PAGE_ERASE_TIME + 1, erase_time);
+  TEST_ASSERT_TRUE(program_time > 1);
+  TEST_ASSERT_TRUE(
+    program_time < bootloader_timeout_get_flash(0, 2 * BLOCK_SIZE)
+  );
+  TEST_ASSERT_TRUE(program_time < bootloader_timeout_get_flash(1, 0));
+}
\ No newline at end of file
@@ -0,0 +1,11 @@
+#include "unity_fixture.h"
+
+TEST_GROUP_RUNNER(bootloader_timeout)
+{
+  RUN_TEST_CASE(bootloader_timeout, default_gaps);
+  RUN_TEST_CASE(bootloader_timeout, set_success);
+  RUN_TEST_CASE(bootloader_timeout, set_bounds_error);
+  RUN_TEST_CASE(bootloader_timeout, track_longest);
+  RUN_TEST_CASE(bootloader_timeout, line_time);
+  RUN_TEST_CASE(bootloader_timeout, flash_time);
+}
\ No newline at end of file
@@ -0,0 +1,177 @@
+#include "unity_fixture.h"
+#include "flasher_image.h"
+#include <elf.h>
+#include <string.h>
+
+static flasher_image image;
+static char *hex_text = ":020000040800F2\r\n"
+  ":04680000DEADBEEF5C\r\n"
+  ":026C000012344C\r\n"
+  ":040000050800680186\r\n"
+  ":00000001FF\r\n";
+
+// Tests ---------------------------------------------------------------------
+
+TEST_GROUP(flasher_image);
+
+TEST_SETUP(flasher_image)
+{
+  flasher_image_init(&image);
+}
+
+TEST_TEAR_DOWN(flasher_image)
+{
+}
+
+TEST(flasher_image, put_success)
+{
+  static uint8_t input_data[4] = { 0x53, 0xf5, 0x44, 0x33 };
+
+  bootloader_status status = flasher_image_put(
+    &image,
+    APP_START_ADDRESS + BLOCK_SIZE,
+    input_data,
+    sizeof(input_data)
+  );
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_OK, status);
+  TEST_ASSERT_EQUAL_HEX32(APP_START_ADDRESS + BLOCK_SIZE, image.start);
+  TEST_ASSERT_EQUAL_HEX32(
+    APP_START_ADDRESS + BLOCK_SIZE + sizeof(input_data),
+    image.end
+  );
+  TEST_ASSERT_EQUAL_MEMORY(
+    input_data,
+    flasher_image_at(&image, APP_START_ADDRESS + BLOCK_SIZE),
+    sizeof(input_data)
+  );
+  TEST_ASSERT_TRUE(
+    flasher_image_is_blank(&image, APP_START_ADDRESS, BLOCK_SIZE)
+  );
+  TEST_ASSERT_FALSE(
+    flasher_image_is_blank(&image, APP_START_ADDRESS + BLOCK_SIZE, BLOCK_SIZE)
+  );
+}
+
+TEST(flasher_image, put_bounds_error)
+{
+  static uint8_t input_data[4] = { 0x53, 0xf5, 0x44, 0x33 };
+
+  bootloader_status status = flasher_image_put(
+    &image,
+    APP_START_ADDRESS - 2,
+    input_data,
+    sizeof(input_data)
+  );
+  status |= flasher_image_put(
+    &image,
+    FLASHER_FLASH_END - 2,
+    input_data,
+    sizeof(input_data)
+  );
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_BOUNDS_ERROR, status);
+  TEST_ASSERT_TRUE(image.start >= image.end);
+}
+
+TEST(flasher_image, parse_hex_success)
+{
+  static uint8_t first_data[4] = { 0xde, 0xad, 0xbe, 0xef };
+  static uint8_t second_data[2] = { 0x12, 0x34 };
+
+  bootloader_status status = flasher_image_parse_hex(
+    &image,
+    hex_text,
+    strlen(hex_text)
+  );
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_OK, status);
+  TEST_ASSERT_EQUAL_HEX32(APP_START_ADDRESS, image.start);
+  TEST_ASSERT_EQUAL_HEX32(APP_START_ADDRESS + BLOCK_SIZE + 2, image.end);
+  TEST_ASSERT_EQUAL_MEMORY(
+    first_data,
+    flasher_image_at(&image, APP_START_ADDRESS),
+    sizeof(first_data)
+  );
+  TEST_ASSERT_EQUAL_MEMORY(
+    second_data,
+    flasher_image_at(&image, APP_START_ADDRESS + BLOCK_SIZE),
+    sizeof(second_data)
+  );
+}
+
+TEST(flasher_image, parse_hex_checksum_error)
+{
+  static char *text = ":020000040800F2\r\n"
+    ":04680000DEADBEEF5D\r\n"
+    ":00000001FF\r\n";
+
+  bootloader_status status = flasher_image_parse_hex(
+    &image,
+    text,
+    strlen(text)
+  );
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_CRC_ERROR, status);
+}
+
+TEST(flasher_image, parse_hex_no_end_error)
+{
+  bootloader_status status = flasher_image_parse_hex(
+    &image,
+    hex_text,
+    strlen(hex_text) - strlen(":00000001FF\r\n")
+  );
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_ERROR, status);
+}
+
+TEST(flasher_image, parse_elf_success)
+{
+  static uint8_t input_data[4] = { 0x53, 0xf5, 0x44, 0x33 };
+  uint8_t file[sizeof(Elf32_Ehdr) + 2 * sizeof(Elf32_Phdr) + 4] = { 0 };
+  Elf32_Ehdr header = {
+    .e_type = ET_EXEC,
+    .e_machine = EM_ARM,
+    .e_phoff = sizeof(Elf32_Ehdr),
+    .e_phentsize = sizeof(Elf32_Phdr),
+    .e_phnum = 2
+  };
+  // Initialized data: executed from SRAM, loaded from flash
+  Elf32_Phdr segments[2] = {
+    {
+      .p_type = PT_LOAD,
+      .p_offset = sizeof(file) - sizeof(input_data),
+      .p_vaddr = 0x20000000,
+      .p_paddr = APP_START_ADDRESS + 0x100,
+      .p_filesz = sizeof(input_data),
+      .p_memsz = sizeof(input_data) + 0x10
+    },
+    { .p_type = PT_NOTE, .p_offset = 0, .p_filesz = sizeof(file) }
+  };
+
+  memcpy(header.e_ident, ELFMAG, SELFMAG);
+  header.e_ident[EI_CLASS] = ELFCLASS32;
+  header.e_ident[EI_DATA] = ELFDATA2LSB;
+  memcpy(file, &header, sizeof(header));
+  memcpy(file + sizeof(header), segments, sizeof(segments));
+  memcpy(file + segments[0].p_offset, input_data, sizeof(input_data));
+
+  bootloader_status status = flasher_image_parse_elf(
+    &image,
+    file,
+    sizeof(file)
+  );
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_OK, status);
+  TEST_ASSERT_EQUAL_HEX32(APP_START_ADDRESS + 0x100, image.start);
+  TEST_ASSERT_EQUAL_HEX32(
+    APP_START_ADDRESS + 0x100 + sizeof(input_data),
+    image.end
+  );
+  TEST_ASSERT_EQUAL_MEMORY(
+    input_data,
+    flasher_image_at(&image, APP_START_ADDRESS + 0x100),
+    sizeof(input_data)
+  );
+}
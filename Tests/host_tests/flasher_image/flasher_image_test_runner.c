@@ -0,0 +1,11 @@
+#include "unity_fixture.h"
+
+TEST_GROUP_RUNNER(flasher_image)
+{
+  RUN_TEST_CASE(flasher_image, put_success);
+  RUN_TEST_CASE(flasher_image, put_bounds_error);
+  RUN_TEST_CASE(flasher_image, parse_hex_success);
+  RUN_TEST_CASE(flasher_image, parse_hex_checksum_error);
+  RUN_TEST_CASE(flasher_image, parse_hex_no_end_error);
+  RUN_TEST_CASE(flasher_image, parse_elf_success);
+}
\ No newline at end of file
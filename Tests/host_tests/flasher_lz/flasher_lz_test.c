@@ -0,0 +1,94 @@
+#include "unity_fixture.h"
+#include "flasher_lz.h"
+#include "bootloader_lz.h"
+#include <string.h>
+
+static uint8_t input[3 * LZ_WINDOW_SIZE];
+static uint8_t output[3 * LZ_WINDOW_SIZE + 3 * LZ_WINDOW_SIZE / 255 + 16];
+static uint8_t window[LZ_WINDOW_SIZE];
+static bootloader_lz_decoder decoder;
+
+// Static functions ----------------------------------------------------------
+
+// Decoded by the decoder of the device, a page at a time, as in cmd 8
+static void check_round_trip(const size_t size)
+{
+  size_t compressed_size = flasher_lz_compress(input, size, output);
+
+  TEST_ASSERT_TRUE(compressed_size <= flasher_lz_get_bound(size));
+  bootloader_lz_set_input(&decoder, output, compressed_size);
+  for (uint32_t position = 0; position < size; position += BLOCK_SIZE)
+  {
+    uint32_t end = size - position < BLOCK_SIZE ? size : position + BLOCK_SIZE;
+    bootloader_status status = bootloader_lz_decode(&decoder, end);
+
+    TEST_ASSERT_EQUAL(BOOTLOADER_OK, status);
+    TEST_ASSERT_EQUAL(end, decoder.position);
+    TEST_ASSERT_EQUAL_MEMORY(
+      input + position,
+      window + (position & (LZ_WINDOW_SIZE - 1)),
+      end - position
+    );
+  }
+  TEST_ASSERT_TRUE(bootloader_lz_is_finished(&decoder));
+}
+
+// Tests ---------------------------------------------------------------------
+
+TEST_GROUP(flasher_lz);
+
+TEST_SETUP(flasher_lz)
+{
+  memset(input, 0, sizeof(input));
+  memset(window, 0, sizeof(window));
+  bootloader_lz_init(&decoder, window);
+}
+
+TEST_TEAR_DOWN(flasher_lz)
+{
+}
+
+TEST(flasher_lz, short_input_success)
+{
+  memcpy(input, "abc", 3);
+
+  check_round_trip(3);
+  TEST_ASSERT_EQUAL(4, flasher_lz_compress(input, 3, output));
+}
+
+TEST(flasher_lz, blank_pages_success)
+{
+  memset(input, 0xff, sizeof(input));
+
+  check_round_trip(sizeof(input));
+  TEST_ASSERT_TRUE(flasher_lz_compress(input, sizeof(input), output) < 64);
+}
+
+// The repeated part is further than the window, so it is not matched
+TEST(flasher_lz, window_limit_success)
+{
+  uint32_t seed = 1;
+
+  for (uint16_t i = 0; i < LZ_WINDOW_SIZE; i++)
+  {
+    seed = seed * 1103515245U + 12345U;
+    input[i] = seed >> 16;
+  }
+  memcpy(input + 2 * LZ_WINDOW_SIZE, input, LZ_WINDOW_SIZE);
+
+  check_round_trip(sizeof(input));
+}
+
+TEST(flasher_lz, long_literals_success)
+{
+  uint32_t seed = 7;
+
+  for (uint16_t i = 0; i < BLOCK_SIZE; i++)
+  {
+    seed = seed * 1103515245U + 12345U;
+    input[i] = seed >> 16;
+  }
+  memcpy(input + BLOCK_SIZE, input, BLOCK_SIZE);
+
+  check_round_trip(2 * BLOCK_SIZE + 1);
+}
@@ -0,0 +1,9 @@
+#include "unity_fixture.h"
+
+TEST_GROUP_RUNNER(flasher_lz)
+{
+  RUN_TEST_CASE(flasher_lz, short_input_success);
+  RUN_TEST_CASE(flasher_lz, blank_pages_success);
+  RUN_TEST_CASE(flasher_lz, window_limit_success);
+  RUN_TEST_CASE(flasher_lz, long_literals_success);
+}
\ No newline at end of file
@@ -0,0 +1,121 @@
+#include "unity_fixture.h"
+#include "virtual_flash.h"
+#include <string.h>
+
+static uint8_t memory[VIRTUAL_FLASH_SIZE];
+
+// Tests ---------------------------------------------------------------------
+
+TEST_GROUP(virtual_flash);
+
+TEST_SETUP(virtual_flash)
+{
+  memset(memory, 0xff, sizeof(memory));
+  virtual_flash_init(memory);
+}
+
+TEST_TEAR_DOWN(virtual_flash)
+{
+}
+
+TEST(virtual_flash, erase_success)
+{
+  uint32_t time_us = 0;
+
+  memset(memory + 3 * BLOCK_SIZE, 0x00, 3 * BLOCK_SIZE);
+  bootloader_status status = virtual_flash_erase(
+    VIRTUAL_FLASH_BASE + 4 * BLOCK_SIZE,
+    1,
+    &time_us
+  );
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_OK, status);
+  TEST_ASSERT_EQUAL(VIRTUAL_FLASH_ERASE_TIME_US, time_us);
+  TEST_ASSERT_EQUAL_HEX8(0x00, memory[4 * BLOCK_SIZE - 1]);
+  TEST_ASSERT_TRUE(
+    virtual_flash_is_page_erased(VIRTUAL_FLASH_BASE + 4 * BLOCK_SIZE)
+  );
+  TEST_ASSERT_EQUAL_HEX8(0x00, memory[5 * BLOCK_SIZE]);
+}
+
+TEST(virtual_flash, program_success)
+{
+  static uint8_t input_data[4] = { 0x53, 0xf5, 0x44, 0x33 };
+  uint32_t time_us = 0;
+
+  bootloader_status status = virtual_flash_program(
+    APP_START_ADDRESS,
+    input_data,
+    sizeof(input_data),
+    &time_us
+  );
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_OK, status);
+  TEST_ASSERT_EQUAL(2 * VIRTUAL_FLASH_PROGRAM_TIME_US, time_us);
+  TEST_ASSERT_EQUAL_MEMORY(
+    input_data,
+    virtual_flash_map(APP_START_ADDRESS, sizeof(input_data)),
+    sizeof(input_data)
+  );
+}
+
+TEST(virtual_flash, program_not_erased_error)
+{
+  static uint8_t input_data[4] = { 0x53, 0xf5, 0x44, 0x33 };
+  static uint8_t expected_data[4] = { 0x53, 0xf5, 0xfe, 0xff };
+  uint32_t time_us = 0;
+
+  memory[APP_START_ADDRESS - VIRTUAL_FLASH_BASE + 2] = 0xfe;
+  bootloader_status status = virtual_flash_program(
+    APP_START_ADDRESS,
+    input_data,
+    sizeof(input_data),
+    &time_us
+  );
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_ERROR, status);
+  TEST_ASSERT_EQUAL_MEMORY(
+    expected_data,
+    virtual_flash_map(APP_START_ADDRESS, sizeof(expected_data)),
+    sizeof(expected_data)
+  );
+}
+
+TEST(virtual_flash, program_zero_success)
+{
+  static uint8_t input_data[2] = { 0x00, 0x00 };
+  uint32_t time_us = 0;
+
+  memory[APP_START_ADDRESS - VIRTUAL_FLASH_BASE] = 0x12;
+  bootloader_status status = virtual_flash_program(
+    APP_START_ADDRESS,
+    input_data,
+    sizeof(input_data),
+    &time_us
+  );
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_OK, status);
+  TEST_ASSERT_EQUAL_HEX8(0x00, memory[APP_START_ADDRESS - VIRTUAL_FLASH_BASE]);
+}
+
+TEST(virtual_flash, bounds_error)
+{
+  static uint8_t input_data[4] = { 0x53, 0xf5, 0x44, 0x33 };
+  uint32_t time_us = 0;
+
+  bootloader_status status = virtual_flash_program(
+    VIRTUAL_FLASH_END - 1,
+    input_data,
+    sizeof(input_data),
+    &time_us
+  );
+  status |= virtual_flash_erase(VIRTUAL_FLASH_BASE + 1, 1, &time_us);
+  status |= virtual_flash_erase(
+    VIRTUAL_FLASH_BASE + (FLASH_PAGES_NUM - 1) * BLOCK_SIZE,
+    2,
+    &time_us
+  );
+
+  TEST_ASSERT_EQUAL(BOOTLOADER_BOUNDS_ERROR, status);
+  TEST_ASSERT_NULL(virtual_flash_map(VIRTUAL_FLASH_END, 2));
+}
@@ -0,0 +1,10 @@
+#include "unity_fixture.h"
+
+TEST_GROUP_RUNNER(virtual_flash)
+{
+  RUN_TEST_CASE(virtual_flash, erase_success);
+  RUN_TEST_CASE(virtual_flash, program_success);
+  RUN_TEST_CASE(virtual_flash, program_not_erased_error);
+  RUN_TEST_CASE(virtual_flash, program_zero_success);
+  RUN_TEST_CASE(virtual_flash, bounds_error);
+}
\ No newline at end of file
@@ -5,23 +5,57 @@
 
 void mock_bootloader_io_create(const uint8_t max_expectations);
 void mock_bootloader_io_destroy(void);
+void mock_bootloader_io_set_cycles(const uint32_t value, const uint32_t step);
+void mock_bootloader_io_set_ticks(const uint32_t value);
 void mock_bootloader_io_expect_write(
   const uint8_t *const data,
-  const uint8_t data_size
+  const uint16_t data_size
+);
+void mock_bootloader_io_expect_write_start(
+  const uint8_t *const data,
+  const uint16_t data_size
 );
+void mock_bootloader_io_expect_write_wait(void);
+void mock_bootloader_io_expect_flash_begin(void);
 void mock_bootloader_io_expect_program(
   const uint8_t *const data
 );
+void mock_bootloader_io_expect_flash_end(void);
+void mock_bootloader_io_expect_program_start(
+  const uint8_t *const data,
+  const uint8_t data_size
+);
+void mock_bootloader_io_expect_program_wait(void);
 void mock_bootloader_io_expect_erase(
   const uint8_t *const address,
   const uint8_t pages_num
 );
+void mock_bootloader_io_expect_erase_start(
+  const uint8_t *const address,
+  const uint8_t pages_num
+);
 void mock_bootloader_io_expect_read_then_return(
   const uint8_t *const data,
   const uint8_t data_size
 );
+void mock_bootloader_io_expect_read_timeout(void);
+void mock_bootloader_io_expect_read_frame_then_return(
+  const uint8_t *const data,
+  const uint16_t data_size
+);
 void mock_bootloader_io_expect_get_id_then_return(void);
+void mock_bootloader_io_expect_get_flash_size_then_return(void);
+void mock_bootloader_io_expect_get_uid_then_return(const uint8_t *const uid);
+void mock_bootloader_io_expect_get_uart_clock_then_return(void);
+void mock_bootloader_io_expect_check_baud_rate(const uint8_t *const baud_rate);
+void mock_bootloader_io_expect_set_baud_rate(const uint8_t *const baud_rate);
 void mock_bootloader_io_expect_read_flash(const uint8_t *const data);
+void mock_bootloader_io_expect_get_flash_crc_then_return(
+  const uint8_t *const crc
+);
+void mock_bootloader_io_expect_map_flash_then_return(
+  const uint8_t *const data
+);
 void mock_bootloader_io_verify_complete(void);
 
 #endif
@@ -10,23 +10,42 @@ typedef struct
 {
   int kind;
   const uint8_t * data;
-  uint8_t data_size;
+  uint16_t data_size;
 } expectation;
 
 enum
 {
   IO_READ,
+  IO_READ_FRAME,
   IO_WRITE,
+  IO_WRITE_START,
+  IO_WRITE_WAIT,
   IO_DEV_ID,
+  IO_FLASH_SIZE,
+  IO_UID,
+  IO_UART_CLOCK,
+  IO_CHECK_BAUD_RATE,
+  IO_SET_BAUD_RATE,
+  IO_FLASH_BEGIN,
   IO_PROGRAM,
+  IO_FLASH_END,
+  IO_PROGRAM_START,
+  IO_PROGRAM_WAIT,
   IO_ERASE,
+  IO_ERASE_START,
   IO_FLASH_READ,
+  IO_FLASH_MAP,
+  IO_FLASH_CRC,
   NO_EXPECTED_VALUE = -1,
-  BOOTLOADER_ID = 1034
+  BOOTLOADER_ID = 1034,
+  FLASH_SIZE = 128, // KB
+  UART_CLOCK = 72000000,
+  MAX_BAUD_RATE = 4500000 // 72 MHz / 16
 };
 
 static char *report_not_init = "MockIO not initialized";
 static char *report_no_room_for_exp = "No room for expectations in MockIO";
+static char *report_no_expectations = "No more expectations in MockIO";
 static char *report_verify_error = "Verify error in MockIO. Expected %u "
   "operations, but got %u";
 static char *report_kind_error = "Error kind in MockIO."
@@ -35,11 +54,18 @@ static char *report_addr_error = "Error addr in MockIO."
   " Num of expectation %u ";
 static char *report_data_error = "Error data in MockIO."
   " Expected %u, but got %u";
+static char *report_size_error = "Error size in MockIO."
+  " Num of expectation %u ";
 
 static expectation *expectations = NULL;
 static int set_expectation_count;
 static int get_expectation_count;
 static int max_expectation_count;
+// Cycle counter: returned without expectations, advances by step per read
+static uint32_t cycles;
+static uint32_t cycles_step;
+// Time in ms, kept between tests as the state of the command layer is
+static uint32_t ticks;
 
 // Static functions ----------------------------------------------------------
 
@@ -49,6 +75,13 @@ static void fail_when_no_init()
     FAIL(report_not_init);
 }
 
+static void fail_when_no_expectations()
+{
+  fail_when_no_init();
+  if (get_expectation_count >= set_expectation_count)
+    FAIL(report_no_expectations);
+}
+
 static void fail_when_no_room_for_expectations()
 {
   fail_when_no_init();
@@ -60,7 +93,7 @@ static void fail_when_no_room_for_expectations()
 static void record_expectation(
     const int kind,
     const uint8_t *const data,
-    const uint8_t data_size
+    const uint16_t data_size
 )
 {
   expectations[set_expectation_count].kind = kind;
@@ -88,7 +121,7 @@ static void check_data(
   char *message[sizeof(report_data_error) + 10];
 
   bool fail = false;
-  for (uint8_t i = 0; i < current_expectation->data_size; i++)
+  for (uint16_t i = 0; i < current_expectation->data_size; i++)
   {
     if (current_expectation->data[i] != data[i])
     {
@@ -104,12 +137,28 @@ static void check_data(
   FAIL((char*)message);
 }
 
+// Expected strings may include their terminator, so only written data
+// beyond the expectation is an error (it would not be checked)
+static void check_size(
+  const expectation *const current_expectation,
+  const uint16_t size
+)
+{
+  char *message[sizeof(report_size_error) + 10];
+
+  if (size <= current_expectation->data_size)
+    return;
+
+  sprintf((char*)message, report_size_error, get_expectation_count);
+  FAIL((char*)message);
+}
+
 static bool is_address_in_bounds(const uint32_t address)
 {
   // 128 pages
   return !(
-    address < APP_START_ADDRESS || 
-    address + sizeof(uint16_t) >= 0x0801FFFFUL // flash bank1 end
+    address < DELTA_SCRATCH_ADDRESS || 
+    address + sizeof(uint16_t) - 1 > 0x0801FFFFUL // flash bank1 end
   );
 }
 
@@ -130,6 +179,10 @@ void mock_bootloader_io_create(const uint8_t max_expectations)
     free(expectations);
   expectations = calloc(max_expectations, sizeof(expectation));
   max_expectation_count = max_expectations;
+  set_expectation_count = 0;
+  get_expectation_count = 0;
+  cycles = 0;
+  cycles_step = 0;
 }
 
 void mock_bootloader_io_destroy(void)
@@ -145,13 +198,34 @@ void mock_bootloader_io_destroy(void)
 
 void mock_bootloader_io_expect_write(
     const uint8_t *const  data,
-    const uint8_t data_size
+    const uint16_t data_size
 )
 {
   fail_when_no_room_for_expectations();
   record_expectation(IO_WRITE, data, data_size);
 }
 
+void mock_bootloader_io_expect_write_start(
+  const uint8_t *const data,
+  const uint16_t data_size
+)
+{
+  fail_when_no_room_for_expectations();
+  record_expectation(IO_WRITE_START, data, data_size);
+}
+
+void mock_bootloader_io_expect_write_wait(void)
+{
+  fail_when_no_room_for_expectations();
+  record_expectation(IO_WRITE_WAIT, NULL, 0);
+}
+
+void mock_bootloader_io_expect_flash_begin(void)
+{
+  fail_when_no_room_for_expectations();
+  record_expectation(IO_FLASH_BEGIN, NULL, 0);
+}
+
 void mock_bootloader_io_expect_program(
   const uint8_t *const data
 )
@@ -160,6 +234,27 @@ void mock_bootloader_io_expect_program(
   record_expectation(IO_PROGRAM, data, sizeof(uint16_t));
 }
 
+void mock_bootloader_io_expect_flash_end(void)
+{
+  fail_when_no_room_for_expectations();
+  record_expectation(IO_FLASH_END, NULL, 0);
+}
+
+void mock_bootloader_io_expect_program_start(
+  const uint8_t *const data,
+  const uint8_t data_size
+)
+{
+  fail_when_no_room_for_expectations();
+  record_expectation(IO_PROGRAM_START, data, data_size);
+}
+
+void mock_bootloader_io_expect_program_wait(void)
+{
+  fail_when_no_room_for_expectations();
+  record_expectation(IO_PROGRAM_WAIT, NULL, 0);
+}
+
 void mock_bootloader_io_expect_erase(
   const uint8_t *const address,
   const uint8_t pages_num
@@ -169,6 +264,15 @@ void mock_bootloader_io_expect_erase(
   record_expectation(IO_ERASE, address, sizeof(uint32_t));
 }
 
+void mock_bootloader_io_expect_erase_start(
+  const uint8_t *const address,
+  const uint8_t pages_num
+)
+{
+  fail_when_no_room_for_expectations();
+  record_expectation(IO_ERASE_START, address, sizeof(uint32_t));
+}
+
 void mock_bootloader_io_expect_read_then_return(
     const uint8_t *const  data,
     const uint8_t data_size
@@ -178,18 +282,81 @@ void mock_bootloader_io_expect_read_then_return(
   record_expectation(IO_READ, data, data_size);
 }
 
+// The line stays idle until the read times out
+void mock_bootloader_io_expect_read_timeout(void)
+{
+  fail_when_no_room_for_expectations();
+  record_expectation(IO_READ, NULL, 0);
+}
+
+// The data is a frame without its delimiter
+void mock_bootloader_io_expect_read_frame_then_return(
+  const uint8_t *const data,
+  const uint16_t data_size
+)
+{
+  fail_when_no_room_for_expectations();
+  record_expectation(IO_READ_FRAME, data, data_size);
+}
+
 void mock_bootloader_io_expect_get_id_then_return(void)
 {
   fail_when_no_room_for_expectations();
   record_expectation(IO_DEV_ID, NULL, 0);
 }
 
+void mock_bootloader_io_expect_get_flash_size_then_return(void)
+{
+  fail_when_no_room_for_expectations();
+  record_expectation(IO_FLASH_SIZE, NULL, 0);
+}
+
+void mock_bootloader_io_expect_get_uid_then_return(const uint8_t *const uid)
+{
+  fail_when_no_room_for_expectations();
+  record_expectation(IO_UID, uid, UID_SIZE);
+}
+
+void mock_bootloader_io_expect_get_uart_clock_then_return(void)
+{
+  fail_when_no_room_for_expectations();
+  record_expectation(IO_UART_CLOCK, NULL, 0);
+}
+
+void mock_bootloader_io_expect_check_baud_rate(const uint8_t *const baud_rate)
+{
+  fail_when_no_room_for_expectations();
+  record_expectation(IO_CHECK_BAUD_RATE, baud_rate, sizeof(uint32_t));
+}
+
+void mock_bootloader_io_expect_set_baud_rate(const uint8_t *const baud_rate)
+{
+  fail_when_no_room_for_expectations();
+  record_expectation(IO_SET_BAUD_RATE, baud_rate, sizeof(uint32_t));
+}
+
 void mock_bootloader_io_expect_read_flash(const uint8_t *const data)
 {
   fail_when_no_room_for_expectations();
   record_expectation(IO_FLASH_READ, data, 1);
 }
 
+void mock_bootloader_io_expect_get_flash_crc_then_return(
+  const uint8_t *const crc
+)
+{
+  fail_when_no_room_for_expectations();
+  record_expectation(IO_FLASH_CRC, crc, sizeof(uint32_t));
+}
+
+void mock_bootloader_io_expect_map_flash_then_return(
+  const uint8_t *const data
+)
+{
+  fail_when_no_room_for_expectations();
+  record_expectation(IO_FLASH_MAP, data, 0);
+}
+
 void mock_bootloader_io_verify_complete(void)
 {
   char *message[sizeof(report_verify_error) + 10];
@@ -213,13 +380,38 @@ bootloader_status bootloader_io_read(
   const uint16_t size
 ) 
 {
+  fail_when_no_expectations();
   expectation current_expectation = expectations[get_expectation_count];
 
-  fail_when_no_init();
   check_kind(&current_expectation, IO_READ);
+  get_expectation_count++;
+  if (current_expectation.data == NULL)
+    return BOOTLOADER_TIMEOUT;
 
   memcpy((uint8_t*)data, current_expectation.data, size);
-    
+  return BOOTLOADER_OK;
+}
+
+bootloader_status bootloader_io_read_frame(
+  uint8_t *const data,
+  const uint16_t max_size,
+  uint16_t *const size
+)
+{
+  fail_when_no_expectations();
+  expectation current_expectation = expectations[get_expectation_count];
+
+  check_kind(&current_expectation, IO_READ_FRAME);
+
+  if (current_expectation.data_size > max_size)
+  {
+    *size = max_size;
+    get_expectation_count++;
+    return BOOTLOADER_BOUNDS_ERROR;
+  }
+  *size = current_expectation.data_size;
+  memcpy(data, current_expectation.data, *size);
+
   get_expectation_count++;
   return BOOTLOADER_OK;
 }
@@ -229,10 +421,11 @@ bootloader_status bootloader_io_write(
   const uint16_t size
 )
 {
+  fail_when_no_expectations();
   expectation current_expectation = expectations[get_expectation_count];
 
-  fail_when_no_init();
   check_kind(&current_expectation, IO_WRITE);
+  check_size(&current_expectation, size);
   check_data(&current_expectation, data);
 
   get_expectation_count++;
@@ -240,43 +433,215 @@ bootloader_status bootloader_io_write(
   return BOOTLOADER_OK;
 }
 
+bootloader_status bootloader_io_write_start(
+  const uint8_t *const data,
+  const uint16_t size
+)
+{
+  fail_when_no_expectations();
+  expectation current_expectation = expectations[get_expectation_count];
+
+  check_kind(&current_expectation, IO_WRITE_START);
+  check_size(&current_expectation, size);
+  check_data(&current_expectation, data);
+
+  get_expectation_count++;
+
+  return BOOTLOADER_OK;
+}
+
+bootloader_status bootloader_io_write_wait(void)
+{
+  fail_when_no_expectations();
+  expectation current_expectation = expectations[get_expectation_count];
+
+  check_kind(&current_expectation, IO_WRITE_WAIT);
+
+  get_expectation_count++;
+
+  return BOOTLOADER_OK;
+}
+
+void mock_bootloader_io_set_cycles(const uint32_t value, const uint32_t step)
+{
+  cycles = value;
+  cycles_step = step;
+}
+
+uint32_t bootloader_io_get_cycles()
+{
+  uint32_t value = cycles;
+
+  cycles += cycles_step;
+  return value;
+}
+
+void mock_bootloader_io_set_ticks(const uint32_t value)
+{
+  ticks = value;
+}
+
+uint32_t bootloader_io_get_ticks()
+{
+  return ticks;
+}
+
 uint32_t bootloader_io_get_dev_id()
 {
+  fail_when_no_expectations();
   expectation current_expectation = expectations[get_expectation_count];
 
-  fail_when_no_init();
   check_kind(&current_expectation, IO_DEV_ID);
     
   get_expectation_count++;
   return BOOTLOADER_ID;
 }
 
-bootloader_status bootloader_io_program(
+uint16_t bootloader_io_get_flash_size()
+{
+  fail_when_no_expectations();
+  expectation current_expectation = expectations[get_expectation_count];
+
+  check_kind(&current_expectation, IO_FLASH_SIZE);
+
+  get_expectation_count++;
+  return FLASH_SIZE;
+}
+
+void bootloader_io_get_uid(uint8_t *const uid)
+{
+  fail_when_no_expectations();
+  expectation current_expectation = expectations[get_expectation_count];
+
+  check_kind(&current_expectation, IO_UID);
+
+  memcpy(uid, current_expectation.data, UID_SIZE);
+
+  get_expectation_count++;
+}
+
+uint32_t bootloader_io_get_uart_clock()
+{
+  fail_when_no_expectations();
+  expectation current_expectation = expectations[get_expectation_count];
+
+  check_kind(&current_expectation, IO_UART_CLOCK);
+
+  get_expectation_count++;
+  return UART_CLOCK;
+}
+
+bootloader_status bootloader_io_check_baud_rate(const uint32_t baud_rate)
+{
+  bootloader_status status = BOOTLOADER_OK;
+
+  if (baud_rate == 0 || baud_rate > MAX_BAUD_RATE)
+    status = BOOTLOADER_BOUNDS_ERROR;
+
+  fail_when_no_expectations();
+  expectation current_expectation = expectations[get_expectation_count];
+
+  check_kind(&current_expectation, IO_CHECK_BAUD_RATE);
+  check_data(&current_expectation, (uint8_t*)&baud_rate);
+
+  get_expectation_count++;
+  return status;
+}
+
+bootloader_status bootloader_io_set_baud_rate(const uint32_t baud_rate)
+{
+  fail_when_no_expectations();
+  expectation current_expectation = expectations[get_expectation_count];
+
+  check_kind(&current_expectation, IO_SET_BAUD_RATE);
+  check_data(&current_expectation, (uint8_t*)&baud_rate);
+
+  get_expectation_count++;
+  return BOOTLOADER_OK;
+}
+
+bootloader_status bootloader_io_flash_begin(void)
+{
+  fail_when_no_expectations();
+  expectation current_expectation = expectations[get_expectation_count];
+
+  check_kind(&current_expectation, IO_FLASH_BEGIN);
+
+  get_expectation_count++;
+  return BOOTLOADER_OK;
+}
+
+bootloader_status bootloader_io_flash_program(
   const uint32_t address,
-  const uint16_t data
+  const uint8_t *const data,
+  const uint16_t size
 )
 {
   bootloader_status status = BOOTLOADER_OK;
 
-  if (!is_address_in_bounds(address))
+  if (
+    size % sizeof(uint16_t) ||
+    !is_address_in_bounds(address) ||
+    !is_address_in_bounds(address + size - sizeof(uint16_t))
+  )
     status = BOOTLOADER_BOUNDS_ERROR;
 
+  fail_when_no_expectations();
   expectation current_expectation = expectations[get_expectation_count];
 
-  fail_when_no_init();
   check_kind(&current_expectation, IO_PROGRAM);
-  check_data(&current_expectation, (uint8_t*)&data);
-
-  memcpy(
-    (uint8_t*)&data,
-    current_expectation.data,
-    current_expectation.data_size
-  );
+  check_data(&current_expectation, data);
     
   get_expectation_count++;
   return status;
 }
 
+bootloader_status bootloader_io_flash_end(void)
+{
+  fail_when_no_expectations();
+  expectation current_expectation = expectations[get_expectation_count];
+
+  check_kind(&current_expectation, IO_FLASH_END);
+
+  get_expectation_count++;
+  return BOOTLOADER_OK;
+}
+
+bootloader_status bootloader_io_program_start(
+  const uint32_t address,
+  const uint8_t *const data,
+  const uint16_t size
+)
+{
+  bootloader_status status = BOOTLOADER_OK;
+
+  if (
+    !is_address_in_bounds(address) ||
+    !is_address_in_bounds(address + size - sizeof(uint16_t))
+  )
+    status = BOOTLOADER_BOUNDS_ERROR;
+
+  fail_when_no_expectations();
+  expectation current_expectation = expectations[get_expectation_count];
+
+  check_kind(&current_expectation, IO_PROGRAM_START);
+  check_data(&current_expectation, data);
+
+  get_expectation_count++;
+  return status;
+}
+
+bootloader_status bootloader_io_program_wait(void)
+{
+  fail_when_no_expectations();
+  expectation current_expectation = expectations[get_expectation_count];
+
+  check_kind(&current_expectation, IO_PROGRAM_WAIT);
+
+  get_expectation_count++;
+  return BOOTLOADER_OK;
+}
+
 bootloader_status bootloader_io_erase(
   const uint32_t address,
   const uint8_t pages_num 
@@ -287,9 +652,9 @@ bootloader_status bootloader_io_erase(
   if (!is_address_in_bounds(address) || !is_page_address(address))
     status = BOOTLOADER_BOUNDS_ERROR;
 
+  fail_when_no_expectations();
   expectation current_expectation = expectations[get_expectation_count];
 
-  fail_when_no_init();
   check_kind(&current_expectation, IO_ERASE);
   check_data(&current_expectation, (uint8_t*)&address);
 
@@ -297,6 +662,26 @@ bootloader_status bootloader_io_erase(
   return status;
 }
 
+bootloader_status bootloader_io_erase_start(
+  const uint32_t address,
+  const uint8_t pages_num
+)
+{
+  bootloader_status status = BOOTLOADER_OK;
+
+  if (!is_address_in_bounds(address) || !is_page_address(address))
+    status = BOOTLOADER_BOUNDS_ERROR;
+
+  fail_when_no_expectations();
+  expectation current_expectation = expectations[get_expectation_count];
+
+  check_kind(&current_expectation, IO_ERASE_START);
+  check_data(&current_expectation, (uint8_t*)&address);
+
+  get_expectation_count++;
+  return status;
+}
+
 bootloader_status bootloader_io_read_flash(
   const uint32_t address,
   uint8_t *const value
@@ -308,9 +693,9 @@ bootloader_status bootloader_io_read_flash(
   if (address < 0x08000000 || address + sizeof(uint16_t) >= 0x0801FFFFUL)
     status = BOOTLOADER_BOUNDS_ERROR;
 
+  fail_when_no_expectations();
   expectation current_expectation = expectations[get_expectation_count];
 
-  fail_when_no_init();
   check_kind(&current_expectation, IO_FLASH_READ);
   check_data(&current_expectation, (uint8_t*)&address);
   *value = current_expectation.data;
@@ -318,3 +703,47 @@ bootloader_status bootloader_io_read_flash(
   get_expectation_count++;
   return status;
 }
+
+bootloader_status bootloader_io_get_flash_crc(
+  const uint32_t address,
+  const uint32_t size,
+  uint32_t *const crc
+)
+{
+  bootloader_status status = BOOTLOADER_OK;
+
+  // 128 pages
+  if (
+    size == 0 ||
+    address % sizeof(uint32_t) ||
+    size % sizeof(uint32_t) ||
+    address < 0x08000000 ||
+    address + size - 1 > 0x0801FFFFUL
+  )
+    status = BOOTLOADER_BOUNDS_ERROR;
+
+  fail_when_no_expectations();
+  expectation current_expectation = expectations[get_expectation_count];
+
+  check_kind(&current_expectation, IO_FLASH_CRC);
+  memcpy((uint8_t*)crc, current_expectation.data, sizeof(uint32_t));
+
+  get_expectation_count++;
+  return status;
+}
+
+const uint8_t *bootloader_io_map_flash(
+  const uint32_t address,
+  const uint32_t size
+)
+{
+  fail_when_no_expectations();
+  expectation current_expectation = expectations[get_expectation_count];
+
+  check_kind(&current_expectation, IO_FLASH_MAP);
+
+  get_expectation_count++;
+  if (size == 0 || address < 0x08000000 || address + size - 1 > 0x0801FFFFUL)
+    return NULL;
+  return current_expectation.data;
+}